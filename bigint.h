@@ -60,7 +60,7 @@ static inline struct bigint *bigint_array_new(size_t n, bitsize_t bits)
     if ((arr = malloc(n * sizeof(struct bigint) + n * limbs*sizeof(limb_t)))) {
         size_t i;
         limb_t *limb = (limb_t *)&arr[n];
-        memset(limb, 0, n * sizeof(limb_t));
+        memset(limb, 0, n * limbs*sizeof(limb_t));
         for (i = 0; i < n; i++) {
             arr[i].bits = bits;
             arr[i].limb = limb;
@@ -108,6 +108,27 @@ static inline int bigint_is_zero(const struct bigint *dest)
  */
 struct bigint *bigint_from_string(struct bigint *dest, const char *hex);
 
+/* Load bigint from the 64-bit unsigned integer (the value must fit in dest) */
+static inline struct bigint *bigint_load_u64(struct bigint *dest, uint64_t v)
+{
+    size_t i, j = bigint_limbs(dest);
+    for (i = 0; i < j; i++) {
+        dest->limb[i] = (limb_t)v;
+        v = (v >> (LIMB_BITS/2)) >> (LIMB_BITS/2);
+    }
+    return dest;
+}
+
+/* Get the 64 least significant bits of a bigint */
+static inline uint64_t bigint_get_u64(const struct bigint *src)
+{
+    uint64_t v = 0;
+    size_t i = bigint_limbs(src);
+    while (i--)
+        v = ((v << (LIMB_BITS/2)) << (LIMB_BITS/2)) | src->limb[i];
+    return v;
+}
+
 /* Get/set the nth least significant bit (n = 0, 1, 2, ..., dest->bits - 1) */
 static inline int bigint_get_bit(const struct bigint *dest, bitsize_t n)
 {
@@ -7,6 +7,11 @@ if [ ! -x "$CRCHACK" ]; then
     exit 1
 fi
 
+# Keep the engine tuning cache of the tests out of the home directory
+XDG_CACHE_HOME="$(mktemp -d)"
+export XDG_CACHE_HOME
+trap 'rm -rf "$XDG_CACHE_HOME"' EXIT
+
 OK=0
 FAIL=0
 expect () {
@@ -21,9 +26,10 @@ expect () {
 check () {
     OPTS="$1"
     EXPECT="$2"
-    #NAME="$3"
+    NAME="$3"
     printf "CHECK %s %s ..." "$CRCHACK" "$OPTS"
     expect "$EXPECT" "$(printf 123456789 | eval "$CRCHACK" "$OPTS" - | tr -d '\r\n')"
+    expect "$EXPECT" "$(printf 123456789 | "$CRCHACK" -a "$NAME" - | tr -d '\r\n')"
     expect "123456789" "$(printf 023456789 | eval "$CRCHACK" "$OPTS" -b0:1 - "$EXPECT")"
     expect "123456789" "$(printf 103456789 | eval "$CRCHACK" "$OPTS" -b1.1:2 - "$EXPECT")"
     expect "123456789" "$(printf 120456789 | eval "$CRCHACK" "$OPTS" -b2:3 - "$EXPECT")"
@@ -153,6 +159,440 @@ check "-w64 -p42f0e1eba9ea3693 -iffffffffffffffff -xffffffffffffffff" "62ec59e3f
 check "-w64 -p42f0e1eba9ea3693 -iffffffffffffffff -rR -xffffffffffffffff" "995dc9bbdf1939fa" "CRC-64/XZ"
 check "-w82 -p0308c0111011401440411 -rR" "09ea83f625023801fd612" "CRC-82/DARC"
 
+printf "CHECK %s -a aliases ..." "$CRCHACK"
+expect "cbf43926" "$(printf 123456789 | "$CRCHACK" -a CRC-32 -)"
+expect "e3069283" "$(printf 123456789 | "$CRCHACK" -a crc-32c -)"
+expect "bb3d" "$(printf 123456789 | "$CRCHACK" -a ARC -)"
+expect "fc891918" "$(printf 123456789 | "$CRCHACK" -a CRC-32 --no-reflect -)"
+expect "cbf43926" "$(printf 123456789 | "$CRCHACK" -a CRC-32 --no-reflect -rR -)"
+printf "\n"
+
+printf "CHECK %s long input ..." "$CRCHACK"
+expect "6966ab08" "$(yes 123456789 | head -c 1000000 | "$CRCHACK" -)"
+expect "21c06275" "$(yes 123456789 | head -c 1000000 | "$CRCHACK" -a CRC-32C -)"
+expect "21c06275" "$(yes 123456789 | head -c 1000000 | "$CRCHACK" -w32 -p1edc6f41 -iffffffff -xffffffff -rR -)"
+printf "\n"
+
+printf "CHECK %s --variants ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+printf 123456789 | "$CRCHACK" --variants 8 --output "$TMPDIR/v%d" -b :5 - cafebabe
+for i in 0 1 2 3 4 5 6 7; do
+    expect "cafebabe" "$("$CRCHACK" "$TMPDIR/v$i")"
+done
+expect "8" "$(cat "$TMPDIR"/v? | fold -w 9 | sort -u | wc -l | tr -d ' ')"
+expect "8" "$(printf 123456789 | "$CRCHACK" --variants 8 -b :5 - cafebabe | sort -u | wc -l | tr -d ' ')"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --charset ..." "$CRCHACK"
+for CHARSET in print:[:print:] alnum:[:alnum:] xdigit:[:xdigit:] a-z_:a-z_ '\x20-\x2f:\040-\057'; do
+    OUT="$(printf 'TOKEN=XXXXXXXXXXXXXXXX' | "$CRCHACK" -b 6:22 --charset "${CHARSET%%:*}" - 12345678)"
+    expect "12345678" "$(printf %s "$OUT" | "$CRCHACK" -)"
+    expect "" "$(printf %s "${OUT#TOKEN=}" | LC_ALL=C tr -d "${CHARSET#*:}")"
+done
+printf "\n"
+
+printf "CHECK %s --range ..." "$CRCHACK"
+MSG='HEADER__CRC_0123456789abcdefghijTRAILER'
+expect "$(printf 456789abcd | "$CRCHACK" -)" "$(printf %s "$MSG" | "$CRCHACK" --range 16:26 -)"
+expect "$(printf 456789abcd | "$CRCHACK" -)" "$(printf %s "$MSG" | "$CRCHACK" --range -23:+10 -)"
+OUT="$(printf %s "$MSG" | "$CRCHACK" --range 16:26 -b 4:8 - cafebabe)"
+expect "cafebabe" "$(printf %s "$OUT" | "$CRCHACK" --range 16:26 -)"
+expect "HEADER__CRC_01234567" "$(printf %s "$OUT" | cut -c 1-20)"
+expect "efghijTRAILER" "$(printf %s "$OUT" | cut -c 27-)"
+TMPDIR="$(mktemp -d)"
+printf %s "$MSG" | "$CRCHACK" --range 16:26 - cafebabe > "$TMPDIR/out"
+expect "39" "$(wc -c < "$TMPDIR/out" | tr -d ' ')"
+expect "cafebabe" "$("$CRCHACK" --range 16:26 "$TMPDIR/out")"
+expect "HEADER__CRC_0123456789" "$(head -c 22 "$TMPDIR/out")"
+expect "efghijTRAILER" "$(tail -c 13 "$TMPDIR/out")"
+printf %s "$MSG" | "$CRCHACK" --range 16:26 -o 8 - cafebabe > /dev/null 2>&1
+expect "3" "$?"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s contiguous windows ..." "$CRCHACK"
+for NAME in CRC-32/ISO-HDLC CRC-32/MPEG-2 CRC-16/ARC CRC-64/XZ CRC-82/DARC CRC-8/SMBUS; do
+    TARGET="$("$CRCHACK" -a "$NAME" /dev/null | tr 0-9a-f 1)"
+    for POS in -o4 -O12 -o-7; do
+        expect "$TARGET" "$(printf 'HDR_PACKET_PAYLOAD_0123456789' | "$CRCHACK" -a "$NAME" $POS - "$TARGET" | "$CRCHACK" -a "$NAME" -)"
+    done
+done
+expect "cafebabe" "$(printf 'HDR_PACKET_PAYLOAD_0123456789' | "$CRCHACK" -o 3.5 - cafebabe | "$CRCHACK" -)"
+printf "\n"
+
+printf "CHECK %s sparse files ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+printf A > "$TMPDIR/sparse"
+printf hello | dd of="$TMPDIR/sparse" bs=1 seek=3000000 conv=notrunc 2>/dev/null
+dd if=/dev/null of="$TMPDIR/sparse" bs=1 seek=5000000 2>/dev/null
+for CHECKSUM in CRC-32/ISO-HDLC:03c13106 CRC-64/XZ:ce88827dde20938f CRC-82/DARC:1bcc406ad4dca6271120f; do
+    expect "${CHECKSUM#*:}" "$("$CRCHACK" -a "${CHECKSUM%%:*}" "$TMPDIR/sparse")"
+    expect "${CHECKSUM#*:}" "$(cat "$TMPDIR/sparse" | "$CRCHACK" -a "${CHECKSUM%%:*}" -)"
+done
+expect "cafebabe" "$("$CRCHACK" -o 4000000 "$TMPDIR/sparse" cafebabe | "$CRCHACK" -)"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --index ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 400000; i++) printf "line %d of the indexed file\n", i }' > "$TMPDIR/log"
+EXPECT="$("$CRCHACK" "$TMPDIR/log")"
+expect "$EXPECT" "$("$CRCHACK" --index "$TMPDIR/idx" "$TMPDIR/log")"
+expect "$EXPECT" "$("$CRCHACK" --index "$TMPDIR/idx" "$TMPDIR/log")"
+expect "resuming at offset $(wc -c < "$TMPDIR/log" | tr -d ' ')" "$("$CRCHACK" -v --index "$TMPDIR/idx" "$TMPDIR/log" 2>&1 >/dev/null | grep resuming)"
+printf "appended line\n" >> "$TMPDIR/log"
+expect "$("$CRCHACK" "$TMPDIR/log")" "$("$CRCHACK" --index "$TMPDIR/idx" "$TMPDIR/log")"
+expect "cafebabe" "$("$CRCHACK" --index "$TMPDIR/idx" -O 4 "$TMPDIR/log" cafebabe | "$CRCHACK" -)"
+cat "$TMPDIR/log" "$TMPDIR/log" "$TMPDIR/log" "$TMPDIR/log" > "$TMPDIR/big"
+expect "$("$CRCHACK" "$TMPDIR/big")" "$("$CRCHACK" --index "$TMPDIR/bigidx" "$TMPDIR/big")"
+printf "X" | dd of="$TMPDIR/big" bs=1 seek=$((32 * 1048576 - 10)) conv=notrunc 2>/dev/null
+expect "$("$CRCHACK" "$TMPDIR/big")" "$("$CRCHACK" -v --index "$TMPDIR/bigidx" "$TMPDIR/big" 2> "$TMPDIR/err")"
+expect "resuming at offset 16777216" "$(grep resuming "$TMPDIR/err")"
+PREFIX="$(head -c 1000000 "$TMPDIR/log" | "$CRCHACK" -)"
+expect "$("$CRCHACK" "$TMPDIR/log")" "$("$CRCHACK" --prefix "1000000:$PREFIX" "$TMPDIR/log")"
+expect "cafebabe" "$("$CRCHACK" --prefix "1000000:$PREFIX" -O 4 "$TMPDIR/log" cafebabe | "$CRCHACK" -)"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --verify ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 20000; i++) printf "record %d\n", i }' > "$TMPDIR/msg"
+for ALGO in CRC-32 CRC-64/XZ CRC-82/DARC; do
+    "$CRCHACK" --verify -a "$ALGO" "$TMPDIR/msg" 1 > "$TMPDIR/out"
+    expect "0" "$?"
+    expect "1" "$("$CRCHACK" -a "$ALGO" "$TMPDIR/out" | tr -d 0)"
+done
+"$CRCHACK" --verify --range 10:100000 -o 5000 "$TMPDIR/msg" cafebabe > "$TMPDIR/out"
+expect "0" "$?"
+expect "cafebabe" "$(head -c 100000 "$TMPDIR/out" | tail -c +11 | "$CRCHACK" -)"
+"$CRCHACK" --verify --prefix 1000:12345678 "$TMPDIR/msg" cafebabe > /dev/null 2>&1
+expect "8" "$?"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --output with several targets ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 20000; i++) printf "record %d\n", i }' > "$TMPDIR/msg"
+"$CRCHACK" --verify -o 65534 --output "$TMPDIR/out%d" "$TMPDIR/msg" 1 cafebabe deadbeef
+expect "0" "$?"
+expect "00000001 cafebabe deadbeef " "$(for K in 0 1 2; do "$CRCHACK" "$TMPDIR/out$K"; done | tr '\n' ' ')"
+"$CRCHACK" -o 65534 "$TMPDIR/msg" deadbeef | cmp -s - "$TMPDIR/out2"
+expect "0" "$?"
+"$CRCHACK" --verify --range 10:-10 -O 4 --output "$TMPDIR/range%d" "$TMPDIR/msg" 12345678 87654321
+expect "0" "$?"
+expect "87654321" "$(tail -c +11 "$TMPDIR/range1" | head -c $(($(wc -c < "$TMPDIR/msg") - 20)) | "$CRCHACK" -)"
+expect "$(tail -c 10 "$TMPDIR/msg")" "$(tail -c 10 "$TMPDIR/range1")"
+"$CRCHACK" "$TMPDIR/msg" 1 2 > /dev/null 2>&1
+expect "1" "$?"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --min-flips ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 40; i++) printf "line %d\n", i }' > "$TMPDIR/msg"
+"$CRCHACK" -v --min-flips bits --budget 1 -b 0: "$TMPDIR/msg" cafebabe > "$TMPDIR/out" 2> "$TMPDIR/err"
+expect "0" "$?"
+expect "cafebabe" "$("$CRCHACK" "$TMPDIR/out")"
+expect "1" "$(sed -n 's/^flip\[\([0-9]*\)\].*/\1/p' "$TMPDIR/err" | awk '{ print ($1 <= 6) }')"
+"$CRCHACK" --min-flips bytes --work 100000 -b 0: "$TMPDIR/msg" cafebabe > "$TMPDIR/out" 2> /dev/null
+expect "0" "$?"
+expect "cafebabe" "$("$CRCHACK" "$TMPDIR/out")"
+expect "1" "$(cmp -l "$TMPDIR/msg" "$TMPDIR/out" | wc -l | awk '{ print ($1 <= 4) }')"
+expect "0" "$("$CRCHACK" --min-flips bits -b 0: "$TMPDIR/msg" "$("$CRCHACK" "$TMPDIR/msg")" 2> /dev/null | cmp -l "$TMPDIR/msg" - | wc -l | tr -d ' ')"
+LC_ALL=C awk 'BEGIN { x = 1; for (i = 0; i < 64; i++) { x = (x * 1103515245 + 12345) % 2147483648; printf "%c", int(x / 65536) % 256 } }' > "$TMPDIR/random"
+LIGHTEST="$("$CRCHACK" -b 0:6 --variants 65536 "$TMPDIR/random" cafebabe | awk 'NR == 1 || NF < min { min = NF } END { print min }')"
+"$CRCHACK" -v --min-flips bits --work 100000 -b 0:6 "$TMPDIR/random" cafebabe > /dev/null 2> "$TMPDIR/err"
+expect "$LIGHTEST" "$(sed -n 's/^flip\[\([0-9]*\)\].*/\1/p' "$TMPDIR/err")"
+for UNIT in bits bytes; do
+    "$CRCHACK" -a CRC-64/XZ --min-flips $UNIT --work 100000 -b 0: "$TMPDIR/msg" 0123456789abcdef > "$TMPDIR/out" 2> /dev/null
+    expect "0" "$?"
+    expect "0123456789abcdef" "$("$CRCHACK" -a CRC-64/XZ "$TMPDIR/out")"
+done
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --analyze ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+printf 'x' | dd of="$TMPDIR/big" bs=1 seek=1073741823 2> /dev/null
+expect "rank	32 of 32" "$("$CRCHACK" --analyze "$TMPDIR/big" | sed -n 2p)"
+"$CRCHACK" --analyze -b 0:4 -b 8:16:2 -b 100.0:100.1 "$TMPDIR/big" > "$TMPDIR/out"
+expect "0" "$?"
+expect "needed redundant redundant " "$(awk -F '\t' '/^slice/ { printf "%s ", $5 }' "$TMPDIR/out")"
+expect "window	0.0..3.7	32 bits" "$(grep window "$TMPDIR/out")"
+"$CRCHACK" --analyze -b 0:1 -b 0.0:1.0 "$TMPDIR/big" > "$TMPDIR/out"
+expect "6" "$?"
+expect "rank	8 of 32" "$(sed -n 2p "$TMPDIR/out")"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --target-at ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { printf "header"; for (i = 0; i < 1000; i++) printf "data %d\n", i }' > "$TMPDIR/msg"
+for ALGO in CRC-16/XMODEM:2 CRC-32:4 CRC-32C:4 CRC-64/XZ:8; do
+    "$CRCHACK" --verify -a "${ALGO%:*}" --target-at 2 -o 3000 "$TMPDIR/msg" > "$TMPDIR/out"
+    expect "0" "$?"
+    expect "$(tail -c +3 "$TMPDIR/out" | head -c "${ALGO#*:}" | od -An -tx1 | tr -d ' \n')" "$("$CRCHACK" -a "${ALGO%:*}" "$TMPDIR/out")"
+done
+"$CRCHACK" --verify --target-at -4:le -b 0: "$TMPDIR/msg" > "$TMPDIR/out"
+expect "0" "$?"
+expect "$(tail -c 4 "$TMPDIR/out" | od -An -tx1 | awk '{ print $4 $3 $2 $1 }')" "$("$CRCHACK" "$TMPDIR/out")"
+"$CRCHACK" --target-at 2 "$TMPDIR/msg" cafebabe > /dev/null 2>&1
+expect "1" "$?"
+"$CRCHACK" --target-at 10000 "$TMPDIR/msg" > /dev/null 2>&1
+expect "3" "$?"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --oracle ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 1000; i++) printf "line %d\n", i }' > "$TMPDIR/msg"
+printf '#!/bin/sh\nexec "%s" "$1"\n' "$CRCHACK" > "$TMPDIR/single"
+printf '#!/bin/sh\nfor f; do "%s" "$f" || exit 1; done\n' "$CRCHACK" > "$TMPDIR/batch"
+chmod +x "$TMPDIR/single" "$TMPDIR/batch"
+expect "$("$CRCHACK" "$TMPDIR/msg")" "$("$CRCHACK" --oracle "$TMPDIR/single" "$TMPDIR/msg")"
+"$CRCHACK" "$TMPDIR/msg" deadbeef > "$TMPDIR/expect"
+for ORACLE in single batch batch; do
+    "$CRCHACK" --oracle "$TMPDIR/$ORACLE" "$TMPDIR/msg" deadbeef > "$TMPDIR/out"
+    expect "0" "$?"
+    cmp -s "$TMPDIR/expect" "$TMPDIR/out"
+    expect "0" "$?"
+done
+expect "1" "$(grep -c "batch" "$XDG_CACHE_HOME/crchack.oracle")"
+"$CRCHACK" --oracle "$TMPDIR/batch" -b 100:104 --output "$TMPDIR/out%d" "$TMPDIR/msg" 1 2
+expect "00000001 00000002" "$("$CRCHACK" "$TMPDIR/out0") $("$CRCHACK" "$TMPDIR/out1")"
+mkdir "$TMPDIR/it's"
+cp "$TMPDIR/batch" "$TMPDIR/quote"
+expect "deadbeef" "$(TMPDIR="$TMPDIR/it's" "$CRCHACK" --oracle "$TMPDIR/quote" "$TMPDIR/msg" deadbeef | "$CRCHACK" -)"
+expect "0" "$(ls "$TMPDIR/it's" | wc -l | tr -d ' ')"
+"$CRCHACK" --oracle false "$TMPDIR/msg" deadbeef > /dev/null 2>&1
+expect "2" "$?"
+"$CRCHACK" --oracle "$TMPDIR/single" -p 1021 "$TMPDIR/msg" > /dev/null 2>&1
+expect "1" "$?"
+"$CRCHACK" --verify --oracle "$TMPDIR/single" "$TMPDIR/msg" deadbeef > "$TMPDIR/out"
+expect "0" "$?"
+printf '#!/bin/sh\nexec "%s" -a CRC-32C "$1"\n' "$CRCHACK" > "$TMPDIR/single"
+"$CRCHACK" --oracle "$TMPDIR/single" "$TMPDIR/msg" deadbeef > /dev/null 2>&1
+expect "8" "$?"
+expect "0" "$(grep -c "single" "$XDG_CACHE_HOME/crchack.oracle")"
+expect "deadbeef" "$("$CRCHACK" --oracle "$TMPDIR/single" "$TMPDIR/msg" deadbeef | "$CRCHACK" -a CRC-32C -)"
+expect "0" "$(ls "$XDG_CACHE_HOME" | grep -c 'crchack\.oracle\.')"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --scan ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+printf 'header 123456789 trailer' > "$TMPDIR/msg"
+expect "7:16	cbf43926" "$("$CRCHACK" --scan 9 "$TMPDIR/msg" cbf43926)"
+expect "7:16	cbf43926" "$("$CRCHACK" --scan 0: "$TMPDIR/msg" cbf43926)"
+expect "7:10	ba04 7:16	bb3d" "$("$CRCHACK" -a CRC-16/ARC --scan 5:10 "$TMPDIR/msg" bb3d ba04 | tr '\n' ' ' | sed 's/ $//')"
+"$CRCHACK" --scan 8 "$TMPDIR/msg" cbf43926 > /dev/null 2>&1
+expect "6" "$?"
+awk 'BEGIN { for (i = 0; i < 200000; i++) printf "record %d\n", i }' > "$TMPDIR/img"
+CRC="$("$CRCHACK" --range 1048000:2100000 "$TMPDIR/img")"
+expect "1048000:2100000	$CRC" "$("$CRCHACK" --scan 1047990:1048010 "$TMPDIR/img" "$CRC")"
+CRC="$("$CRCHACK" -a CRC-64/XZ --range 1048550:+64 "$TMPDIR/img")"
+expect "1048550:1048614	$CRC" "$("$CRCHACK" -a CRC-64/XZ --scan 64 "$TMPDIR/img" "$CRC")"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --record-size ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 3000; i++) printf "frame %06d payload\n", i }' > "$TMPDIR/frames"
+"$CRCHACK" --record-size 21 "$TMPDIR/frames" cafebabe > "$TMPDIR/out"
+expect "0" "$?"
+expect "$(wc -c < "$TMPDIR/frames")" "$(wc -c < "$TMPDIR/out")"
+expect "cafebabe" "$(head -c 21 "$TMPDIR/out" | "$CRCHACK" -)"
+expect "cafebabe" "$(head -c 42000 "$TMPDIR/out" | tail -c 21 | "$CRCHACK" -)"
+expect "frame 000009 pa" "$(head -c 210 "$TMPDIR/out" | tail -c 21 | head -c 15)"
+for ALGO in CRC-16/ARC CRC-32/MPEG-2 CRC-64/XZ CRC-82/DARC; do
+    "$CRCHACK" --verify -a "$ALGO" --record-size 1000 -o 100 "$TMPDIR/frames" 1 > "$TMPDIR/out"
+    expect "0" "$?"
+    expect "1" "$(tail -c 1000 "$TMPDIR/out" | "$CRCHACK" -a "$ALGO" - | tr -d 0)"
+    expect "1" "$(head -c 3000 "$TMPDIR/out" | tail -c 1000 | "$CRCHACK" -a "$ALGO" - | tr -d 0)"
+done
+awk 'BEGIN { for (i = 0; i < 100000; i++) printf "frame %06d payload\n", i }' > "$TMPDIR/many"
+"$CRCHACK" --verify --record-size 21 "$TMPDIR/many" cafebabe > "$TMPDIR/out"
+expect "0" "$?"
+expect "$(wc -c < "$TMPDIR/many")" "$(wc -c < "$TMPDIR/out")"
+expect "cafebabe" "$(head -c 1500009 "$TMPDIR/out" | tail -c 21 | "$CRCHACK" -)"
+expect "cafebabe" "$(tail -c 21 "$TMPDIR/out" | "$CRCHACK" -)"
+printf "end" >> "$TMPDIR/frames"
+"$CRCHACK" --record-size 21 "$TMPDIR/frames" cafebabe > "$TMPDIR/out" 2>/dev/null
+expect "3" "$?"
+expect "0" "$(wc -c < "$TMPDIR/out" | tr -d ' ')"
+cat "$TMPDIR/frames" | "$CRCHACK" --record-size 21 - cafebabe > "$TMPDIR/out" 2>/dev/null
+expect "3" "$?"
+expect "$(wc -c < "$TMPDIR/frames")" "$(wc -c < "$TMPDIR/out")"
+expect "end" "$(tail -c 3 "$TMPDIR/out")"
+expect "cafebabe" "$(head -c 42000 "$TMPDIR/out" | tail -c 21 | "$CRCHACK" -)"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --lines ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 300; i++) { printf "line %d", i; for (j = 0; j < i % 37; j++) printf "x"; printf "\n" } printf "last" }' > "$TMPDIR/lines"
+for ALGO in CRC-32 CRC-32C CRC-16/XMODEM CRC-64/XZ CRC-82/DARC; do
+    "$CRCHACK" -a "$ALGO" --lines "$TMPDIR/lines" > "$TMPDIR/out"
+    expect "0" "$?"
+    expect "301" "$(wc -l < "$TMPDIR/out")"
+    while IFS= read -r LINE || [ -n "$LINE" ]; do
+        printf %s "$LINE" | "$CRCHACK" -a "$ALGO" -
+    done < "$TMPDIR/lines" > "$TMPDIR/expected"
+    cmp -s "$TMPDIR/expected" "$TMPDIR/out"
+    expect "0" "$?"
+    "$CRCHACK" -a "$ALGO" --record-size 13 "$TMPDIR/lines" > "$TMPDIR/out"
+    expect "$((($(wc -c < "$TMPDIR/lines") + 12) / 13))" "$(wc -l < "$TMPDIR/out")"
+    expect "$(head -c 13 "$TMPDIR/lines" | "$CRCHACK" -a "$ALGO" -)" "$(head -n 1 "$TMPDIR/out")"
+    expect "$(head -c 1300 "$TMPDIR/lines" | tail -c 13 | "$CRCHACK" -a "$ALGO" -)" "$(sed -n 100p "$TMPDIR/out")"
+    expect "$(tail -c $(($(wc -c < "$TMPDIR/lines") % 13)) "$TMPDIR/lines" | "$CRCHACK" -a "$ALGO" -)" "$(tail -n 1 "$TMPDIR/out")"
+done
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --format ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+printf '\211PNG\r\n\032\n\0\0\0\rIHDR\0\0\0\1\0\0\0\1\10\0\0\0\0\0\0\0\0\0\0\0\23tEXtComment\0hello world\0\0\0\0\0\0\0\0IEND\0\0\0\0' > "$TMPDIR/png"
+expect "restamped restamped restamped " "$("$CRCHACK" --format png "$TMPDIR/png" | cut -f 4 | tr '\n' ' ')"
+expect "ok ok ok " "$("$CRCHACK" --format png "$TMPDIR/png" | cut -f 4 | tr '\n' ' ')"
+expect "72	IEND	ae426082	ok" "$("$CRCHACK" --format png "$TMPDIR/png" | tail -n 1)"
+printf HELLO | dd of="$TMPDIR/png" bs=1 seek=49 conv=notrunc 2> /dev/null
+expect "ok forged ok " "$("$CRCHACK" --verify --format png -O 4 "$TMPDIR/png" | cut -f 4 | tr '\n' ' ')"
+expect "$(head -c 60 "$TMPDIR/png" | tail -c 23 | "$CRCHACK" -)" "$("$CRCHACK" --format png "$TMPDIR/png" | sed -n 2p | cut -f 3)"
+expect "Comment HELLO w" "$(head -c 56 "$TMPDIR/png" | tail -c 15 | tr '\0' ' ')"
+"$CRCHACK" --format png --min-flips bits -O 4 "$TMPDIR/png" > /dev/null 2>&1
+expect "1" "$?"
+"$CRCHACK" --verify --format png "$TMPDIR/png" > /dev/null 2>&1
+expect "1" "$?"
+printf 'PK\003\004\024\0\0\0\0\0\0\0\0\0\0\0\0\0\5\0\0\0\5\0\0\0\5\0\0\0a.txthello' > "$TMPDIR/zip"
+printf 'PK\001\002\024\0\024\0\0\0\0\0\0\0\0\0\0\0\0\0\5\0\0\0\5\0\0\0\5\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0a.txt' >> "$TMPDIR/zip"
+printf 'PK\005\006\0\0\0\0\1\0\1\0\63\0\0\0\50\0\0\0\0\0' >> "$TMPDIR/zip"
+expect "56	a.txt	3610a686	restamped" "$("$CRCHACK" --format zip "$TMPDIR/zip")"
+expect " 86 a6 10 36" "$(head -c 18 "$TMPDIR/zip" | tail -c 4 | od -An -tx1)"
+if command -v gzip > /dev/null 2>&1; then
+    awk 'BEGIN { for (i = 0; i < 10000; i++) print i }' | gzip > "$TMPDIR/gz"
+    printf '\0\0\0\0' | dd of="$TMPDIR/gz" bs=1 seek=$(($(wc -c < "$TMPDIR/gz") - 8)) conv=notrunc 2> /dev/null
+    expect "restamped" "$("$CRCHACK" --format gzip "$TMPDIR/gz" | cut -f 4)"
+    gzip -t "$TMPDIR/gz" 2> /dev/null
+    expect "0" "$?"
+    "$CRCHACK" --format gzip -o 0 "$TMPDIR/gz" > /dev/null 2>&1
+    expect "0" "$?"
+fi
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --tune ..." "$CRCHACK"
+expect "tuning = benchmarked" "$(printf 123456789 | "$CRCHACK" --tune --stats -a CRC-32C - 2>&1 >/dev/null | grep tuning)"
+expect "tuning = cached" "$(printf 123456789 | "$CRCHACK" --stats -a CRC-32C - 2>&1 >/dev/null | grep tuning)"
+expect "2^7-bit messages, benchmarked" "$(printf 123456789 | "$CRCHACK" --stats -w128 -p3 -b 0:16 - 0 2>&1 >/dev/null | sed -n 's/^sparse = [a-z]* for \(.*\) (.*)\(.*\)/\1\2/p')"
+expect "2^7-bit messages, cached" "$(printf 123456789 | "$CRCHACK" --stats -w128 -p3 -b 0:16 - 0 2>&1 >/dev/null | sed -n 's/^sparse = [a-z]* for //p')"
+printf 123456789 | "$CRCHACK" -a CRC-32C -b 2:6 - cafebabe > /dev/null
+for ENGINES in "serial matrix" "table poly" "table matrix"; do
+    awk -F '\t' -v OFS='\t' -v E="${ENGINES% *}" -v S="${ENGINES#* }" '{ $3 = ($2 ~ / s[0-9]+$/) ? S : E; print }' "$XDG_CACHE_HOME/crchack.tune" > "$XDG_CACHE_HOME/edited"
+    mv "$XDG_CACHE_HOME/edited" "$XDG_CACHE_HOME/crchack.tune"
+    expect "engine = ${ENGINES% *}" "$(printf 123456789 | "$CRCHACK" --stats -a CRC-32C - 2>&1 >/dev/null | grep engine)"
+    expect "sparse = ${ENGINES#* } for 2^7-bit messages, cached" "$(printf 123456789 | "$CRCHACK" --stats -a CRC-32C -b 2:6 - 0 2>&1 >/dev/null | grep '^sparse =')"
+    expect "e3069283" "$(printf 123456789 | "$CRCHACK" -a CRC-32C -)"
+    expect "cafebabe" "$(printf 123456789 | "$CRCHACK" -a CRC-32C -b 2:6 - cafebabe | "$CRCHACK" -a CRC-32C -)"
+done
+expect "tuning = benchmarked" "$(printf 123456789 | XDG_CACHE_HOME="$XDG_CACHE_HOME/new/dir" "$CRCHACK" --stats - 2>&1 >/dev/null | grep tuning)"
+expect "tuning = cached" "$(printf 123456789 | XDG_CACHE_HOME="$XDG_CACHE_HOME/new/dir" "$CRCHACK" --stats - 2>&1 >/dev/null | grep tuning)"
+expect "tuning = default (cache not writable)" "$(printf 123456789 | XDG_CACHE_HOME="$XDG_CACHE_HOME/crchack.tune/dir" "$CRCHACK" --stats - 2>&1 >/dev/null | grep tuning)"
+expect "0" "$(ls "$XDG_CACHE_HOME" | grep -c 'crchack\.tune\.')"
+printf "\n"
+
+printf "CHECK %s --mem-limit ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+awk 'BEGIN { for (i = 0; i < 100000; i++) printf "%d\n", i }' > "$TMPDIR/msg"
+for ALGO in CRC-32 CRC-64/XZ; do
+    "$CRCHACK" -a "$ALGO" -b 10:20 "$TMPDIR/msg" 1 > /dev/null
+    awk -F '\t' -v OFS='\t' '{ $3 = ($2 ~ / s[0-9]+$/) ? "matrix" : "table"; print }' "$XDG_CACHE_HOME/crchack.tune" > "$XDG_CACHE_HOME/edited"
+    mv "$XDG_CACHE_HOME/edited" "$XDG_CACHE_HOME/crchack.tune"
+    for LIMIT in 1M 20K 12K 1K; do
+        expect "1" "$("$CRCHACK" -a "$ALGO" --mem-limit $LIMIT -b 10:20 -b 500000:500010 "$TMPDIR/msg" 1 | "$CRCHACK" -a "$ALGO" - | tr -d 0)"
+    done
+done
+expect "(poly fallback for --mem-limit)" "$("$CRCHACK" --stats --mem-limit 1K -b 10:20 "$TMPDIR/msg" 1 2>&1 >/dev/null | grep -o '(.*')"
+expect "(4 of 23 levels stored, the rest squared per flip)" "$("$CRCHACK" --stats --mem-limit 10K -b 10:20 "$TMPDIR/msg" 1 2>&1 >/dev/null | grep -o '(.*')"
+rm -rf "$TMPDIR"
+printf "\n"
+
+printf "CHECK %s --recover ..." "$CRCHACK"
+TMPDIR="$(mktemp -d)"
+printf "alpha sample for recovery" > "$TMPDIR/s1"
+printf "bravo test of parameters!" > "$TMPDIR/s2"
+printf "charlie: 0123456789abcdef" > "$TMPDIR/s3"
+printf "delta %s" "$(printf 'zYxW%.0s' 1 2 3 4 5)" > "$TMPDIR/s4"
+printf "short sample" > "$TMPDIR/s5"
+for NAME in CRC-32/ISO-HDLC CRC-32/MPEG-2 CRC-16/MODBUS CRC-8/SMBUS CRC-64/XZ; do
+    SAMPLES=""
+    for i in 1 2 3 4 5; do
+        SAMPLES="$SAMPLES $TMPDIR/s$i $("$CRCHACK" -a "$NAME" "$TMPDIR/s$i")"
+    done
+    expect "-a $NAME" "$("$CRCHACK" --recover $SAMPLES 2>/dev/null | grep -x -- "-a $NAME")"
+done
+expect "-a CRC-16/SPI-FUJITSU" "$("$CRCHACK" --recover -w16 -p1021 "$TMPDIR/s1" "$("$CRCHACK" -a CRC-16/SPI-FUJITSU "$TMPDIR/s1")" "$TMPDIR/s5" "$("$CRCHACK" -a CRC-16/SPI-FUJITSU "$TMPDIR/s5")" 2>/dev/null | grep -x -- "-a CRC-16/SPI-FUJITSU")"
+rm -rf "$TMPDIR"
+printf "\n"
+
+CXX="${CXX:-c++}"
+if command -v "$CXX" > /dev/null 2>&1; then
+    printf "CHECK crchack.hpp ..."
+    TMPDIR="$(mktemp -d)"
+    # Instantiate crchack::crc<> for each catalogue algorithm up to 64 bits
+    {
+        cat << 'EOF'
+#include "crchack.hpp"
+#include <cstdio>
+#include <cstring>
+
+template <class CRC> static void test(const char *name)
+{
+    static constexpr char msg[] = "123456789";
+    constexpr auto expect = CRC::checksum(msg, 9);
+    const std::uint64_t bits[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    unsigned char forged[] = "023456789";
+    int ok = CRC::append(CRC::checksum(msg, 4), msg + 4, 5) == expect
+          && CRC::sparse_flip(CRC::checksum(forged, 9), 9, 0) == expect
+          && CRC::forge(forged, 9, expect, bits, 8)
+          && !std::strcmp(reinterpret_cast<char *>(forged), msg);
+    std::printf("%s %0*llx %d\n", name, static_cast<int>((CRC::width + 3) / 4),
+                static_cast<unsigned long long>(expect), ok);
+}
+
+int main()
+{
+EOF
+        grep '^check "' "$(realpath "$0")" | awk -F'"' '{
+            w = 0; p = i = x = "0"; r = R = "false"
+            n = split($2, opts, " ")
+            for (k = 1; k <= n; k++) {
+                o = substr(opts[k], 2, 1); v = substr(opts[k], 3)
+                if (o == "w") w = v
+                else if (o == "p") p = v
+                else if (o == "i") i = v
+                else if (o == "x") x = v
+                else if (o == "r") { r = "true"; if (v == "R") R = "true" }
+                else if (o == "R") R = "true"
+            }
+            if (w <= 64)
+                printf "    test<crchack::crc<%d, 0x%s, 0x%s, 0x%s, %s, %s>>(\"%s\");\n", w, p, i, x, r, R, $6
+        }'
+        echo "}"
+    } > "$TMPDIR/test.cpp"
+    if "$CXX" -std=c++17 -Wall -I"$(dirname "$(realpath "$0")")" \
+            "$TMPDIR/test.cpp" -o "$TMPDIR/test"; then
+        "$TMPDIR/test" > "$TMPDIR/results"
+        while read -r NAME CHECKSUM OK; do
+            expect "$(printf 123456789 | "$CRCHACK" -a "$NAME" -) 1" "$CHECKSUM $OK"
+        done < "$TMPDIR/results"
+    else
+        expect "compiled" "failed"
+    fi
+    rm -rf "$TMPDIR"
+    printf "\n"
+fi
+
 printf 'SOLVE %s Google CTF 2018 (Quals) task "Tape, misc, 355p" ...' "$CRCHACK"
 expect ': You probably just want the flag.  So here it is: CTF{dZXicOXLaMumrTPIUTYMI}. :' "$(printf ': You probably just want the flag.  So here it is: CTF{dZXi__________PIUTYMI}. :' | eval "$CRCHACK" -b '59.{0-5}:69:1' -w64 -p0x42F0E1EBA9EA3693 -rR - 0x30d498cbfb871112)"
 expect "30d498cbfb871112" "$(printf ': You probably just want the flag.  So here it is: CTF{dZXi__________PIUTYMI}. :' | eval "$CRCHACK" -b '59.{0-5}:69:1' -w64 -p0x42F0E1EBA9EA3693 -rR - 0x30d498cbfb871112 | eval "$CRCHACK" -w64 -p0x42F0E1EBA9EA3693 -rR -)"
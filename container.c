@@ -0,0 +1,320 @@
+#include "container.h"
+#include "inflate.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const out_of_memory = "out of memory";
+
+static uint32_t get16le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t get32le(const uint8_t *p)
+{
+    return get16le(p) | get16le(p + 2) << 16;
+}
+
+static uint32_t get32be(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16
+         | (uint32_t)p[2] << 8  | (uint32_t)p[3];
+}
+
+/* Append a region without spans (NULL if out of memory) */
+static struct container_region *add_region(struct container *c,
+                                           const uint8_t *name, size_t namelen)
+{
+    struct container_region *region;
+    if (c->nregions == c->region_capacity) {
+        size_t capacity = 2*c->region_capacity + 16;
+        region = realloc(c->regions, capacity * sizeof(*region));
+        if (!region)
+            return NULL;
+        c->regions = region;
+        c->region_capacity = capacity;
+    }
+    region = &c->regions[c->nregions++];
+    memset(region, 0, sizeof(*region));
+    region->name = name;
+    region->namelen = namelen;
+    region->span = c->nspans;
+    return region;
+}
+
+/* Extend the last region by n bytes at offset (merged with a preceding span) */
+static int add_span(struct container *c, uintmax_t offset, uintmax_t n)
+{
+    struct container_region *region = &c->regions[c->nregions-1];
+    struct container_span *span;
+    region->len += n;
+    if (region->nspans) {
+        span = &c->spans[c->nspans-1];
+        if (span->offset + span->len == offset) {
+            span->len += n;
+            return 1;
+        }
+    }
+    if (c->nspans == c->span_capacity) {
+        size_t capacity = 2*c->span_capacity + 16;
+        if (!(span = realloc(c->spans, capacity * sizeof(*span))))
+            return 0;
+        c->spans = span;
+        c->span_capacity = capacity;
+    }
+    span = &c->spans[c->nspans++];
+    span->offset = offset;
+    span->len = n;
+    region->nspans++;
+    return 1;
+}
+
+/* Checksum of the spans of the last region */
+static int checksum_spans(struct container *c, const uint8_t *data,
+                          const struct crc_config *crc)
+{
+    size_t i;
+    struct bigint checksum;
+    struct container_region *region = &c->regions[c->nregions-1];
+    if (!bigint_init(&checksum, crc->width))
+        return 0;
+    bigint_load_zeros(&checksum);
+    crc_bits(crc, data, 0, 0, &checksum);
+    for (i = region->span; i < region->span + region->nspans; i++)
+        crc_append(crc, data + c->spans[i].offset, c->spans[i].len, &checksum);
+    region->actual = (uint32_t)bigint_get_u64(&checksum);
+    bigint_destroy(&checksum);
+    return 1;
+}
+
+/* Receiver of the decompressed bytes of a region */
+struct inflated {
+    struct container *c;
+    const struct crc_config *crc;
+    uintmax_t base;         /* file offset of the DEFLATE stream */
+    struct bigint checksum;
+    int compressed;         /* some output was not copied from stored blocks */
+    int oom;
+};
+
+static void inflated(void *ctx, const uint8_t *bytes, size_t n, size_t src)
+{
+    struct inflated *s = ctx;
+    crc_append(s->crc, bytes, n, &s->checksum);
+    if (src == INFLATE_DECODED) {
+        s->c->regions[s->c->nregions-1].len += n;
+        s->compressed = 1;
+    } else if (n && !add_span(s->c, s->base + src, n)) {
+        s->oom = 1;
+    }
+}
+
+/* Decompress the DEFLATE stream covered by the last region */
+static const char *inflate_region(struct container *c, const uint8_t *data,
+                                  size_t offset, size_t len, size_t *used,
+                                  const struct crc_config *crc)
+{
+    int ok;
+    struct inflated s;
+    struct container_region *region;
+    s.c = c;
+    s.crc = crc;
+    s.base = offset;
+    s.compressed = s.oom = 0;
+    if (!bigint_init(&s.checksum, crc->width))
+        return out_of_memory;
+    bigint_load_zeros(&s.checksum);
+    crc_bits(crc, data, 0, 0, &s.checksum);
+    ok = inflate_stream(data + offset, len, used, inflated, &s);
+
+    /* Compressed data cannot be forged in place */
+    region = &c->regions[c->nregions-1];
+    region->actual = (uint32_t)bigint_get_u64(&s.checksum);
+    if (s.compressed) {
+        c->nspans = region->span;
+        region->nspans = 0;
+    }
+    bigint_destroy(&s.checksum);
+    if (s.oom)
+        return out_of_memory;
+    return ok ? NULL : "invalid or truncated DEFLATE stream";
+}
+
+/* Chunks: length, type, data and a CRC of the type and data (big-endian) */
+static const char *parse_png(struct container *c, const uint8_t *data,
+                             size_t size, const struct crc_config *crc)
+{
+    size_t pos = 8, len;
+    struct container_region *region;
+    if (size < 8 || memcmp(data, "\x89PNG\r\n\x1a\n", 8))
+        return "not a PNG file";
+
+    while (pos < size) {
+        if (size - pos < 12 || (len = get32be(data + pos)) > size - pos - 12)
+            return "truncated PNG chunk";
+        if (!(region = add_region(c, data + pos + 4, 4))
+                || !add_span(c, pos + 4, len + 4)
+                || !checksum_spans(c, data, crc))
+            return out_of_memory;
+        region->field[region->nfields++] = pos + 8 + len;
+        region->big_endian = 1;
+        region->stored = get32be(data + pos + 8 + len);
+        pos += 12 + len;
+        if (!memcmp(region->name, "IEND", 4))
+            break;
+    }
+    return NULL;
+}
+
+/* Members: header, DEFLATE stream, CRC of the uncompressed data and size */
+static const char *parse_gzip(struct container *c, const uint8_t *data,
+                              size_t size, const struct crc_config *crc)
+{
+    size_t pos = 0, p, n, used;
+    const char *error;
+    struct container_region *region;
+
+    do {
+        int flags;
+        const uint8_t *name = NULL, *end;
+        if (size - pos < 18 || data[pos] != 0x1F || data[pos+1] != 0x8B
+                || data[pos+2] != 8) {
+            /* Anything after the first member is trailing garbage */
+            return pos ? NULL : "not a gzip file";
+        }
+        if ((flags = data[pos+3]) & 0xE0)
+            return "reserved gzip header flags";
+
+        /* Optional header fields (the header CRC-16 is left as is) */
+        p = pos + 10;
+        if ((flags & 4) && (p += 2 + get16le(data + p)) > size)
+            return "truncated gzip header";
+        for (n = 8; n <= 16; n += 8) {
+            if (!(flags & n))
+                continue;
+            if (!(end = memchr(data + p, 0, size - p)))
+                return "truncated gzip header";
+            if (n == 8)
+                name = data + p;
+            p = (size_t)(end - data) + 1;
+        }
+        if ((flags & 2) && (p += 2) > size)
+            return "truncated gzip header";
+
+        n = name ? strlen((const char *)name) : 0;
+        if (!(region = add_region(c, name, n)))
+            return out_of_memory;
+        if ((error = inflate_region(c, data, p, size - p, &used, crc)))
+            return error;
+        region = &c->regions[c->nregions-1];
+        if (size - (p += used) < 8)
+            return "truncated gzip trailer";
+        region->field[region->nfields++] = p;
+        region->stored = get32le(data + p);
+        pos = p + 8;
+    } while (pos < size);
+    return NULL;
+}
+
+/* Entries listed in the central directory (CRCs are little-endian) */
+static const char *parse_zip(struct container *c, const uint8_t *data,
+                             size_t size, const struct crc_config *crc)
+{
+    size_t eocd, p, i, entries, used;
+    const char *error;
+    struct container_region *region;
+
+    /* End of central directory record (followed by a comment) */
+    if (size < 22)
+        return "not a ZIP file";
+    for (eocd = size - 22; ; eocd--) {
+        if (size - eocd > 22 + 0xFFFF)
+            return "not a ZIP file";
+        if (get32le(data + eocd) == 0x06054B50)
+            break;
+        if (!eocd)
+            return "not a ZIP file";
+    }
+    entries = get16le(data + eocd + 10);
+    if (entries == 0xFFFF || get32le(data + eocd + 16) == 0xFFFFFFFF)
+        return "ZIP64 archives are not supported";
+
+    for (p = get32le(data + eocd + 16), i = 0; i < entries; i++) {
+        size_t start, next, local, descriptor;
+        uint32_t flags, method, csize;
+        if (p > size || size - p < 46 || get32le(data + p) != 0x02014B50)
+            return "invalid ZIP central directory";
+        next = p + 46 + get16le(data + p + 28) + get16le(data + p + 30)
+                      + get16le(data + p + 32);
+        flags = get16le(data + p + 8);
+        method = get16le(data + p + 10);
+        csize = get32le(data + p + 20);
+        local = get32le(data + p + 42);
+        if (next > size)
+            return "invalid ZIP central directory";
+        if ((flags & 1) || (method != 0 && method != 8)) {
+            p = next;
+            continue;
+        }
+
+        if (local > size || size - local < 30
+                || get32le(data + local) != 0x04034B50)
+            return "invalid ZIP local header";
+        start = local + 30 + get16le(data + local + 26)
+                           + get16le(data + local + 28);
+        if (start > size || csize > size - start)
+            return "truncated ZIP entry";
+
+        if (!(region = add_region(c, data + p + 46, get16le(data + p + 28))))
+            return out_of_memory;
+        if (method == 0) {
+            if (!add_span(c, start, csize) || !checksum_spans(c, data, crc))
+                return out_of_memory;
+        } else if ((error = inflate_region(c, data, start, csize, &used, crc))) {
+            return error;
+        }
+
+        /* The CRC is in the central and local headers (or data descriptor) */
+        region = &c->regions[c->nregions-1];
+        region->field[region->nfields++] = p + 16;
+        region->stored = get32le(data + p + 16);
+        if (!(flags & 8)) {
+            region->field[region->nfields++] = local + 14;
+        } else if ((descriptor = start + csize) <= size - 4) {
+            if (get32le(data + descriptor) == 0x08074B50)
+                descriptor += 4;
+            if (descriptor <= size - 4)
+                region->field[region->nfields++] = descriptor;
+        }
+        p = next;
+    }
+    return NULL;
+}
+
+int container_format(const char *format)
+{
+    return !strcmp(format, "png") || !strcmp(format, "gzip")
+        || !strcmp(format, "zip");
+}
+
+const char *container_parse(struct container *container, const char *format,
+                            const uint8_t *data, size_t size,
+                            const struct crc_config *crc)
+{
+    memset(container, 0, sizeof(*container));
+    if (!strcmp(format, "png"))
+        return parse_png(container, data, size, crc);
+    if (!strcmp(format, "gzip"))
+        return parse_gzip(container, data, size, crc);
+    if (!strcmp(format, "zip"))
+        return parse_zip(container, data, size, crc);
+    return "unknown format";
+}
+
+void container_destroy(struct container *container)
+{
+    free(container->regions);
+    free(container->spans);
+    memset(container, 0, sizeof(*container));
+}
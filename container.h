@@ -0,0 +1,66 @@
+/*
+ * CRC fields of container formats (PNG chunks, gzip members and ZIP entries).
+ */
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include "crc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Contiguous file bytes covered by a CRC */
+struct container_span {
+    uintmax_t offset;
+    uintmax_t len;
+};
+
+/*
+ * CRC-32 field of a container and the bytes it covers.
+ *
+ * The covered bytes are the concatenation of spans[span..span+nspans-1] of the
+ * file. If they are stored compressed, nspans is zero and the CRC can only be
+ * re-stamped. ZIP entries store copies of the CRC in several headers.
+ */
+struct container_region {
+    const uint8_t *name;    /* chunk type or file name (not terminated) */
+    size_t namelen;
+    uintmax_t field[2];     /* file offsets of the stored CRC copies */
+    size_t nfields;
+    int big_endian;         /* byte order of the stored CRC */
+    uint32_t stored;        /* CRC stored in field[0] */
+    uint32_t actual;        /* CRC of the covered bytes */
+    uintmax_t len;          /* number of covered bytes */
+    size_t span;
+    size_t nspans;
+};
+
+struct container {
+    struct container_region *regions;
+    size_t nregions;
+    size_t region_capacity;
+    struct container_span *spans;
+    size_t nspans;
+    size_t span_capacity;
+};
+
+/*
+ * Find the CRC fields of a "png", "gzip" or "zip" file data[0..size-1].
+ *
+ * The CRCs of the covered bytes are calculated with the CRC-32 algorithm crc
+ * (deflated gzip members and ZIP entries are decompressed on the fly). ZIP
+ * entries are found through the central directory; encrypted entries and
+ * compression methods other than stored and deflate are skipped, and ZIP64
+ * archives are not supported. Returns NULL on success or a description of the
+ * error.
+ */
+const char *container_parse(struct container *container, const char *format,
+                            const uint8_t *data, size_t size,
+                            const struct crc_config *crc);
+
+/* Is the name a format supported by container_parse() */
+int container_format(const char *format);
+
+void container_destroy(struct container *container);
+
+#endif
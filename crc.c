@@ -5,6 +5,297 @@ static const uint8_t bytebits[2][8] = {
     { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 }  /* LSB to MSB */
 };
 
+/*
+ * CRC-32C (Castagnoli) is computed by the SSE4.2 crc32 instruction on x86-64.
+ * The input is hashed in three interleaved streams of CRC32C_BLOCK bytes to
+ * hide the latency of the instruction, and the streams are combined with the
+ * shift tables of struct crc_table.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CRC32C_SSE42
+#define CRC32C_POLY 0x1EDC6F41
+#define CRC32C_BLOCK 2048
+#endif
+
+/*
+ * Slice-by-8 lookup tables for CRCs up to 64 bits wide.
+ *
+ * t[k][b] is the register value after processing byte b followed by k zero
+ * bytes. Reflected CRCs keep the register bit-reversed in the w lowest bits,
+ * while non-reflected CRCs keep it left-aligned in the 64-bit word.
+ */
+struct crc_table {
+    uint64_t t[8][256];
+#ifdef CRC32C_SSE42
+    int sse42;                  /* CRC-32C with SSE4.2 crc32 instruction */
+    uint32_t shift[4][256];     /* append CRC32C_BLOCK zero bytes */
+#endif
+};
+
+static uint64_t reflect_u64(uint64_t x)
+{
+    x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+    x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0F) | ((x & 0x0F0F0F0F0F0F0F0F) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FF) | ((x & 0x00FF00FF00FF00FF) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFF) | ((x & 0x0000FFFF0000FFFF) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+/* Process 8 bytes with reflected lookup tables */
+static inline uint64_t crc_table_reflected_8(uint64_t (*t)[256], uint64_t r,
+                                             const uint8_t *bytes)
+{
+    r ^= (uint64_t)bytes[0]       | (uint64_t)bytes[1] << 8
+       | (uint64_t)bytes[2] << 16 | (uint64_t)bytes[3] << 24
+       | (uint64_t)bytes[4] << 32 | (uint64_t)bytes[5] << 40
+       | (uint64_t)bytes[6] << 48 | (uint64_t)bytes[7] << 56;
+    return t[7][r & 0xFF]         ^ t[6][(r >> 8) & 0xFF]
+         ^ t[5][(r >> 16) & 0xFF] ^ t[4][(r >> 24) & 0xFF]
+         ^ t[3][(r >> 32) & 0xFF] ^ t[2][(r >> 40) & 0xFF]
+         ^ t[1][(r >> 48) & 0xFF] ^ t[0][r >> 56];
+}
+
+/* Process 8 bytes with left-aligned (non-reflected) lookup tables */
+static inline uint64_t crc_table_normal_8(uint64_t (*t)[256], uint64_t r,
+                                          const uint8_t *bytes)
+{
+    r ^= (uint64_t)bytes[0] << 56 | (uint64_t)bytes[1] << 48
+       | (uint64_t)bytes[2] << 40 | (uint64_t)bytes[3] << 32
+       | (uint64_t)bytes[4] << 24 | (uint64_t)bytes[5] << 16
+       | (uint64_t)bytes[6] << 8  | (uint64_t)bytes[7];
+    return t[7][r >> 56]          ^ t[6][(r >> 48) & 0xFF]
+         ^ t[5][(r >> 40) & 0xFF] ^ t[4][(r >> 32) & 0xFF]
+         ^ t[3][(r >> 24) & 0xFF] ^ t[2][(r >> 16) & 0xFF]
+         ^ t[1][(r >> 8) & 0xFF]  ^ t[0][r & 0xFF];
+}
+
+/* Process n bytes with reflected lookup tables */
+static uint64_t crc_table_reflected(uint64_t (*t)[256], uint64_t r,
+                                    const uint8_t *bytes, size_t n)
+{
+    for (; n >= 8; n -= 8, bytes += 8)
+        r = crc_table_reflected_8(t, r, bytes);
+    while (n--)
+        r = (r >> 8) ^ t[0][(r ^ *bytes++) & 0xFF];
+    return r;
+}
+
+/* Process n bytes with left-aligned lookup tables */
+static uint64_t crc_table_normal(uint64_t (*t)[256], uint64_t r,
+                                 const uint8_t *bytes, size_t n)
+{
+    for (; n >= 8; n -= 8, bytes += 8)
+        r = crc_table_normal_8(t, r, bytes);
+    while (n--)
+        r = (r << 8) ^ t[0][(r >> 56) ^ *bytes++];
+    return r;
+}
+
+#ifdef CRC32C_SSE42
+static uint32_t crc32c_shift(const struct crc_table *table, uint32_t r)
+{
+    return table->shift[0][r & 0xFF] ^ table->shift[1][(r >> 8) & 0xFF]
+         ^ table->shift[2][(r >> 16) & 0xFF] ^ table->shift[3][r >> 24];
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(const struct crc_table *table, uint32_t r,
+                             const uint8_t *bytes, size_t n)
+{
+    uint64_t r0, r1, r2, x0, x1, x2;
+    while (n >= 3 * CRC32C_BLOCK) {
+        const uint8_t *end = bytes + CRC32C_BLOCK;
+        r0 = r;
+        r1 = r2 = 0;
+        do {
+            memcpy(&x0, bytes, 8);
+            memcpy(&x1, bytes + CRC32C_BLOCK, 8);
+            memcpy(&x2, bytes + 2*CRC32C_BLOCK, 8);
+            r0 = __builtin_ia32_crc32di(r0, x0);
+            r1 = __builtin_ia32_crc32di(r1, x1);
+            r2 = __builtin_ia32_crc32di(r2, x2);
+            bytes += 8;
+        } while (bytes < end);
+        r = crc32c_shift(table, (uint32_t)r0) ^ (uint32_t)r1;
+        r = crc32c_shift(table, r) ^ (uint32_t)r2;
+        bytes += 2 * CRC32C_BLOCK;
+        n -= 3 * CRC32C_BLOCK;
+    }
+    for (r0 = r; n >= 8; n -= 8, bytes += 8) {
+        memcpy(&x0, bytes, 8);
+        r0 = __builtin_ia32_crc32di(r0, x0);
+    }
+    for (r = (uint32_t)r0; n; n--)
+        r = __builtin_ia32_crc32qi(r, *bytes++);
+    return r;
+}
+
+/* Prepare shift tables for CRC-32C if the CPU supports SSE4.2 */
+static void crc32c_tabulate(struct crc_table *table,
+                            const struct crc_config *crc)
+{
+    size_t i, k;
+    uint32_t basis[32];
+    static const uint8_t zeros[256];
+    table->sse42 = crc->width == 32 && crc->reflect_in
+                && bigint_get_u64(&crc->poly) == CRC32C_POLY
+                && __builtin_cpu_supports("sse4.2");
+    if (!table->sse42)
+        return;
+
+    /* Images of the register basis vectors after CRC32C_BLOCK zero bytes */
+    for (i = 0; i < 32; i++) {
+        uint64_t r = (uint64_t)1 << i;
+        for (k = 0; k < CRC32C_BLOCK; k += sizeof(zeros))
+            r = crc_table_reflected(table->t, r, zeros, sizeof(zeros));
+        basis[i] = (uint32_t)r;
+    }
+    for (k = 0; k < 4; k++) {
+        table->shift[k][0] = 0;
+        for (i = 1; i < 256; i++) {
+            size_t b = 0;
+            while (!(i & ((size_t)1 << b))) b++;
+            table->shift[k][i] = table->shift[k][i & (i-1)] ^ basis[8*k + b];
+        }
+    }
+}
+#endif
+
+int crc_tabulate(struct crc_config *crc)
+{
+    size_t i, k;
+    uint64_t poly;
+    struct crc_table *table;
+    const unsigned int w = crc->width;
+    if (!w || w > 64 || !(table = malloc(sizeof(struct crc_table))))
+        return 0;
+
+    poly = bigint_get_u64(&crc->poly);
+    if (crc->reflect_in) {
+        poly = reflect_u64(poly) >> (64 - w);
+        for (i = 0; i < 256; i++) {
+            uint64_t r = i;
+            for (k = 0; k < 8; k++)
+                r = (r >> 1) ^ (poly & -(r & 1));
+            table->t[0][i] = r;
+        }
+        for (k = 1; k < 8; k++) {
+            for (i = 0; i < 256; i++) {
+                uint64_t r = table->t[k-1][i];
+                table->t[k][i] = (r >> 8) ^ table->t[0][r & 0xFF];
+            }
+        }
+#ifdef CRC32C_SSE42
+        crc32c_tabulate(table, crc);
+#endif
+    } else {
+        poly <<= 64 - w;
+        for (i = 0; i < 256; i++) {
+            uint64_t r = (uint64_t)i << 56;
+            for (k = 0; k < 8; k++)
+                r = (r << 1) ^ (poly & -(r >> 63));
+            table->t[0][i] = r;
+        }
+        for (k = 1; k < 8; k++) {
+            for (i = 0; i < 256; i++) {
+                uint64_t r = table->t[k-1][i];
+                table->t[k][i] = (r << 8) ^ table->t[0][r >> 56];
+            }
+        }
+    }
+
+    crc_untabulate(crc);
+    crc->table = table;
+    return 1;
+}
+
+void crc_untabulate(struct crc_config *crc)
+{
+    free(crc->table);
+    crc->table = NULL;
+}
+
+int crc_select_engine(struct crc_config *crc, enum crc_engine engine)
+{
+    if (engine == CRC_ENGINE_SERIAL) {
+        crc_untabulate(crc);
+        return 1;
+    }
+    if (!crc_tabulate(crc))
+        return 0;
+#ifdef CRC32C_SSE42
+    if (engine == CRC_ENGINE_TABLE)
+        crc->table->sse42 = 0;
+    return engine == CRC_ENGINE_TABLE || crc->table->sse42;
+#else
+    return engine == CRC_ENGINE_TABLE;
+#endif
+}
+
+enum crc_engine crc_selected_engine(const struct crc_config *crc)
+{
+    if (!crc->table)
+        return CRC_ENGINE_SERIAL;
+#ifdef CRC32C_SSE42
+    if (crc->table->sse42)
+        return CRC_ENGINE_SSE42;
+#endif
+    return CRC_ENGINE_TABLE;
+}
+
+/* Process n bytes with lookup tables (register in the table representation) */
+static uint64_t crc_table_run(const struct crc_config *crc, uint64_t r,
+                              const uint8_t *bytes, size_t n)
+{
+    if (!crc->reflect_in)
+        return crc_table_normal(crc->table->t, r, bytes, n);
+#ifdef CRC32C_SSE42
+    if (crc->table->sse42)
+        return crc32c_sse42(crc->table, (uint32_t)r, bytes, n);
+#endif
+    return crc_table_reflected(crc->table->t, r, bytes, n);
+}
+
+/* Register value to and from the representation of the lookup tables */
+static uint64_t crc_table_load(const struct crc_config *crc, uint64_t r)
+{
+    const unsigned int w = crc->width;
+    return crc->reflect_in ? reflect_u64(r) >> (64 - w) : r << (64 - w);
+}
+
+static uint64_t crc_table_store(const struct crc_config *crc, uint64_t r)
+{
+    const unsigned int w = crc->width;
+    return crc->reflect_in ? reflect_u64(r) >> (64 - w) : r >> (64 - w);
+}
+
+/* Process n bytes with lookup tables (register is not reflected on entry) */
+static void crc_table_bytes(const struct crc_config *crc,
+                            const uint8_t *bytes, size_t n,
+                            struct bigint *reg)
+{
+    uint64_t r = crc_table_load(crc, bigint_get_u64(reg));
+    r = crc_table_run(crc, r, bytes, n);
+    bigint_load_u64(reg, crc_table_store(crc, r));
+}
+
+/* Process input bits msg[i..j-1] bit-by-bit */
+static void crc_serial_bits(const struct crc_config *crc,
+                            const uint8_t *bytes, bitsize_t i, bitsize_t j,
+                            struct bigint *reg)
+{
+    /* Reflect input bytes */
+    const uint8_t *bits = bytebits[crc->reflect_in];
+
+    while (i < j) {
+        int bit = bigint_msb(reg) ^ !!(bytes[i / 8] & bits[i % 8]);
+        bigint_shl_1(reg);
+        if (bit) bigint_xor(reg, &crc->poly);
+        i++;
+    }
+}
+
 void crc_bits(const struct crc_config *crc,
               const void *msg, bitsize_t i, bitsize_t j,
               struct bigint *checksum)
@@ -12,19 +303,18 @@ void crc_bits(const struct crc_config *crc,
     /* Input bytes */
     const uint8_t *bytes = msg;
 
-    /* Reflect input bytes */
-    const uint8_t *bits = bytebits[crc->reflect_in];
-
     /* Initial XOR value */
     bigint_xor(checksum, &crc->init);
 
-    /* Process input bits */
-    while (i < j) {
-        int bit = bigint_msb(checksum) ^ !!(bytes[i / 8] & bits[i % 8]);
-        bigint_shl_1(checksum);
-        if (bit) bigint_xor(checksum, &crc->poly);
-        i++;
+    /* Process input bits (whole bytes with lookup tables if available) */
+    if (crc->table && i + 8 <= j) {
+        bitsize_t k = (i + 7) & ~(bitsize_t)7;
+        size_t n = (size_t)((j - k) / 8);
+        crc_serial_bits(crc, bytes, i, k, checksum);
+        crc_table_bytes(crc, bytes + k/8, n, checksum);
+        i = k + 8 * (bitsize_t)n;
     }
+    crc_serial_bits(crc, bytes, i, j, checksum);
 
     /* Final XOR mask */
     bigint_xor(checksum, &crc->xor_out);
@@ -41,6 +331,124 @@ void crc(const struct crc_config *crc, const void *msg, size_t len,
     crc_bits(crc, msg, 0, 8 * (bitsize_t)len, checksum);
 }
 
+/*
+ * Hash n bytes of CRC_LANES independent messages with lookup tables.
+ *
+ * The lanes are stepped 8 bytes at a time in lockstep, so the table lookups of
+ * one message overlap the latency chains of the others.
+ */
+#define CRC_LANES 4
+
+static void crc_table_lanes(const struct crc_config *crc, uint64_t r[],
+                            const uint8_t *bytes[], size_t n)
+{
+    size_t k, i;
+    uint64_t (*t)[256] = crc->table->t;
+    if (crc->reflect_in) {
+        for (i = 0; i < n; i += 8) {
+            for (k = 0; k < CRC_LANES; k++)
+                r[k] = crc_table_reflected_8(t, r[k], bytes[k] + i);
+        }
+    } else {
+        for (i = 0; i < n; i += 8) {
+            for (k = 0; k < CRC_LANES; k++)
+                r[k] = crc_table_normal_8(t, r[k], bytes[k] + i);
+        }
+    }
+}
+
+#ifdef CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static void crc32c_sse42_lanes(uint64_t r[], const uint8_t *bytes[], size_t n)
+{
+    size_t k, i;
+    uint64_t x[CRC_LANES];
+    for (i = 0; i < n; i += 8) {
+        for (k = 0; k < CRC_LANES; k++) {
+            memcpy(&x[k], bytes[k] + i, 8);
+            r[k] = __builtin_ia32_crc32di(r[k], x[k]);
+        }
+    }
+}
+#endif
+
+/* Hash the remaining bytes of a message and store its checksum */
+static void crc_table_finish(const struct crc_config *crc, uint64_t r,
+                             const uint8_t *bytes, size_t n, uint64_t xor_out,
+                             struct bigint *checksum)
+{
+    r = crc_table_store(crc, crc_table_run(crc, r, bytes, n)) ^ xor_out;
+    if (crc->reflect_out)
+        r = reflect_u64(r) >> (64 - crc->width);
+    bigint_load_u64(checksum, r);
+}
+
+void crc_many(const struct crc_config *crc, const void *const msgs[],
+              const size_t lens[], size_t n, struct bigint out[])
+{
+    size_t k, step, lanes, active, next, msg[CRC_LANES], left[CRC_LANES];
+    uint64_t init, xor_out, r[CRC_LANES];
+    const uint8_t *bytes[CRC_LANES];
+
+    if (!crc->table) {
+        for (k = 0; k < n; k++) {
+            bigint_load_zeros(&out[k]);
+            crc_bits(crc, msgs[k], 0, 8 * (bitsize_t)lens[k], &out[k]);
+        }
+        return;
+    }
+    init = crc_table_load(crc, bigint_get_u64(&crc->init));
+    xor_out = bigint_get_u64(&crc->xor_out);
+    xor_out &= ~(uint64_t)0 >> (64 - crc->width);
+
+    for (next = 0; next < CRC_LANES && next < n; next++) {
+        msg[next] = next;
+        r[next] = init;
+        bytes[next] = msgs[next];
+        left[next] = lens[next];
+    }
+
+    /* A lane picks up the next message as soon as its message ends */
+    lanes = active = next;
+    while (active == CRC_LANES) {
+        for (step = left[0], k = 1; k < CRC_LANES; k++)
+            step = (left[k] < step) ? left[k] : step;
+        step &= ~(size_t)7;
+#ifdef CRC32C_SSE42
+        if (crc->table->sse42)
+            crc32c_sse42_lanes(r, bytes, step);
+        else
+            crc_table_lanes(crc, r, bytes, step);
+#else
+        crc_table_lanes(crc, r, bytes, step);
+#endif
+        for (k = 0; k < CRC_LANES; k++) {
+            bytes[k] += step;
+            if ((left[k] -= step) >= 8)
+                continue;
+            crc_table_finish(crc, r[k], bytes[k], left[k], xor_out,
+                             &out[msg[k]]);
+            if (next < n) {
+                msg[k] = next;
+                r[k] = init;
+                bytes[k] = msgs[next];
+                left[k] = lens[next++];
+            } else {
+                msg[k] = n;
+                active--;
+            }
+        }
+    }
+
+    /* Messages of the last lanes */
+    for (k = 0; k < lanes; k++) {
+        if (msg[k] < n) {
+            crc_table_finish(crc, r[k], bytes[k], left[k], xor_out,
+                             &out[msg[k]]);
+        }
+    }
+}
+
 void crc_append_bits(const struct crc_config *crc,
                      const void *msg, bitsize_t i, bitsize_t j,
                      struct bigint *checksum)
@@ -58,6 +466,115 @@ void crc_append(const struct crc_config *crc, const void *msg, size_t len,
     crc_append_bits(crc, msg, 0, 8 * (bitsize_t)len, checksum);
 }
 
+/* a = a·x mod P */
+static void crc_mulx(const struct crc_config *crc, struct bigint *a)
+{
+    int carry = bigint_msb(a);
+    bigint_shl_1(a);
+    if (carry) bigint_xor(a, &crc->poly);
+}
+
+/* x = a·b mod P (x must not alias a or b) */
+static void crc_mulmod(const struct crc_config *crc, struct bigint *x,
+                       const struct bigint *a, const struct bigint *b)
+{
+    bitsize_t i = crc->width;
+    bigint_load_zeros(x);
+    while (i--) {
+        crc_mulx(crc, x);
+        if (bigint_get_bit(b, i))
+            bigint_xor(x, a);
+    }
+}
+
+/* r = x^n mod P by square-and-multiply (t is work space) */
+static void crc_xpow(const struct crc_config *crc, bitsize_t n,
+                     struct bigint *r, struct bigint *t)
+{
+    int k;
+    bigint_load_zeros(r);
+    bigint_set_lsb(r);
+    if (!n)
+        return;
+    crc_mulx(crc, r);
+    for (k = 8 * sizeof(bitsize_t) - 1; !((n >> k) & 1); k--);
+    while (k-- > 0) {
+        crc_mulmod(crc, t, r, r);
+        bigint_swap(r, t);
+        if ((n >> k) & 1)
+            crc_mulx(crc, r);
+    }
+}
+
+int crc_append_zeros(const struct crc_config *crc, bitsize_t n,
+                     struct bigint *checksum)
+{
+    struct bigint r, t;
+    if (!n)
+        return 1;
+    if (!bigint_init(&r, crc->width))
+        return 0;
+    if (!bigint_init(&t, crc->width)) {
+        bigint_destroy(&r);
+        return 0;
+    }
+    crc_xpow(crc, n, &r, &t);
+
+    /* Register (without final XOR and reflection) times r */
+    if (crc->reflect_out)
+        bigint_reflect(checksum);
+    bigint_xor(checksum, &crc->xor_out);
+    crc_mulmod(crc, &t, checksum, &r);
+    bigint_mov(checksum, &t);
+    bigint_xor(checksum, &crc->xor_out);
+    if (crc->reflect_out)
+        bigint_reflect(checksum);
+
+    bigint_destroy(&t);
+    bigint_destroy(&r);
+    return 1;
+}
+
+int crc_window_solve(const struct crc_config *crc, bitsize_t size,
+                     bitsize_t pos, const struct bigint *delta,
+                     struct bigint *flips)
+{
+    int k;
+    struct bigint *v;
+    const bitsize_t w = crc->width;
+    const bitsize_t n = size - pos;
+    if (!bigint_get_bit(&crc->poly, 0) || pos > size || n < w)
+        return 0;
+    if (!(v = bigint_array_new(3, w)))
+        return 0;
+
+    /* v[0] = x^-1 mod P = (P + 1) / x */
+    bigint_mov(&v[0], &crc->poly);
+    bigint_shr_1(&v[0]);
+    bigint_set_msb(&v[0]);
+
+    /* v[1] = x^-(size - pos) mod P */
+    bigint_set_lsb(&v[1]);
+    for (k = 8 * sizeof(bitsize_t); !((n >> (k-1)) & 1); k--);
+    while (k-- > 0) {
+        crc_mulmod(crc, &v[2], &v[1], &v[1]);
+        if ((n >> k) & 1)
+            crc_mulmod(crc, &v[1], &v[2], &v[0]);
+        else
+            bigint_swap(&v[1], &v[2]);
+    }
+
+    /* Window polynomial (bit j is the coefficient of x^(w-1-j)) */
+    bigint_mov(&v[2], delta);
+    if (crc->reflect_out)
+        bigint_reflect(&v[2]);
+    crc_mulmod(crc, flips, &v[2], &v[1]);
+    bigint_reflect(flips);
+
+    bigint_array_delete(v);
+    return 1;
+}
+
 /*
  * CRC sparse engine
  */
@@ -114,15 +631,60 @@ bitmatrix_mul(const struct bigint *A, const struct bigint *B, struct bigint *X)
     return X;
 }
 
+/* Bytes of a bigint_array_new() array of n matrices of w w-bit rows */
+static uintmax_t matrix_bytes(bitsize_t n, bitsize_t w)
+{
+    return (uintmax_t)n * w
+        * (sizeof(struct bigint) + BITS_TO_LIMBS(w) * sizeof(limb_t));
+}
+
 /* New CRC calculator engine for sparse inputs and size-bit long message */
 struct crc_sparse *crc_sparse_new(const struct crc_config *crc, bitsize_t size)
 {
     uint8_t *buf;
-    bitsize_t i, j, m, n;
+    bitsize_t i, j, m, n, k, work;
     struct crc_sparse *engine;
     struct bigint *D, *L, *R, *PQ, z;
     const size_t w = crc->width;
     const uint8_t *bits = bytebits[crc->reflect_in];
+    enum crc_sparse_method method = crc->sparse;
+
+    /* Levels of the L R matrix tables */
+    for (m = 0, i = w; i; i >>= 1, m++);
+    for (n = 0, i = size; i; i >>= 1, n++);
+
+    /* Keep the levels that fit in the memory limit (D, L, R, P & Q) */
+    k = n;
+    work = 2;
+    if (method == CRC_SPARSE_MATRIX && size >= w && crc->mem_limit
+            && matrix_bytes(1 + 2*n + 2, w) > crc->mem_limit) {
+        const uintmax_t fit = crc->mem_limit / matrix_bytes(1, w);
+        k = (fit >= 1 + 2 + 4) ? (bitsize_t)((fit - 1 - 4) / 2) : 0;
+        if (k > n)
+            k = n;
+        work = 4;
+        if (!k)
+            method = CRC_SPARSE_POLY;
+    }
+
+    /* Powers of x need only two work vectors */
+    if (method == CRC_SPARSE_POLY) {
+        if (!(engine = malloc(sizeof(struct crc_sparse))))
+            return NULL;
+        if (!(engine->PQ = bigint_array_new(2, w))) {
+            free(engine);
+            return NULL;
+        }
+        memcpy(&engine->crc, crc, sizeof(struct crc_config));
+        engine->crc.sparse = CRC_SPARSE_POLY;
+        engine->size = size;
+        engine->D = engine->L = engine->R = NULL;
+        engine->depth = engine->levels = 0;
+        engine->memory = sizeof(struct crc_sparse)
+                       + 2 * (sizeof(struct bigint)
+                              + BITS_TO_LIMBS(w) * sizeof(limb_t));
+        return engine;
+    }
 
     /* Special case for short messages */
     if (size < w) {
@@ -131,17 +693,15 @@ struct crc_sparse *crc_sparse_new(const struct crc_config *crc, bitsize_t size)
         memcpy(&engine->crc, crc, sizeof(struct crc_config));
         engine->size = size;
         engine->D = engine->L = engine->R = NULL;
+        engine->depth = engine->levels = 0;
+        engine->memory = sizeof(struct crc_sparse) + (w / 8) + !!(w % 8);
         memset((char *)engine + sizeof(struct crc_sparse), 0, (w / 8) + !!(w % 8));
         return engine;
     }
 
-    /* Calculate size for L R matrix tables */
-    for (m = 0, i = w; i; i >>= 1, m++);
-    for (n = 0, i = size; i; i >>= 1, n++);
-
     /* Allocate engine and working memory */
     engine = malloc(sizeof(struct crc_sparse));
-    D = engine ? bigint_array_new((1 + 2 * n + 2) * w, w) : NULL;
+    D = engine ? bigint_array_new((1 + 2 * k + work) * w, w) : NULL;
     buf = D ? calloc(sizeof(uint8_t), ((2*w) / 8) + !!((2*w) % 8)) : NULL;
     if (!buf || !bigint_init(&z, w)) {
         free(buf);
@@ -153,8 +713,11 @@ struct crc_sparse *crc_sparse_new(const struct crc_config *crc, bitsize_t size)
     engine->size = size;
     engine->D = D;
     engine->L = L = &D[1 * w];
-    engine->R = R = &L[n * w];
-    engine->PQ = PQ =  &R[n * w];
+    engine->R = R = &L[k * w];
+    engine->PQ = PQ =  &R[k * w];
+    engine->depth = n;
+    engine->levels = k;
+    engine->memory = sizeof(struct crc_sparse) + matrix_bytes(1 + 2*k + work, w);
 
     /* Calculate D (differences of bit flips for a w-bit window) */
     crc_bits(crc, buf, 0, w, &z);
@@ -166,7 +729,7 @@ struct crc_sparse *crc_sparse_new(const struct crc_config *crc, bitsize_t size)
     }
 
     /* Solve AL = B and BR = A for power-of-2 moves up to w bits */
-    for (j = 0; j < m; j++) {
+    for (j = 0; j < m && j < k; j++) {
         size_t s = (size_t)1 << j;
         bigint_load_zeros(&z);
         crc_bits(crc, buf, 0, w + s, &z);
@@ -189,13 +752,13 @@ struct crc_sparse *crc_sparse_new(const struct crc_config *crc, bitsize_t size)
     }
     free(buf);
     bigint_destroy(&z);
-    if (j < m) {
+    if (j < m && j < k) {
         crc_sparse_delete(engine);
         return NULL;
     }
 
     /* Remaining L/R moves by squaring */
-    while (j < n) {
+    while (j < k) {
         bitmatrix_mul(&L[(j-1)*w], &L[(j-1)*w], &L[j*w]);
         bitmatrix_mul(&R[(j-1)*w], &R[(j-1)*w], &R[j*w]);
         j++;
@@ -204,17 +767,55 @@ struct crc_sparse *crc_sparse_new(const struct crc_config *crc, bitsize_t size)
     return engine;
 }
 
+/*
+ * Multiply PQ (P or Q of the work space) by the move matrices of the set bits
+ * of dist. Levels missing from the table are squared from the highest stored
+ * level into the two extra work matrices. Returns the product (P or Q).
+ */
+static struct bigint *sparse_moves(struct crc_sparse *engine,
+                                   const struct bigint *table, bitsize_t dist,
+                                   struct bigint *PQ)
+{
+    bitsize_t i;
+    const bitsize_t w = engine->crc.width;
+    struct bigint *P = &engine->PQ[0], *Q = &engine->PQ[w];
+    struct bigint *S = &engine->PQ[2*w], *T = &engine->PQ[3*w];
+    const struct bigint *M = NULL;
+
+    for (i = 0; dist; i++, dist >>= 1) {
+        if (i < engine->levels) {
+            M = &table[i*w];
+        } else {
+            struct bigint *X = (M == S) ? T : S;
+            M = bitmatrix_mul(M, M, X);
+        }
+        if (dist & 1)
+            PQ = bitmatrix_mul(PQ, M, (PQ == P) ? Q : P);
+    }
+    return PQ;
+}
+
 /* Adjust CRC checksum for a message with bit flip in the given position */
 int crc_sparse_1bit(struct crc_sparse *engine, bitsize_t pos,
                     struct bigint *checksum)
 {
-    struct bigint *P, *Q, *PQ;
-    bitsize_t ldist, rdist, i;
+    struct bigint *P, *PQ;
+    bitsize_t ldist, rdist;
     const bitsize_t w = engine->crc.width;
     const uint8_t *bits = bytebits[engine->crc.reflect_in];
     if (pos >= engine->size || checksum->bits != w)
         return 0;
 
+    /* Register difference x^(size-1-pos) · x^w mod P */
+    if (engine->crc.sparse == CRC_SPARSE_POLY) {
+        P = &engine->PQ[0];
+        crc_xpow(&engine->crc, engine->size - 1 - pos + w, P, &engine->PQ[1]);
+        if (engine->crc.reflect_out)
+            bigint_reflect(P);
+        bigint_xor(checksum, P);
+        return 1;
+    }
+
     /* Naive algorithm for short messages (engine->D unset) */
     if (!engine->D) {
         struct bigint x;
@@ -234,9 +835,7 @@ int crc_sparse_1bit(struct crc_sparse *engine, bitsize_t pos,
     }
 
     /* Work space */
-    PQ = engine->PQ;
-    P = &PQ[0];
-    Q = &PQ[w];
+    PQ = P = engine->PQ;
 
     /* ldist + w + rdist == size */
     ldist = (pos < w) ? 0 : pos - (w-1);
@@ -245,19 +844,9 @@ int crc_sparse_1bit(struct crc_sparse *engine, bitsize_t pos,
      /* P = D */
     bitmatrix_mov(P, engine->D);
 
-    /* Left moves */
-    for (i = 0; ldist; i++) {
-        if (ldist & 1)
-            PQ = bitmatrix_mul(PQ, &engine->L[i*w], (PQ == P) ? Q : P);
-        ldist >>= 1;
-    }
-
-    /* Right moves */
-    for (i = 0; rdist; i++) {
-        if (rdist & 1)
-            PQ = bitmatrix_mul(PQ, &engine->R[i*w], (PQ == P) ? Q : P);
-        rdist >>= 1;
-    }
+    /* Left and right moves */
+    PQ = sparse_moves(engine, engine->L, ldist, PQ);
+    PQ = sparse_moves(engine, engine->R, rdist, PQ);
 
     bigint_xor(checksum, &PQ[(pos < w) ? pos : w-1]);
     return 1;
@@ -267,7 +856,10 @@ int crc_sparse_1bit(struct crc_sparse *engine, bitsize_t pos,
 void crc_sparse_delete(struct crc_sparse *engine)
 {
     if (engine) {
-        bigint_array_delete(engine->D);
+        if (engine->crc.sparse == CRC_SPARSE_POLY)
+            bigint_array_delete(engine->PQ);
+        else
+            bigint_array_delete(engine->D);
         free(engine);
     }
 }
@@ -3,6 +3,19 @@
 
 #include "bigint.h"
 
+/* Checksum calculation engines */
+enum crc_engine {
+    CRC_ENGINE_SERIAL,      /* bit-by-bit algorithm */
+    CRC_ENGINE_TABLE,       /* slice-by-8 lookup tables */
+    CRC_ENGINE_SSE42        /* SSE4.2 crc32 instruction (CRC-32C only) */
+};
+
+/* Algorithms of the sparse engine */
+enum crc_sparse_method {
+    CRC_SPARSE_MATRIX,      /* products of precomputed shift matrices */
+    CRC_SPARSE_POLY         /* powers of x modulo the generator polynomial */
+};
+
 /* CRC algorithm parameters */
 struct crc_config {
     unsigned int width;     /* CRC register width in bits */
@@ -11,8 +24,34 @@ struct crc_config {
     struct bigint xor_out;  /* final register XOR mask */
     int reflect_in;         /* reverse input bits (LSB first instead of MSB) */
     int reflect_out;        /* reverse final register */
+    struct crc_table *table; /* lookup tables (NULL = bit-by-bit algorithm) */
+    enum crc_sparse_method sparse; /* algorithm of crc_sparse_new() engines */
+    uintmax_t mem_limit;    /* memory limit of sparse engines (0 = none) */
 };
 
+/*
+ * Precompute lookup tables for byte-at-a-time CRC calculation.
+ *
+ * Supports CRC registers up to 64 bits wide. Returns zero if the tables cannot
+ * be used for the CRC algorithm, in which case the slow bit-by-bit algorithm
+ * remains in use. The tables are shared by copies of the crc_config structure.
+ */
+int crc_tabulate(struct crc_config *crc);
+
+/* Release lookup tables allocated by crc_tabulate() */
+void crc_untabulate(struct crc_config *crc);
+
+/*
+ * Select the checksum calculation engine.
+ *
+ * crc_tabulate() selects the fastest engine expected to be available. Returns
+ * zero if the engine is not supported for the CRC algorithm or the CPU.
+ */
+int crc_select_engine(struct crc_config *crc, enum crc_engine engine);
+
+/* Currently selected checksum calculation engine */
+enum crc_engine crc_selected_engine(const struct crc_config *crc);
+
 /* Calculate CRC checksum of a (j-i)-bit message msg[i..j-1] */
 void crc_bits(const struct crc_config *crc,
               const void *msg, bitsize_t i, bitsize_t j,
@@ -22,6 +61,17 @@ void crc_bits(const struct crc_config *crc,
 void crc(const struct crc_config *crc, const void *msg, size_t len,
          struct bigint *checksum);
 
+/*
+ * Calculate CRC checksums of n independent messages (msgs[k] is lens[k] bytes
+ * long and its checksum is stored to out[k]).
+ *
+ * With lookup tables, several messages are hashed in interleaved lanes so that
+ * the latencies of their table lookups (or crc32 instructions) overlap. This
+ * is much faster than crc() for many short messages.
+ */
+void crc_many(const struct crc_config *crc, const void *const msgs[],
+              const size_t lens[], size_t n, struct bigint out[]);
+
 /* Append a (j-i)-bit message msg[i..j-1] to an existing checksum  */
 void crc_append_bits(const struct crc_config *crc,
                      const void *msg, bitsize_t i, bitsize_t j,
@@ -31,6 +81,30 @@ void crc_append_bits(const struct crc_config *crc,
 void crc_append(const struct crc_config *crc, const void *msg, size_t len,
                 struct bigint *checksum);
 
+/*
+ * Append n zero bits to an existing checksum.
+ *
+ * Runs in O(w² log n) time by multiplying the register by x^n mod P, which is
+ * computed by repeated squaring. Returns zero if out of memory.
+ */
+int crc_append_zeros(const struct crc_config *crc, bitsize_t n,
+                     struct bigint *checksum);
+
+/*
+ * Solve bit flips of w contiguous message bits producing a checksum change.
+ *
+ * The window covers bits msg[pos..pos+w-1] (in processing order) of a size-bit
+ * message. Flipping bit j of the window changes the register by
+ * x^(w-1-j) x^(size-pos) mod P, so the flips are the coefficients of the
+ * window polynomial delta·x^-(size-pos) mod P, found in O(w² log size) time.
+ * Bit j of `flips` is set if msg[pos+j] is flipped. Returns zero if the window
+ * does not fit in the message, the polynomial is not invertible (no x^0 term)
+ * or out of memory.
+ */
+int crc_window_solve(const struct crc_config *crc, bitsize_t size,
+                     bitsize_t pos, const struct bigint *delta,
+                     struct bigint *flips);
+
 /* CRC sparse engine for efficient checksum calculation of sparse inputs */
 struct crc_sparse {
     struct crc_config crc;  /* CRC algorithm */
@@ -39,10 +113,23 @@ struct crc_sparse {
     struct bigint *D;       /* difference matrix */
     struct bigint *L;       /* left matrix table */
     struct bigint *R;       /* right matrix table */
-    struct bigint *PQ;      /* P & Q work matrix */
+    struct bigint *PQ;      /* P & Q work matrix (or vectors) */
+
+    bitsize_t depth;        /* L/R levels needed for the message size */
+    bitsize_t levels;       /* L/R levels stored (the rest are squared) */
+    uintmax_t memory;       /* bytes allocated for the engine */
 };
 
-/* New CRC sparse engine for size-bit long message */
+/*
+ * New CRC sparse engine for size-bit long message (algorithm crc->sparse).
+ *
+ * The matrix algorithm stores 2 w×w matrices per power of two up to the size.
+ * If they exceed crc->mem_limit, only as many low levels as fit are stored and
+ * the higher ones are squared from them on demand for each bit flip (trading
+ * O(w³) time per missing level for memory). If not even one level fits, the
+ * engine falls back to powers of x (engine->crc.sparse = CRC_SPARSE_POLY),
+ * which needs only two vectors.
+ */
 struct crc_sparse *crc_sparse_new(const struct crc_config *crc, bitsize_t size);
 
 /* Adjust CRC checksum for a message with bit flip in the given position */
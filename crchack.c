@@ -1,7 +1,17 @@
 #define __USE_MINGW_ANSI_STDIO 1 /* make MinGW happy */
 #include "bigint.h"
+#include "container.h"
 #include "crc.h"
+#include "fileio.h"
 #include "forge.h"
+#include "index.h"
+#include "oracle.h"
+#include "presets.h"
+#include "recover.h"
+#include "records.h"
+#include "scan.h"
+#include "search.h"
+#include "tune.h"
 
 #include <ctype.h>
 #include <errno.h>
@@ -13,6 +23,12 @@
 static void help(char *argv0)
 {
     fprintf(stderr, "usage: %s [options] file [target_checksum]\n", argv0);
+    fprintf(stderr, "       %s --output fmt [options] file checksum "
+                    "checksum...\n", argv0);
+    fprintf(stderr, "       %s --scan n|l:r [options] file checksum...\n",
+            argv0);
+    fprintf(stderr, "       %s --recover [-w size] [-p poly] [-rR] "
+                    "[--no-reflect] file checksum file checksum...\n", argv0);
     fprintf(stderr, "\n"
     "options:\n"
     "  -o pos    byte.bit position of mutable input bits\n"
@@ -20,25 +36,85 @@ static void help(char *argv0)
     "  -b l:r:s  specify bits at positions l..r with step s\n"
     "  -h        show this help\n"
     "  -v        verbose mode\n"
+    "  --variants n  output n distinct forged messages (or patch lists)\n"
+    "  --output fmt  write output to file(s) named by printf-style fmt\n"
+    "  --charset set keep mutated bytes in a charset (e.g. print, a-z0-9)\n"
+    "  --min-flips m find a solution with few flipped bits or bytes (m)\n"
+    "  --budget sec  time limit of the search (default: 60)\n"
+    "  --work n      candidate limit of the search\n"
+    "  --range l:r   checksum and forge only bytes l..r-1 of the input\n"
+    "  --verify      checksum the forged output while writing it\n"
+    "  --analyze     report the rank of the mutable bits without hashing\n"
+    "  --oracle cmd  learn a linear checksum from cmd (prints hex per file)\n"
+    "  --scan n|l:r  find n-byte windows (or ranges from l..r) with a checksum\n"
+    "  --target-at off  forge the checksum stored at byte off (:be or :le)\n"
+    "  --record-size n  forge (or checksum) every n-byte record of the input\n"
+    "  --lines       checksum every line of the input\n"
+    "  --format fmt  fix the CRCs of a png, gzip or zip file in place\n"
+    "  --index file  resume hashing from checkpoints kept in a sidecar file\n"
+    "  --prefix n:crc  skip hashing n bytes whose checksum is known\n"
+    "  --recover     find CRC parameters from (file, checksum) samples\n"
+    "  --tune        rerun the engine benchmarks and update the cache\n"
+    "  --stats       show the selected engines\n"
+    "  --mem-limit n memory limit of the sparse engine (e.g. 512M)\n"
     "\n"
     "CRC parameters (default: CRC-32):\n"
+    "  -a name   CRC algorithm from the built-in catalogue (-a list)\n"
     "  -p poly   generator polynomial    -w size   register size in bits\n"
     "  -i init   initial register value  -x xor    final register XOR mask\n"
-    "  -r        reverse input bytes     -R        reverse final register\n");
+    "  -r        reverse input bytes     -R        reverse final register\n"
+    "  --no-reflect  drop the reflection of -a name (then -r, -R add it)\n");
 }
 
 /*
  * suckopts(): POSIXish minimal getopt(3) implementation.
+ *
+ * Long options "--name", "--name=arg" and "--name arg" are looked up from the
+ * `longopts` array (terminated by an element with a NULL name). The name of
+ * the last long option is stored in `suckname` (NULL for short options).
  */
+struct suckopt_long {
+    const char *name;
+    int has_arg;
+    int val;
+};
 static int suckind = 1;
 static int suckpos = 0;
 static int suckopt;
 static char *suckarg;
-static int suckopts(int argc, char * const argv[], const char *suckstring)
+static const char *suckname;
+static int suckopts_long(int argc, char * const argv[],
+                         const struct suckopt_long *longopts)
+{
+    const char *name = argv[suckind++] + 2;
+    size_t len = strcspn(name, "=");
+    suckname = name;
+    for (; longopts && longopts->name; longopts++) {
+        if (strlen(longopts->name) == len && !strncmp(longopts->name, name, len))
+            break;
+    }
+    if (!longopts || !longopts->name)
+        return '?';
+
+    suckopt = longopts->val;
+    if (name[len] == '=') {
+        if (!longopts->has_arg)
+            return '?';
+        suckarg = (char *)&name[len + 1];
+    } else if (longopts->has_arg) {
+        if (suckind >= argc)
+            return ':';
+        suckarg = argv[suckind++];
+    }
+    return suckopt;
+}
+static int suckopts(int argc, char * const argv[], const char *suckstring,
+                    const struct suckopt_long *longopts)
 {
     const char *p;
     suckopt = 0;
     suckarg = (char *)0;
+    suckname = (char *)0;
     if (!suckind) {
         suckpos = 0;
         suckind = 1;
@@ -52,6 +128,8 @@ static int suckopts(int argc, char * const argv[], const char *suckstring)
                 } else if (!argv[suckind][2]) {
                     suckopt = '-';
                     suckind++;
+                } else {
+                    return suckopts_long(argc, argv, longopts);
                 }
             } else if (suckstring[0] == '-') {
                 suckarg = argv[suckind++];
@@ -135,6 +213,22 @@ static struct {
     char *filename;
     FILE *in;
     FILE *out;
+    fpos_t start;
+    const char *output;
+    int verify;
+
+    struct slice range;
+    int has_range;
+    bitsize_t offset;
+
+    const char *index_file;
+    struct crc_index index;
+    uint8_t tail[INDEX_SAMPLE];
+    size_t ntail;
+    const char *prefix_arg;
+    uintmax_t prefix_len;
+    struct bigint prefix;
+    int has_prefix;
 
     size_t len;
     bitsize_t bitlen;
@@ -143,8 +237,20 @@ static struct {
 
     struct crc_config crc;
     struct crc_sparse *sparse;
+    struct crc_tuning tuning;
+    int tune;
+    int stats;
+    uintmax_t mem_limit;
     struct bigint target;
     int has_target;
+    char **target_args;     /* several targets written with --output */
+    size_t ntargets;
+    struct bigint *targets;
+
+    const char *target_at_arg;
+    intmax_t target_at;     /* byte offset of an embedded target checksum */
+    int target_at_le;
+    struct bigint field;    /* value of the embedded checksum field */
 
     bitsize_t *bits;
     bitsize_t nbits;
@@ -152,9 +258,89 @@ static struct {
     struct slice *slices;
     size_t nslices;
 
+    bitsize_t variants;
+
+    size_t record_size;
+    int lines;
+    const char *format;
+    int has_offset;
+    bitoffset_t bit_offset;
+
+    int recover;
+    char **samples;
+    size_t nsamples;
+    struct crc_hint hint;
+    size_t ambiguity;
+
+    uint8_t charset[32];
+    int has_charset;
+    int min_flips;          /* 1 = fewest bits, 2 = fewest bytes */
+    int analyze;
+    struct search_budget budget;
+
+    const char *oracle_cmd; /* external program computing the checksum */
+    struct oracle oracle;
+
+    const char *scan_arg;
+    size_t scan_window;     /* length of scanned windows (0 = regions) */
+    struct slice scan_starts;
+
     int verbose;
 } input;
 
+/*
+ * Long command-line options.
+ */
+enum {
+    OPT_VARIANTS = 256,
+    OPT_OUTPUT,
+    OPT_CHARSET,
+    OPT_BUDGET,
+    OPT_WORK,
+    OPT_RANGE,
+    OPT_RECOVER,
+    OPT_TUNE,
+    OPT_STATS,
+    OPT_INDEX,
+    OPT_PREFIX,
+    OPT_VERIFY,
+    OPT_RECORD_SIZE,
+    OPT_MEM_LIMIT,
+    OPT_LINES,
+    OPT_FORMAT,
+    OPT_TARGET_AT,
+    OPT_MIN_FLIPS,
+    OPT_ANALYZE,
+    OPT_ORACLE,
+    OPT_SCAN,
+    OPT_NO_REFLECT
+};
+static const struct suckopt_long longopts[] = {
+    { "variants", 1, OPT_VARIANTS },
+    { "output", 1, OPT_OUTPUT },
+    { "charset", 1, OPT_CHARSET },
+    { "budget", 1, OPT_BUDGET },
+    { "work", 1, OPT_WORK },
+    { "range", 1, OPT_RANGE },
+    { "recover", 0, OPT_RECOVER },
+    { "tune", 0, OPT_TUNE },
+    { "stats", 0, OPT_STATS },
+    { "index", 1, OPT_INDEX },
+    { "prefix", 1, OPT_PREFIX },
+    { "verify", 0, OPT_VERIFY },
+    { "record-size", 1, OPT_RECORD_SIZE },
+    { "mem-limit", 1, OPT_MEM_LIMIT },
+    { "lines", 0, OPT_LINES },
+    { "format", 1, OPT_FORMAT },
+    { "target-at", 1, OPT_TARGET_AT },
+    { "min-flips", 1, OPT_MIN_FLIPS },
+    { "analyze", 0, OPT_ANALYZE },
+    { "oracle", 1, OPT_ORACLE },
+    { "scan", 1, OPT_SCAN },
+    { "no-reflect", 0, OPT_NO_REFLECT },
+    { NULL, 0, 0 }
+};
+
 /*
  * Forward declarations for handle_args().
  */
@@ -164,9 +350,99 @@ static int accept_any(const char **pp, const char *set);
 
 static int parse_offset(const char *p, bitoffset_t *offset);
 static int parse_slice(const char *p, struct slice *slice);
+static int parse_range(const char *p, struct slice *range);
 
 static int handle_slice_option(const char *slice);
+static int check_output_template(const char *fmt);
+static int parse_charset(const char *p, uint8_t charset[32]);
+static int remove_duplicate_bits(void);
+static int select_bits(int has_offset, bitoffset_t offset);
+static int read_target_at(void);
+static int read_bytes(const bitsize_t offsets[], uint8_t values[], size_t n);
 static FILE *handle_message_file(const char *filename, size_t *size);
+static int handle_message_size(const char *filename, size_t *size);
+static int handle_oracle_file(const char *filename, size_t *size);
+static int learn_oracle(void);
+static int scan_ranges(void);
+
+/* Parse a byte count with an optional K, M, G or T suffix (powers of 1024) */
+static int parse_size(const char *p, uintmax_t *size)
+{
+    int n = 0, shift = 0;
+    if (sscanf(p, "%ju%n", size, &n) != 1 || !n)
+        return 0;
+    switch (p[n]) {
+    case '\0': break;
+    case 'k': case 'K': shift = 10; break;
+    case 'm': case 'M': shift = 20; break;
+    case 'g': case 'G': shift = 30; break;
+    case 't': case 'T': shift = 40; break;
+    default: return 0;
+    }
+    if (p[n] && p[n+1])
+        return 0;
+    if (*size > (UINTMAX_MAX >> shift))
+        return 0;
+    *size <<= shift;
+    return 1;
+}
+
+/* Report the memory use of a new sparse engine (with -v or --stats) */
+static void print_sparse(const struct crc_sparse *engine)
+{
+    if (input.verbose < 1 && !input.stats)
+        return;
+    fprintf(stderr, "sparse memory = %ju bytes", engine->memory);
+    if (engine->crc.sparse != input.crc.sparse)
+        fprintf(stderr, " (poly fallback for --mem-limit)");
+    else if (engine->levels < engine->depth)
+        fprintf(stderr, " (%ju of %ju levels stored, the rest squared per flip)",
+                engine->levels, engine->depth);
+    fprintf(stderr, "\n");
+}
+
+/* Origin of a tuning decision for --stats */
+static const char *tune_source(enum crc_tune_source source)
+{
+    switch (source) {
+    case CRC_TUNE_CACHED: return "cached";
+    case CRC_TUNE_BENCHMARKED: return "benchmarked";
+    default: return "default (cache not writable)";
+    }
+}
+
+/* Report the checksum engine selected by crc_autotune() */
+static void print_tuning(const struct crc_tuning *tuning)
+{
+    fprintf(stderr, "engine = %s", crc_engine_name(tuning->engine));
+    if (tuning->engine_rate > 0)
+        fprintf(stderr, " (%.0f MB/s)", tuning->engine_rate / 1e6);
+    fprintf(stderr, "\ntuning = %s\n", tune_source(tuning->engine_source));
+}
+
+/* Report the sparse engine algorithm selected by crc_autotune_sparse() */
+static void print_sparse_tuning(const struct crc_tuning *tuning)
+{
+    fprintf(stderr, "sparse = %s for 2^%u-bit messages",
+            crc_sparse_name(tuning->sparse), tuning->sparse_log2);
+    if (tuning->sparse_rate > 0)
+        fprintf(stderr, " (%.0f flips/s)", tuning->sparse_rate);
+    fprintf(stderr, ", %s\n", tune_source(tuning->sparse_source));
+}
+
+/*
+ * New sparse engine for the input message, with the algorithm selected for the
+ * message length by crc_autotune_sparse() (NULL on error).
+ */
+static struct crc_sparse *new_sparse(void)
+{
+    if (!crc_autotune_sparse(&input.crc, crc_tune_cache(), input.tune,
+                             input.bitlen, &input.tuning))
+        fputs("engine tuning failed; using default engines\n", stderr);
+    if (input.stats)
+        print_sparse_tuning(&input.tuning);
+    return crc_sparse_new(&input.crc, input.bitlen);
+}
 
 /*
  * Parse command-line arguments.
@@ -175,11 +451,12 @@ static FILE *handle_message_file(const char *filename, size_t *size);
  */
 static int handle_args(int argc, char *argv[])
 {
-    bitsize_t nbits;
     bitoffset_t offset;
-    int c, has_offset;
+    int c, has_offset, exit_code;
     size_t i, j, width;
-    char *poly, *init, reflect_in, reflect_out, *xor_out, *target;
+    const struct crc_preset *preset;
+    const char *poly, *init, *xor_out;
+    char reflect_in, reflect_out, no_reflect, *target;
 
     offset = 0;
     has_offset = 0;
@@ -187,15 +464,28 @@ static int handle_args(int argc, char *argv[])
 
     /* CRC parameters */
     width = 0;
+    preset = NULL;
     poly = init = xor_out = NULL;
-    reflect_in = reflect_out = 0;
+    reflect_in = reflect_out = no_reflect = 0;
     memset(&input, 0, sizeof(input));
+    input.budget.seconds = 60;
 
     /* Parse command options */
-    while ((c = suckopts(argc, argv, ":hvp:w:i:x:rRo:O:b:")) != -1) {
+    while ((c = suckopts(argc, argv, ":hva:p:w:i:x:rRo:O:b:", longopts)) != -1) {
         switch (c) {
         case 'h': help(argv[0]); return 1;
         case 'v': input.verbose++; break;
+        case 'a':
+            if (!strcmp(suckarg, "list")) {
+                crc_presets_fprint(stdout);
+                return 1;
+            }
+            if (!(preset = crc_preset_find(suckarg))) {
+                fprintf(stderr, "unknown CRC algorithm '%s' (see -a list)\n",
+                        suckarg);
+                return 1;
+            }
+            break;
         case 'p': poly = suckarg; break;
         case 'w':
             if (sscanf(suckarg, "%zu", &width) != 1) {
@@ -207,6 +497,7 @@ static int handle_args(int argc, char *argv[])
         case 'x': xor_out = suckarg; break;
         case 'r': reflect_in = 1; break;
         case 'R': reflect_out = 1; break;
+        case OPT_NO_REFLECT: no_reflect = 1; break;
         case 'o': case 'O':
             if (has_offset) {
                 fprintf(stderr, "multiple -oO not allowed\n");
@@ -226,12 +517,113 @@ static int handle_args(int argc, char *argv[])
             if (!handle_slice_option(suckarg))
                 return 1;
             break;
+        case OPT_VARIANTS:
+            if (sscanf(suckarg, "%ju", &input.variants) != 1
+                    || !input.variants) {
+                fprintf(stderr, "invalid number of variants '%s'\n", suckarg);
+                return 1;
+            }
+            break;
+        case OPT_OUTPUT:
+            if (!check_output_template(suckarg))
+                return 1;
+            input.output = suckarg;
+            break;
+        case OPT_CHARSET:
+            if (!parse_charset(suckarg, input.charset))
+                return 1;
+            input.has_charset = 1;
+            break;
+        case OPT_MIN_FLIPS:
+            if (!strcmp(suckarg, "bits")) {
+                input.min_flips = 1;
+            } else if (!strcmp(suckarg, "bytes")) {
+                input.min_flips = 2;
+            } else {
+                fprintf(stderr, "invalid --min-flips '%s' (bits or bytes)\n",
+                        suckarg);
+                return 1;
+            }
+            break;
+        case OPT_BUDGET:
+            if (sscanf(suckarg, "%lf", &input.budget.seconds) != 1
+                    || input.budget.seconds < 0) {
+                fprintf(stderr, "invalid search budget '%s'\n", suckarg);
+                return 1;
+            }
+            break;
+        case OPT_WORK:
+            if (sscanf(suckarg, "%ju", &input.budget.work) != 1) {
+                fprintf(stderr, "invalid search work limit '%s'\n", suckarg);
+                return 1;
+            }
+            break;
+        case OPT_RANGE:
+            if (!parse_range(suckarg, &input.range)) {
+                fprintf(stderr, "invalid range '%s'\n", suckarg);
+                return 1;
+            }
+            input.has_range = 1;
+            break;
+        case OPT_RECOVER: input.recover = 1; break;
+        case OPT_TUNE: input.tune = 1; break;
+        case OPT_STATS: input.stats = 1; break;
+        case OPT_INDEX: input.index_file = suckarg; break;
+        case OPT_PREFIX: input.prefix_arg = suckarg; break;
+        case OPT_VERIFY: input.verify = 1; break;
+        case OPT_LINES: input.lines = 1; break;
+        case OPT_ANALYZE: input.analyze = 1; break;
+        case OPT_ORACLE: input.oracle_cmd = suckarg; break;
+        case OPT_SCAN:
+            if (strchr(suckarg, ':')) {
+                if (!parse_range(suckarg, &input.scan_starts)) {
+                    fprintf(stderr, "invalid scan range '%s'\n", suckarg);
+                    return 1;
+                }
+            } else {
+                uintmax_t n;
+                if (!parse_size(suckarg, &n) || !n || n > SIZE_MAX) {
+                    fprintf(stderr, "invalid scan window '%s'\n", suckarg);
+                    return 1;
+                }
+                input.scan_window = (size_t)n;
+            }
+            input.scan_arg = suckarg;
+            break;
+        case OPT_TARGET_AT: input.target_at_arg = suckarg; break;
+        case OPT_RECORD_SIZE:
+            if (sscanf(suckarg, "%zu", &input.record_size) != 1
+                    || !input.record_size) {
+                fprintf(stderr, "invalid record size '%s'\n", suckarg);
+                return 1;
+            }
+            break;
+        case OPT_FORMAT:
+            if (!container_format(suckarg)) {
+                fprintf(stderr, "unknown format '%s' (png, gzip or zip)\n",
+                        suckarg);
+                return 1;
+            }
+            input.format = suckarg;
+            break;
+        case OPT_MEM_LIMIT:
+            if (!parse_size(suckarg, &input.mem_limit)) {
+                fprintf(stderr, "invalid memory limit '%s'\n", suckarg);
+                return 1;
+            }
+            break;
 
         case ':':
-            fprintf(stderr, "option -%c requires an argument\n", suckopt);
+            if (suckname) {
+                fprintf(stderr, "option --%s requires an argument\n", suckname);
+            } else {
+                fprintf(stderr, "option -%c requires an argument\n", suckopt);
+            }
             return 1;
         case '?':
-            if (isprint(suckopt)) {
+            if (suckname) {
+                fprintf(stderr, "unknown option --%s\n", suckname);
+            } else if (isprint(suckopt)) {
                 fprintf(stderr, "unknown option -%c\n", suckopt);
             } else {
                 fprintf(stderr, "unknown option \"\\x%02X\"\n", suckopt);
@@ -244,14 +636,79 @@ static int handle_args(int argc, char *argv[])
     }
 
     /* Determine input file argument position */
-    if (suckind == argc || suckind+2 < argc) {
+    if (input.recover) {
+        if (argc - suckind < 4 || (argc - suckind) % 2) {
+            fprintf(stderr, "--recover needs at least 2 file checksum pairs\n");
+            return 1;
+        }
+        input.samples = &argv[suckind];
+        input.nsamples = (argc - suckind) / 2;
+    } else if (suckind == argc) {
         help(argv[0]);
         return 1;
     }
     input.filename = argv[suckind];
-    target = (suckind == argc-2) ? argv[argc-1] : NULL;
+    target = (suckind+1 < argc) ? argv[suckind+1] : NULL;
+    if (input.scan_arg && suckind+1 < argc) {
+        input.target_args = &argv[suckind+1];
+        input.ntargets = argc - suckind - 1;
+    } else if (!input.recover && suckind+2 < argc) {
+        if (!input.output || !strchr(input.output, '%') || input.variants
+                || input.has_charset || input.min_flips || input.record_size
+                || input.target_at_arg || input.analyze || input.format
+                || input.lines) {
+            fputs("several target checksums need --output with %d and cannot "
+                  "be combined with --variants, --charset, --min-flips, "
+                  "--record-size, --target-at, --analyze, --format or "
+                  "--lines\n", stderr);
+            return 1;
+        }
+        input.target_args = &argv[suckind+1];
+        input.ntargets = argc - suckind - 1;
+    }
 
-    /* CRC parameters */
+    /* Oracle checksums are learned by running the command on the message */
+    if (input.oracle_cmd && (preset || poly || init || xor_out || reflect_in
+                             || reflect_out || no_reflect
+                             || input.recover || input.format
+                             || input.analyze || input.lines
+                             || input.record_size || input.has_range
+                             || input.index_file || input.prefix_arg
+                             || input.target_at_arg)) {
+        fputs("--oracle takes no CRC flags other than -w and cannot be "
+              "combined with --recover, --format, --analyze, --lines, "
+              "--record-size, --range, --index, --prefix or --target-at\n",
+              stderr);
+        return 1;
+    }
+
+    /* Forged oracle outputs are always verified by the oracle instead */
+    if (input.oracle_cmd)
+        input.verify = 0;
+
+    /* Container formats fix the CRC algorithm (CRC-32) */
+    if (input.format && (preset || width || poly || init || xor_out
+                         || reflect_in || reflect_out || no_reflect)) {
+        fprintf(stderr, "--format uses CRC-32; flags -apwixrR and "
+                "--no-reflect not allowed\n");
+        return 1;
+    }
+
+    /*
+     * CRC parameters (explicit flags override preset values). The reflection
+     * flags of a preset are kept unless --no-reflect drops them; -r and -R
+     * can only add reflection.
+     */
+    if (preset) {
+        if (!width && !poly) width = preset->width;
+        if (!poly) poly = preset->poly;
+        if (!init) init = preset->init;
+        if (!xor_out) xor_out = preset->xor_out;
+        if (!no_reflect) {
+            reflect_in |= preset->reflect_in;
+            reflect_out |= preset->reflect_out;
+        }
+    }
     if (!width && poly) {
         const char *p = poly + ((poly[0] == '0' && poly[1] == 'x') << 1);
         size_t span = strspn(p, "0123456789abcdefABCDEF");
@@ -261,11 +718,23 @@ static int handle_args(int argc, char *argv[])
         }
         width = span * 4;
     }
+    if (input.recover) {
+        /* Unknown parameters are searched by crc_recover() */
+        if (init || xor_out) fprintf(stderr, "flags -ix ignored\n");
+        input.hint.width = width;
+        input.hint.poly = poly;
+        input.hint.reflect_in = reflect_in ? 1 : no_reflect ? 0 : -1;
+        input.hint.reflect_out = reflect_out ? 1 : no_reflect ? 0 : -1;
+        return 0;
+    }
     input.crc.width = width ? width : 32;
     bigint_init(&input.crc.poly, input.crc.width);
     bigint_init(&input.crc.init, input.crc.width);
     bigint_init(&input.crc.xor_out, input.crc.width);
-    if (width || poly || init || xor_out || reflect_in || reflect_out) {
+    if (input.oracle_cmd) {
+        /* Only the width is needed (the checksum is learned) */
+    } else if (width || poly || init || xor_out || reflect_in || reflect_out
+               || no_reflect) {
         if (!poly) {
             fprintf(stderr, "custom CRC requires generator polynomial\n");
             return 1;
@@ -301,6 +770,16 @@ static int handle_args(int argc, char *argv[])
         input.crc.reflect_out = 1;
     }
 
+    /* Select the fastest engines (benchmarked on first use) */
+    if (!input.oracle_cmd) {
+        if (!crc_autotune(&input.crc, crc_tune_cache(), input.tune,
+                          &input.tuning))
+            fputs("engine tuning failed; using default engines\n", stderr);
+        if (input.stats)
+            print_tuning(&input.tuning);
+    }
+    input.crc.mem_limit = input.mem_limit;
+
     /* Read target checksum value */
     if (target) {
         bigint_init(&input.target, input.crc.width);
@@ -312,75 +791,220 @@ static int handle_args(int argc, char *argv[])
         }
         input.has_target = 1;
     }
+    if (input.ntargets) {
+        if (!(input.targets = bigint_array_new(input.ntargets,
+                                               input.crc.width))) {
+            fputs("out-of-memory allocating target checksums\n", stderr);
+            return 4;
+        }
+        for (i = 0; i < input.ntargets; i++) {
+            if (!bigint_from_string(&input.targets[i], input.target_args[i])) {
+                fprintf(stderr, "target checksum '%s' invalid %d-bit hex "
+                        "string\n", input.target_args[i], input.crc.width);
+                return 1;
+            }
+        }
+    }
+
+    /* Target checksum stored in the message (read after the message) */
+    if (input.target_at_arg) {
+        int n = 0;
+        const char *order;
+        if (sscanf(input.target_at_arg, "%jd%n", &input.target_at, &n) != 1
+                || (*(order = input.target_at_arg + n)
+                    && strcmp(order, ":le") && strcmp(order, ":be"))) {
+            fprintf(stderr, "invalid --target-at '%s'\n", input.target_at_arg);
+            return 1;
+        }
+        if (target || input.crc.width % 8) {
+            fprintf(stderr, "--target-at needs a CRC of whole bytes and no "
+                    "target checksum\n");
+            return 1;
+        }
+        if (!bigint_init(&input.target, input.crc.width)
+                || !bigint_init(&input.field, input.crc.width)) {
+            fputs("out-of-memory allocating target checksum\n", stderr);
+            return 4;
+        }
+        bigint_load_zeros(&input.target);
+        input.target_at_le = !strcmp(order, ":le");
+        input.has_target = 1;
+    }
+
+    /* Known checksum of a prefix */
+    if (input.prefix_arg) {
+        int n = 0;
+        if (sscanf(input.prefix_arg, "%ju:%n", &input.prefix_len, &n) != 1
+                || !n || !bigint_init(&input.prefix, input.crc.width)
+                || !bigint_from_string(&input.prefix, input.prefix_arg + n)) {
+            fprintf(stderr, "invalid prefix state '%s'\n", input.prefix_arg);
+            return 1;
+        }
+        input.has_prefix = 1;
+    }
+
+    if (input.analyze && (input.format || input.record_size || input.lines
+                          || input.target_at_arg)) {
+        fputs("--analyze cannot be combined with --format, --record-size, "
+              "--lines or --target-at\n", stderr);
+        return 1;
+    }
+
+    /* Ranges are searched in a view of the input by scan_ranges() */
+    if (input.scan_arg) {
+        if (!input.ntargets || input.nslices || has_offset || input.variants
+                || input.has_charset || input.min_flips || input.has_range
+                || input.index_file || input.has_prefix || input.output
+                || input.record_size || input.lines || input.target_at_arg
+                || input.analyze || input.format || input.verify
+                || input.oracle_cmd) {
+            fputs("--scan needs target checksums and cannot be combined with "
+                  "forging options, --range, --index, --prefix, --output, "
+                  "--record-size, --lines, --target-at, --analyze, --format, "
+                  "--verify or --oracle\n", stderr);
+            return 1;
+        }
+        if (input.crc.width > 64 || (!input.scan_window
+                                     && !bigint_get_bit(&input.crc.poly, 0))) {
+            fputs("--scan needs a CRC of at most 64 bits (and a polynomial "
+                  "with an x^0 term for ranges l:r)\n", stderr);
+            return 1;
+        }
+        return 0;
+    }
+
+    /* Containers are parsed and fixed in place by fix_container() */
+    if (input.format) {
+        if (input.has_target || input.variants || input.has_charset
+                || input.min_flips || input.has_range || input.index_file
+                || input.has_prefix || input.output || input.record_size
+                || input.lines) {
+            fputs("--format fixes stored CRCs in place and takes no target "
+                  "checksum, --variants, --charset, --min-flips, --range, "
+                  "--index, --prefix, --output, --record-size or --lines\n",
+                  stderr);
+            return 1;
+        }
+        if (input.verify && !has_offset && !input.nslices) {
+            fputs("--verify with --format needs mutable bits (-b, -o or "
+                  "-O)\n", stderr);
+            return 1;
+        }
+        input.has_offset = has_offset;
+        input.bit_offset = offset;
+        return 0;
+    }
+
+    /* Records are read and checksummed in batches by checksum_records() */
+    if (input.lines || (input.record_size && !input.has_target)) {
+        if (input.has_target || (input.lines && input.record_size)
+                || input.nslices || has_offset || input.variants
+                || input.has_charset || input.min_flips || input.has_range
+                || input.index_file || input.has_prefix || input.output) {
+            fputs("--lines and --record-size without a target checksum "
+                  "cannot be combined with each other, forging options or "
+                  "--range, --index, --prefix or --output\n", stderr);
+            return 1;
+        }
+        input.in = !strcmp(input.filename, "-") ? stdin
+                 : fopen(input.filename, "rb");
+        if (!input.in) {
+            fprintf(stderr, "open '%s' for reading failed\n", input.filename);
+            return 2;
+        }
+        return 0;
+    }
+
+    /* Records are read and forged one at a time by forge_records() */
+    if (input.record_size) {
+        if (input.variants || input.has_charset || input.min_flips
+                || input.has_range || input.index_file || input.has_prefix
+                || input.target_at_arg) {
+            fputs("--record-size cannot be combined with --variants, "
+                  "--charset, --min-flips, --range, --index, --prefix or "
+                  "--target-at\n", stderr);
+            return 1;
+        }
+        /* Default: the last width bits of each record */
+        if (!has_offset && !input.nslices) {
+            has_offset = 'O';
+            offset = input.crc.width;
+        }
+        input.has_offset = has_offset;
+        input.bit_offset = offset;
+        input.in = !strcmp(input.filename, "-") ? stdin
+                 : fopen(input.filename, "rb");
+        if (!input.in) {
+            fprintf(stderr, "open '%s' for reading failed\n", input.filename);
+            return 2;
+        }
+        input.out = stdout;
+        return 0;
+    }
 
-    /* Read input message */
-    if (!(input.in = handle_message_file(input.filename, &input.len)))
+    /* Read input message (only its length for --analyze and --oracle) */
+    if (input.analyze) {
+        if ((exit_code = handle_message_size(input.filename, &input.len)))
+            return exit_code;
+    } else if (input.oracle_cmd) {
+        if ((exit_code = handle_oracle_file(input.filename, &input.len)))
+            return exit_code;
+    } else if (!(input.in = handle_message_file(input.filename, &input.len))) {
         return 2;
+    }
     input.out = stdout;
     input.bitlen = 8 * (bitsize_t)input.len;
 
     /* Verbose message info */
     if (input.verbose >= 1) {
+        if (input.has_range) {
+            fprintf(stderr, "range = %ju:%ju\n",
+                    input.offset, input.offset + input.len);
+        }
         fprintf(stderr, "len(msg)");
         fprintf(stderr, " = %zu bytes", input.len);
         fprintf(stderr, " = %ju bits\n", input.bitlen);
-        fprintf(stderr, "CRC(msg) = ");
-        bigint_fprint(stderr, &input.checksum);
-        fprintf(stderr, "\n");
+        if (!input.analyze && !input.oracle_cmd) {
+            fprintf(stderr, "CRC(msg) = ");
+            bigint_fprint(stderr, &input.checksum);
+            fprintf(stderr, "\n");
+        }
     }
+    if (input.target_at_arg && (exit_code = read_target_at()))
+        return exit_code;
 
-    /* Remaining flags are required only for forging */
-    if (!input.has_target) {
+    /* Remaining flags are required only for forging (and analysis) */
+    if (!input.has_target && !input.analyze) {
         if (has_offset) fprintf(stderr, "flags -oO ignored\n");
         if (input.slices) fprintf(stderr, "flag -b ignored\n");
-        return 0;
+        if (input.variants) fprintf(stderr, "flag --variants ignored\n");
+        if (input.output) fprintf(stderr, "flag --output ignored\n");
+        if (input.has_charset) fprintf(stderr, "flag --charset ignored\n");
+        if (input.min_flips) fprintf(stderr, "flag --min-flips ignored\n");
+        return input.oracle_cmd ? learn_oracle() : 0;
     }
-
-    /* Determine (upper bound for) size of the input.bits array */
-    nbits = (has_offset || !input.nslices) ? input.crc.width : 0;
-    for (i = 0; i < input.nslices; i++) {
-        nbits += bits_of_slice(&input.slices[i], input.bitlen, input.crc.width,
-                               NULL);
+    if (input.has_charset && input.variants) {
+        fprintf(stderr, "--charset cannot be combined with --variants\n");
+        return 1;
+    }
+    if (input.min_flips && (input.has_charset || input.variants)) {
+        fprintf(stderr, "--min-flips cannot be combined with --charset or "
+                "--variants\n");
+        return 1;
+    }
+    if (input.output && !strchr(input.output, '%') && input.variants > 1) {
+        fprintf(stderr, "--output '%s' needs %%d for multiple variants\n",
+                input.output);
+        return 1;
     }
 
-    /* Fill input.bits */
-    if (nbits) {
-        /* Read bit indices from '-b' slices */
-        if (!(input.bits = calloc(nbits, sizeof(bitsize_t)))) {
-            fprintf(stderr, "error allocating bits array\n");
-            return 4;
-        }
-
-        for (i = 0; i < input.nslices; i++) {
-            input.nbits += bits_of_slice(
-                &input.slices[i], input.bitlen, input.crc.width,
-                &input.bits[input.nbits]
-            );
-        }
-
-        /* Handle '-oO' offsets */
-        if (has_offset || !input.slices) {
-            int negative = has_offset != 'o';
-            if (offset < 0) {
-                negative = !negative;
-                offset = -offset;
-            }
-            if (negative) {
-                if (input.bitlen < (bitsize_t)offset) {
-                    fprintf(stderr, "offset '-%c ", has_offset);
-                    if (has_offset == 'o') fprintf(stderr, "-");
-                    fprintf(stderr, "%jd", offset / 8);
-                    if (offset % 8) fprintf(stderr, ".%jd", offset % 8);
-                    fprintf(stderr, "' starts %ju bits before the message\n",
-                            (bitsize_t)offset - input.bitlen);
-                    return 3;
-                }
-                offset = input.bitlen - offset;
-            }
-            for (i = 0; i < input.crc.width; i++)
-                input.bits[input.nbits++] = offset + i;
-        }
+    /* A --range window is never extended: default to its last width bits */
+    if (input.has_range && !has_offset && !input.nslices) {
+        has_offset = 'O';
+        offset = input.crc.width;
     }
+    if ((exit_code = select_bits(has_offset, offset)))
+        return exit_code;
 
     /* Verbose bits info */
     if (input.verbose >= 1) {
@@ -392,6 +1016,13 @@ static int handle_args(int argc, char *argv[])
         fprintf(stderr, " }\n");
     }
 
+    /* Duplicate bits would only produce duplicate solutions */
+    if ((input.variants || input.has_charset || input.min_flips)
+            && !remove_duplicate_bits()) {
+        fprintf(stderr, "error allocating bits array\n");
+        return 4;
+    }
+
     /* Validate bit indices and pad the message buffer if needed */
     if (input.nbits) {
         for (i = j = 0; i < input.nbits; i++) {
@@ -404,6 +1035,11 @@ static int handle_args(int argc, char *argv[])
             if (input.bits[i] > input.bits[j])
                 j = i;
         }
+        if (input.has_range && input.bits[j] >= input.bitlen) {
+            fprintf(stderr, "bits[%zu]=%ju is outside the --range window "
+                    "(%ju bits)\n", j, input.bits[j], input.bitlen);
+            return 3;
+        }
 
         if (input.bits[j] >= input.bitlen) {
             size_t left;
@@ -411,7 +1047,7 @@ static int handle_args(int argc, char *argv[])
             memset(padding, 0, sizeof(padding));
             input.pad = 1 + (input.bits[j] - input.bitlen) / 8;
             input.bitlen = 8 * (bitsize_t)(input.len += input.pad);
-            left = input.pad;
+            left = input.oracle_cmd ? 0 : input.pad;
             while (left > 0) {
                 size_t n = (left < sizeof(padding)) ? left : sizeof(padding);
                 crc_append(&input.crc, padding, n, &input.checksum);
@@ -422,51 +1058,120 @@ static int handle_args(int argc, char *argv[])
         }
     }
 
-    /* Create sparse CRC calculation engine */
-    if (!(input.sparse = crc_sparse_new(&input.crc, input.bitlen))) {
+    /* Learn the oracle or create sparse CRC calculation engine */
+    if (input.oracle_cmd)
+        return learn_oracle();
+    if (!(input.sparse = new_sparse())) {
         fputs("error initializing sparse CRC engine (bad params?)\n", stderr);
         return 5;
     }
+    print_sparse(input.sparse);
 
     return 0;
 }
 
-/*
- * Recursive descent parser for slices (-b).
- */
-static int peek(const char **pp)
-{
-    while (**pp == ' ') (*pp)++;
-    return **pp;
-}
-
-static int accept(const char **pp, char ch)
+/* Maximum number of bits taken from a -b slice (0 = unlimited) */
+static bitsize_t slice_limit(void)
 {
-    return peek(pp) == ch ? *(*pp)++ : 0;
+    /* Variants and searches need free bits beyond the CRC width */
+    return (input.variants || input.has_charset || input.min_flips)
+         ? 0 : input.crc.width;
 }
 
-static int accept_any(const char **pp, const char *set)
+/*
+ * Fill input.bits with the mutable bits of a message of input.bitlen bits
+ * selected by the -b slices and the -o/-O offset.
+ *
+ * Returns an exit code (0 for success).
+ */
+static int select_bits(int has_offset, bitoffset_t offset)
 {
-    int ch = peek(pp);
-    while (*set && ch != *set) set++;
-    return *set ? accept(pp, ch) : 0;
-}
+    size_t i;
+    bitsize_t nbits, limit;
 
-static const char *parse_expression(const char *p, bitoffset_t *value);
-static const char *parse_factor(const char *p, bitoffset_t *value)
-{
-    int dot = accept(&p, '.');
+    /* Determine (upper bound for) size of the input.bits array */
+    limit = slice_limit();
+    nbits = (has_offset || !input.nslices) ? input.crc.width : 0;
+    for (i = 0; i < input.nslices; i++)
+        nbits += bits_of_slice(&input.slices[i], input.bitlen, limit, NULL);
 
-    switch (peek(&p)) {
-    case '0': case'1': case '2': case '3': case '4':
-    case '5': case'6': case '7': case '8': case '9':
-        errno = 0;
-        if (p[0] == '0' && p[1] == 'x') {
-            *value = (bitoffset_t)strtoull(p + 2, (char **)&p, 16);
-            if (errno) perror("invalid unsigned hex integer");
-        } else {
-            *value = (bitoffset_t)strtoll(p, (char **)&p, 10);
-            if (errno) perror("invalid signed integer");
+    /* Fill input.bits */
+    if (nbits) {
+        /* Read bit indices from '-b' slices */
+        if (!(input.bits = calloc(nbits, sizeof(bitsize_t)))) {
+            fprintf(stderr, "error allocating bits array\n");
+            return 4;
+        }
+
+        for (i = 0; i < input.nslices; i++) {
+            input.nbits += bits_of_slice(
+                &input.slices[i], input.bitlen, limit,
+                &input.bits[input.nbits]
+            );
+        }
+
+        /* Handle '-oO' offsets */
+        if (has_offset || !input.slices) {
+            int negative = has_offset != 'o';
+            if (offset < 0) {
+                negative = !negative;
+                offset = -offset;
+            }
+            if (negative) {
+                if (input.bitlen < (bitsize_t)offset) {
+                    fprintf(stderr, "offset '-%c ", has_offset);
+                    if (has_offset == 'o') fprintf(stderr, "-");
+                    fprintf(stderr, "%jd", offset / 8);
+                    if (offset % 8) fprintf(stderr, ".%jd", offset % 8);
+                    fprintf(stderr, "' starts %ju bits before the message\n",
+                            (bitsize_t)offset - input.bitlen);
+                    return 3;
+                }
+                offset = input.bitlen - offset;
+            }
+            for (i = 0; i < input.crc.width; i++)
+                input.bits[input.nbits++] = offset + i;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Recursive descent parser for slices (-b).
+ */
+static int peek(const char **pp)
+{
+    while (**pp == ' ') (*pp)++;
+    return **pp;
+}
+
+static int accept(const char **pp, char ch)
+{
+    return peek(pp) == ch ? *(*pp)++ : 0;
+}
+
+static int accept_any(const char **pp, const char *set)
+{
+    int ch = peek(pp);
+    while (*set && ch != *set) set++;
+    return *set ? accept(pp, ch) : 0;
+}
+
+static const char *parse_expression(const char *p, bitoffset_t *value);
+static const char *parse_factor(const char *p, bitoffset_t *value)
+{
+    int dot = accept(&p, '.');
+
+    switch (peek(&p)) {
+    case '0': case'1': case '2': case '3': case '4':
+    case '5': case'6': case '7': case '8': case '9':
+        errno = 0;
+        if (p[0] == '0' && p[1] == 'x') {
+            *value = (bitoffset_t)strtoull(p + 2, (char **)&p, 16);
+            if (errno) perror("invalid unsigned hex integer");
+        } else {
+            *value = (bitoffset_t)strtoll(p, (char **)&p, 10);
+            if (errno) perror("invalid signed integer");
         }
         if (errno) {
             p = NULL;
@@ -607,6 +1312,34 @@ static int parse_slice(const char *p, struct slice *slice)
     return 1;
 }
 
+/* Byte-aligned l:r or l:+n window (either end may be omitted) */
+static int parse_range(const char *p, struct slice *range)
+{
+    range->s = 1;
+    range->l = 0;
+    range->r = (bitoffset_t)(~(bitsize_t)0 >> 4 << 3);
+    if (peek(&p) != ':' && !(p = parse_slice_offset(p, &range->l)))
+        return 0;
+    if (!accept(&p, ':')) {
+        fprintf(stderr, "missing ':' in range\n");
+        return 0;
+    }
+    range->relative = !!accept(&p, '+');
+    if (peek(&p) || range->relative) {
+        if (!(p = parse_slice_offset(p, &range->r)))
+            return 0;
+        if (peek(&p)) {
+            fprintf(stderr, "junk '%s' after range\n", p);
+            return 0;
+        }
+    }
+    if (range->l % 8 || range->r % 8) {
+        fprintf(stderr, "range must be byte-aligned\n");
+        return 0;
+    }
+    return 1;
+}
+
 static int handle_slice_option(const char *slice)
 {
     /* Brace expansions */
@@ -678,11 +1411,373 @@ static int handle_slice_option(const char *slice)
     return 1;
 }
 
+/*
+ * Output file name templates contain at most one %d conversion (with optional
+ * flags and field width) and literal %% characters.
+ */
+static int check_output_template(const char *fmt)
+{
+    int n = 0;
+    const char *p = fmt;
+    while ((p = strchr(p, '%'))) {
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+        p += 1 + strspn(p + 1, "-0 +#");
+        p += strspn(p, "0123456789");
+        if (*p++ != 'd' || n++) {
+            fprintf(stderr, "invalid output template '%s' (use one %%d)\n",
+                    fmt);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Charsets (--charset) are named character classes or lists of characters and
+ * ranges such as "a-zA-Z0-9_" where "\xHH" and "\c" escape a single byte.
+ */
+static int isbase64(int c)
+{
+    return isalnum(c) || c == '+' || c == '/';
+}
+
+static const struct {
+    const char *name;
+    int (*test)(int c);
+} charset_classes[] = {
+    { "print", isprint }, { "graph", isgraph }, { "alnum", isalnum },
+    { "alpha", isalpha }, { "digit", isdigit }, { "xdigit", isxdigit },
+    { "lower", islower }, { "upper", isupper }, { "base64", isbase64 },
+    { NULL, NULL }
+};
+
+static int parse_charset_char(const char **pp)
+{
+    const char *p = *pp;
+    int c = (unsigned char)*p++;
+    if (c == '\\') {
+        if (p[0] == 'x' && isxdigit((unsigned char)p[1])
+                        && isxdigit((unsigned char)p[2])) {
+            char hex[3] = { p[1], p[2], '\0' };
+            c = (int)strtol(hex, NULL, 16);
+            p += 3;
+        } else if (*p) {
+            c = (unsigned char)*p++;
+        } else {
+            return -1;
+        }
+    }
+    *pp = p;
+    return c;
+}
+
+static int parse_charset(const char *p, uint8_t charset[32])
+{
+    int c, lo, hi;
+    const char *spec = p;
+    memset(charset, 0, 32);
+    for (c = 0; charset_classes[c].name; c++) {
+        if (!strcmp(charset_classes[c].name, spec)) {
+            for (lo = 0; lo < 256; lo++) {
+                if (charset_classes[c].test(lo))
+                    charset[lo / 8] |= 1 << (lo % 8);
+            }
+            return 1;
+        }
+    }
+
+    while (*p) {
+        if ((lo = hi = parse_charset_char(&p)) < 0)
+            break;
+        if (p[0] == '-' && p[1]) {
+            p++;
+            if ((hi = parse_charset_char(&p)) < lo)
+                break;
+        }
+        for (c = lo; c <= hi; c++)
+            charset[c / 8] |= 1 << (c % 8);
+    }
+    if (*p || !*spec) {
+        fprintf(stderr, "invalid charset '%s'\n", spec);
+        return 0;
+    }
+    return 1;
+}
+
+static FILE *open_output(bitsize_t k)
+{
+    FILE *out;
+    char *name;
+    size_t size = strlen(input.output) + 3 * sizeof(int) + 1;
+    if (!(name = malloc(size))) {
+        fputs("out-of-memory allocating output file name\n", stderr);
+        return NULL;
+    }
+    snprintf(name, size, input.output, (int)k);
+    if (!(out = fopen(name, "wb")))
+        fprintf(stderr, "open '%s' for writing failed\n", name);
+    free(name);
+    return out;
+}
+
+/*
+ * Seek to the beginning of the --range window and return its length.
+ */
+static int seek_range(FILE *in, bitsize_t *window)
+{
+    uintmax_t size;
+    bitsize_t end;
+    bitoffset_t l = input.range.l, r = input.range.r;
+    if (fileio_size(in, &size) != 0) {
+        fputs("cannot determine input size for --range\n", stderr);
+        return 0;
+    }
+    end = 8 * (bitsize_t)size;
+
+    if (l < 0 && (l += end) < 0) l = 0;
+    if ((bitsize_t)l > end) {
+        fprintf(stderr, "range starts after the end of input (%ju bytes)\n",
+                size);
+        return 0;
+    }
+    if (input.range.relative) r += l;
+    if (r < 0 && (r += end) < 0) r = 0;
+    else if ((bitsize_t)r > end) r = end;
+    if (r < l) r = l;
+
+    input.offset = (bitsize_t)l / 8;
+    *window = (bitsize_t)(r - l) / 8;
+    if (fileio_seek(in, input.offset) != 0) {
+        fprintf(stderr, "seeking to input offset %ju failed\n", input.offset);
+        return 0;
+    }
+    return 1;
+}
+
+/* Append pending zero bytes to the input checksum */
+static int append_zeros(bitsize_t *zeros)
+{
+    if (*zeros && !crc_append_zeros(&input.crc, 8 * *zeros, &input.checksum)) {
+        fputs("out of memory for appending zeros\n", stderr);
+        return 0;
+    }
+    *zeros = 0;
+    return 1;
+}
+
+/* Keep the last INDEX_SAMPLE hashed bytes (NULL for zeros) for checkpoints */
+static void track_tail(const void *bytes, uintmax_t n)
+{
+    size_t keep;
+    if (n >= INDEX_SAMPLE) {
+        if (bytes)
+            memcpy(input.tail, (const char *)bytes + (n - INDEX_SAMPLE),
+                   INDEX_SAMPLE);
+        else
+            memset(input.tail, 0, INDEX_SAMPLE);
+        input.ntail = INDEX_SAMPLE;
+        return;
+    }
+    keep = INDEX_SAMPLE - (size_t)n;
+    if (keep > input.ntail)
+        keep = input.ntail;
+    memmove(input.tail, input.tail + (input.ntail - keep), keep);
+    if (bytes)
+        memcpy(input.tail + keep, bytes, (size_t)n);
+    else
+        memset(input.tail + keep, 0, (size_t)n);
+    input.ntail = keep + (size_t)n;
+}
+
+/* Read the bytes preceding offset into input.tail (leaves in at offset) */
+static int read_tail(FILE *in, uintmax_t offset)
+{
+    input.ntail = offset < INDEX_SAMPLE ? (size_t)offset : INDEX_SAMPLE;
+    return fileio_seek(in, offset - input.ntail) == 0
+        && fread(input.tail, sizeof(char), input.ntail, in) == input.ntail;
+}
+
+/* Record a checkpoint of the hashed prefix in the index file */
+static int add_checkpoint(uintmax_t offset, bitsize_t *zeros)
+{
+    int ok;
+    struct bigint sample;
+    if (!append_zeros(zeros))
+        return 0;
+    if (!bigint_init(&sample, input.crc.width)) {
+        fputs("out-of-memory allocating checkpoint\n", stderr);
+        return 0;
+    }
+    crc(&input.crc, input.tail, input.ntail, &sample);
+    if (!(ok = crc_index_add(&input.index, offset, &input.checksum, &sample)))
+        fprintf(stderr, "error writing index '%s'\n", input.index_file);
+    bigint_destroy(&sample);
+    return ok;
+}
+
+/*
+ * Start hashing after a known prefix state (--prefix) or the last valid
+ * checkpoint of the index (--index), and reopen the index for writing.
+ */
+static int resume_hashing(FILE *in, int seekable, size_t *size)
+{
+    size_t i, keep = 0;
+    intmax_t mtime;
+    uintmax_t file_size, offset = 0;
+    const struct bigint *checksum = NULL;
+
+    if (!seekable || input.has_range || !fileio_stat(in, &file_size, &mtime)) {
+        fputs("--index and --prefix need a regular input file "
+              "(and no --range)\n", stderr);
+        return 0;
+    }
+    if (input.has_prefix) {
+        if (input.prefix_len > file_size) {
+            fprintf(stderr, "prefix of %ju bytes exceeds the input\n",
+                    input.prefix_len);
+            return 0;
+        }
+        offset = input.prefix_len;
+        checksum = &input.prefix;
+    }
+
+    if (input.index_file) {
+        /*
+         * Checkpoints of a changed file must still match their samples. They
+         * are checked in order up to the first mismatch, so a same-size edit
+         * resumes from the last checkpoint before the edited bytes.
+         */
+        int unchanged;
+        struct bigint sample;
+        if (crc_index_load(&input.index, input.index_file, &input.crc) < 0
+                || !bigint_init(&sample, input.crc.width)) {
+            fputs("out-of-memory loading index\n", stderr);
+            return 0;
+        }
+        unchanged = mtime != -1 && input.index.size == file_size
+                 && input.index.mtime == mtime;
+        for (i = 0; i < input.index.n; i++) {
+            const struct crc_checkpoint *cp = &input.index.cp[i];
+            if (cp->offset > file_size)
+                break;
+            if (!unchanged) {
+                if (!read_tail(in, cp->offset))
+                    break;
+                bigint_load_zeros(&sample);
+                crc(&input.crc, input.tail, input.ntail, &sample);
+                bigint_xor(&sample, &cp->sample);
+                if (!bigint_is_zero(&sample))
+                    break;
+            }
+            keep = i + 1;
+        }
+        bigint_destroy(&sample);
+        if (keep && input.index.cp[keep - 1].offset >= offset) {
+            offset = input.index.cp[keep - 1].offset;
+            checksum = &input.index.cp[keep - 1].checksum;
+        }
+        if (!read_tail(in, offset)) {
+            fprintf(stderr, "error reading message from '%s'\n",
+                    input.filename);
+            return 0;
+        }
+    }
+
+    if (checksum)
+        bigint_mov(&input.checksum, checksum);
+    if (fileio_seek(in, offset) != 0) {
+        fprintf(stderr, "error seeking to offset %ju\n", offset);
+        return 0;
+    }
+    *size = (size_t)offset;
+    if (input.verbose >= 1 && offset)
+        fprintf(stderr, "resuming at offset %ju\n", offset);
+
+    if (input.index_file && !crc_index_open(&input.index, input.index_file,
+                                            &input.crc, file_size, mtime,
+                                            keep)) {
+        fprintf(stderr, "error writing index '%s'\n", input.index_file);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Determine the message length for --analyze without reading the message.
+ *
+ * The checksum is left zero (the analysis needs only the difference columns).
+ * Returns an exit code (0 for success).
+ */
+static int handle_message_size(const char *filename, size_t *size)
+{
+    uintmax_t n;
+    bitsize_t window;
+    FILE *in;
+
+    if (!bigint_init(&input.checksum, input.crc.width)) {
+        fputs("out-of-memory allocating checksum\n", stderr);
+        return 4;
+    }
+    bigint_load_zeros(&input.checksum);
+    if (!strcmp(filename, "-") || !(in = fopen(filename, "rb"))) {
+        fprintf(stderr, "open '%s' for reading failed (--analyze needs a "
+                "regular file)\n", filename);
+        return 2;
+    }
+    if (input.has_range) {
+        n = seek_range(in, &window) ? window : UINTMAX_MAX;
+    } else if (fileio_size(in, &n) != 0) {
+        fprintf(stderr, "cannot determine the size of '%s'\n", filename);
+        n = UINTMAX_MAX;
+    }
+    fclose(in);
+    if (n == UINTMAX_MAX)
+        return 2;
+    if (n > SIZE_MAX / 8) {
+        fprintf(stderr, "'%s' is too large (%ju bytes)\n", filename, n);
+        return 2;
+    }
+    *size = (size_t)n;
+    return 0;
+}
+
+/*
+ * Open the message for --oracle without reading it (the oracle command reads
+ * the message, and its checksum is learned by learn_oracle()). Returns an exit
+ * code (0 for success).
+ */
+static int handle_oracle_file(const char *filename, size_t *size)
+{
+    uintmax_t n;
+
+    if (!bigint_init(&input.checksum, input.crc.width)) {
+        fputs("out-of-memory allocating checksum\n", stderr);
+        return 4;
+    }
+    bigint_load_zeros(&input.checksum);
+    if (!strcmp(filename, "-") || !(input.in = fopen(filename, "rb"))
+            || fgetpos(input.in, &input.start) != 0) {
+        fprintf(stderr, "open '%s' for reading failed (--oracle needs a "
+                "regular file)\n", filename);
+        return 2;
+    }
+    if (fileio_size(input.in, &n) != 0 || n > SIZE_MAX / 8) {
+        fprintf(stderr, "cannot determine the size of '%s'\n", filename);
+        return 2;
+    }
+    *size = (size_t)n;
+    return 0;
+}
+
 static FILE *handle_message_file(const char *filename, size_t *size)
 {
-    fpos_t start;
     FILE *in, *temp;
-    char buf[BUFSIZ];
+    bitsize_t left, zeros, holes;
+    uintmax_t checkpoint;
+    struct fileio_reader *reader = NULL;
 
     /* Initialize CRC for empty message */
     if (!bigint_init(&input.checksum, input.crc.width))
@@ -697,8 +1792,8 @@ static FILE *handle_message_file(const char *filename, size_t *size)
     }
 
     temp = NULL;
-    if (input.has_target) {
-        if (in == stdin || fgetpos(in, &start) != 0) {
+    if (input.has_target || input.has_range) {
+        if (in == stdin || fgetpos(in, &input.start) != 0) {
             /*
              * Modifying input message but got a non-seekable file stream.
              * As a workaround, copy the input message to a temporary file.
@@ -710,7 +1805,19 @@ static FILE *handle_message_file(const char *filename, size_t *size)
                 goto fail;
             }
         }
-        if (fgetpos(temp ? temp : in, &start) != 0) {
+        if (temp && input.has_range) {
+            /* Seeking the window needs the whole input in the temp file */
+            fileio_copy(in, temp, UINTMAX_MAX);
+            if (ferror(in) || ferror(temp) || fflush(temp) != 0) {
+                fputs("error copying input message to temp file\n", stderr);
+                goto fail;
+            }
+            fclose(in);
+            in = temp;
+            temp = NULL;
+            rewind(in);
+        }
+        if (fgetpos(temp ? temp : in, &input.start) != 0) {
             fputs("fgetpos() error for ", stderr);
             if (temp) fputs("temp file of ", stderr);
             fprintf(stderr, "input file '%s'\n", filename);
@@ -718,12 +1825,48 @@ static FILE *handle_message_file(const char *filename, size_t *size)
         }
     }
 
-    while (!feof(in)) {
-        size_t n = fread(buf, sizeof(char), BUFSIZ, in);
-        if (ferror(in)) {
+    left = ~(bitsize_t)0;
+    if (input.has_range && !seek_range(in, &left))
+        goto fail;
+
+    if ((input.has_prefix || input.index_file)
+            && !resume_hashing(in, in != stdin && !temp, size))
+        goto fail;
+    checkpoint = (*size / INDEX_INTERVAL + 1) * INDEX_INTERVAL;
+
+    /* The next blocks are read in the background while one is being hashed */
+    if (!(reader = fileio_reader_new(in, left, !temp))) {
+        fputs("out-of-memory allocating read buffers\n", stderr);
+        goto fail;
+    }
+
+    zeros = holes = 0;
+    for (;;) {
+        const char *buf;
+        size_t n;
+        uintmax_t skip;
+        int ret;
+        if (input.index.out && *size >= checkpoint) {
+            if (!add_checkpoint(*size, &zeros))
+                goto fail;
+            checkpoint = (*size / INDEX_INTERVAL + 1) * INDEX_INTERVAL;
+        }
+        if ((ret = fileio_reader_next(reader, &buf, &n, &skip)) <= 0) {
+            if (!ret)
+                break;
             fprintf(stderr, "error reading message from '%s'\n", filename);
             goto fail;
-        } else if (temp) {
+        }
+        if (skip) {
+            /* Holes of sparse files are skipped without reading them */
+            zeros += skip;
+            holes += skip;
+            *size += skip;
+            if (input.index.out)
+                track_tail(NULL, skip);
+        }
+
+        if (temp) {
             size_t i = 0;
             while (i < n) {
                 size_t m = fwrite(buf + i, sizeof(char), n - i, temp);
@@ -734,9 +1877,30 @@ static FILE *handle_message_file(const char *filename, size_t *size)
                 i += m;
             }
         }
-        crc_append(&input.crc, buf, n, &input.checksum);
+        if (n && !buf[0] && !memcmp(buf, buf + 1, n - 1)) {
+            /* Zero runs are appended in logarithmic time */
+            zeros += n;
+        } else {
+            if (!append_zeros(&zeros))
+                goto fail;
+            crc_append(&input.crc, buf, n, &input.checksum);
+        }
+        if (input.index.out)
+            track_tail(buf, n);
         *size += n;
     }
+    fileio_reader_delete(reader);
+    reader = NULL;
+
+    if (!append_zeros(&zeros))
+        goto fail;
+    if (input.index.out && (!input.index.n
+            || input.index.cp[input.index.n - 1].offset != *size)) {
+        if (!add_checkpoint(*size, &zeros))
+            goto fail;
+    }
+    if (input.verbose >= 1 && holes)
+        fprintf(stderr, "skipped %ju bytes of holes\n", (uintmax_t)holes);
 
     if (input.has_target) {
         /* Rewind */
@@ -744,7 +1908,7 @@ static FILE *handle_message_file(const char *filename, size_t *size)
             fclose(in);
             in = temp;
         }
-        if (fsetpos(in, &start) != 0) {
+        if (fsetpos(in, &input.start) != 0) {
             fputs("fsetpos() error for ", stderr);
             if (temp) fputs("temporary file of ", stderr);
             fprintf(stderr, "input file '%s'\n", filename);
@@ -755,29 +1919,154 @@ static FILE *handle_message_file(const char *filename, size_t *size)
     return in;
 
 fail:
-    if (input.has_target && temp != NULL)
+    fileio_reader_delete(reader);
+    if (temp != NULL)
         fclose(temp);
     fclose(in);
     return NULL;
 }
 
-static void input_crc(bitsize_t pos, struct bigint *checksum)
+/* Message bit index (LSB first within bytes) in CRC processing order */
+static bitsize_t stream_bit(bitsize_t pos)
 {
-    bigint_mov(checksum, &input.checksum);
-    if (pos < input.bitlen) {
-        if (!input.crc.reflect_in)
-            pos = (pos & ~7) | (7 - (pos & 7));
-        crc_sparse_1bit(input.sparse, pos, checksum);
-    }
+    return input.crc.reflect_in ? pos : (pos & ~7) | (7 - (pos & 7));
 }
 
-/* Input array A[0..n] and work array B[0..n] */
-static void merge_sort_recurse(bitsize_t *A, size_t n, bitsize_t *B)
+/* Bit of the --target-at field value stored in message bit pos (or -1) */
+static bitoffset_t field_bit(bitsize_t pos)
 {
-    const size_t m = n / 2;
-    if (m > 0) {
-        size_t i, j, k;
-        merge_sort_recurse(B, m, A);
+    bitsize_t byte;
+    const bitsize_t start = 8 * (bitsize_t)input.target_at;
+    const bitsize_t nbytes = input.crc.width / 8;
+    if (!input.target_at_arg || pos < start || pos - start >= 8 * nbytes)
+        return -1;
+    byte = (pos - start) / 8;
+    return 8 * (input.target_at_le ? byte : nbytes-1 - byte) + pos % 8;
+}
+
+/*
+ * Read the --target-at checksum field from the input message.
+ *
+ * The forged checksum must equal the field after the bit flips, so the system
+ * CRC(msg) ^ field(msg) = 0 is solved instead; flipping a bit of the field
+ * changes both sides, which input_crc() accounts for. Returns an exit code.
+ */
+static int read_target_at(void)
+{
+    size_t i, j;
+    int exit_code = 0;
+    const size_t n = input.crc.width / 8;
+    const intmax_t len = (intmax_t)input.len;
+    bitsize_t *offsets;
+    uint8_t *values;
+
+    if (input.target_at < 0)
+        input.target_at += len;
+    if (input.target_at < 0 || input.target_at > len
+            || (size_t)(len - input.target_at) < n) {
+        fprintf(stderr, "--target-at field exceeds the message (%zu bytes)\n",
+                input.len);
+        return 3;
+    }
+    offsets = malloc(n * sizeof(bitsize_t));
+    values = malloc(n);
+    if (!offsets || !values) {
+        fputs("out-of-memory allocating target checksum\n", stderr);
+        exit_code = 4;
+        goto finish;
+    }
+    for (i = 0; i < n; i++)
+        offsets[i] = (bitsize_t)input.target_at + i;
+    if (!read_bytes(offsets, values, n)) {
+        exit_code = 2;
+        goto finish;
+    }
+
+    bigint_load_zeros(&input.field);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < 8; j++) {
+            if ((values[i] >> j) & 1)
+                bigint_set_bit(&input.field, field_bit(8*offsets[i] + j));
+        }
+    }
+    if (input.verbose >= 1) {
+        fprintf(stderr, "field(msg) = ");
+        bigint_fprint(stderr, &input.field);
+        fprintf(stderr, " at byte %jd (%s)\n", input.target_at,
+                input.target_at_le ? "le" : "be");
+    }
+
+finish:
+    free(values);
+    free(offsets);
+    return exit_code;
+}
+
+/* Value of the --target-at field after flipping bits flips[0..n-1] */
+static void field_value(const bitsize_t flips[], size_t n,
+                        struct bigint *value)
+{
+    size_t i;
+    bitoffset_t bit;
+    bigint_mov(value, &input.field);
+    for (i = 0; i < n; i++) {
+        if ((bit = field_bit(flips[i])) >= 0)
+            bigint_flip_bit(value, bit);
+    }
+}
+
+/*
+ * Difference columns of the sorted unique mutable bits for --analyze and
+ * --oracle. The columns depend only on the message length, and each one is
+ * computed (or learned from the oracle) only once.
+ */
+static struct {
+    bitsize_t *pos;
+    struct bigint *col;
+    size_t n;
+} columns;
+
+/* Column of mutable bit pos (NULL if not found) */
+static const struct bigint *find_column(bitsize_t pos)
+{
+    size_t lo = 0, hi = columns.n;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (columns.pos[mid] <= pos) lo = mid; else hi = mid;
+    }
+    return (columns.n && columns.pos[lo] == pos) ? &columns.col[lo] : NULL;
+}
+
+/*
+ * Checksum of the message with bit pos flipped (the message itself if pos is
+ * out of range). With --target-at, the target field is subtracted, so that
+ * the target is zero and the flips of the field bits are accounted for.
+ */
+static void input_crc(bitsize_t pos, struct bigint *checksum)
+{
+    bitoffset_t bit;
+    const struct bigint *col;
+    bigint_mov(checksum, &input.checksum);
+    if (input.oracle_cmd) {
+        if (pos < input.bitlen && (col = find_column(pos)))
+            bigint_xor(checksum, col);
+    } else if (pos < input.bitlen) {
+        crc_sparse_1bit(input.sparse, stream_bit(pos), checksum);
+    }
+    if (input.target_at_arg) {
+        bigint_xor(checksum, &input.field);
+        if ((bit = field_bit(pos)) >= 0)
+            bigint_flip_bit(checksum, bit);
+    }
+}
+
+/* Input array A[0..n] and work array B[0..n] */
+static void merge_sort_recurse(bitsize_t *A, size_t n, bitsize_t *B)
+{
+    const size_t m = n / 2;
+    if (m > 0) {
+        size_t i, j, k;
+        merge_sort_recurse(B, m, A);
         merge_sort_recurse(A+m, n-m, B+m);
         for (i = j = 0, k = m; i < k; i++) {
             if (k == n || (j < m && B[j] <= A[k])) {
@@ -800,7 +2089,55 @@ static int merge_sort(bitsize_t *A, size_t n)
     return !!B;
 }
 
-static int write_adjusted(FILE *in, bitsize_t flips[], size_t n, FILE *out)
+/* Remove duplicates from input.bits[] keeping the first occurrences */
+static int remove_duplicate_bits(void)
+{
+    size_t i, j, m;
+    bitsize_t *sorted;
+    unsigned char *seen;
+    if (!(sorted = malloc(input.nbits * sizeof(bitsize_t) + 1)))
+        return 0;
+    memcpy(sorted, input.bits, input.nbits * sizeof(bitsize_t));
+    if (!merge_sort(sorted, input.nbits)) {
+        free(sorted);
+        return 0;
+    }
+    for (i = m = 0; i < input.nbits; i++) {
+        if (!m || sorted[m-1] != sorted[i])
+            sorted[m++] = sorted[i];
+    }
+    if (!(seen = calloc(m + 1, sizeof(unsigned char)))) {
+        free(sorted);
+        return 0;
+    }
+
+    for (i = j = 0; i < input.nbits; i++) {
+        size_t lo = 0, hi = m;
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (sorted[mid] <= input.bits[i]) lo = mid; else hi = mid;
+        }
+        if (!seen[lo]) {
+            seen[lo] = 1;
+            input.bits[j++] = input.bits[i];
+        }
+    }
+    input.nbits = j;
+
+    free(seen);
+    free(sorted);
+    return 1;
+}
+
+/*
+ * Write the input message with bits flipped to out.
+ *
+ * With a non-NULL `checksum`, the bytes of the checksummed window are hashed
+ * into it as they are written. The window then goes through the buffer, as the
+ * spans copied in the kernel would never be seen by crchack.
+ */
+static int write_adjusted(FILE *in, bitsize_t flips[], size_t n, FILE *out,
+                          struct bigint *checksum)
 {
     size_t m, size;
     if (!merge_sort(flips, n)) {
@@ -808,15 +2145,36 @@ static int write_adjusted(FILE *in, bitsize_t flips[], size_t n, FILE *out)
         return 0;
     }
 
+    /* Bytes before the --range window */
+    if (fileio_copy(in, out, input.offset) != input.offset) {
+        fputs("error copying input message\n", stderr);
+        return 0;
+    }
+
     m = size = 0;
     while (size < input.len) {
         size_t i, j;
         char buf[BUFSIZ];
+
+        /* Unmodified spans of the message bypass the buffer */
+        j = (m < n && flips[m] / 8 < input.len - input.pad)
+          ? flips[m] / 8 : input.len - input.pad;
+        if (!checksum && j > size && j - size >= FILEIO_COPY_MIN) {
+            size_t span = j - size;
+            if (fileio_copy(in, out, span) != span) {
+                fputs("error copying input message\n", stderr);
+                return 0;
+            }
+            size += span;
+            continue;
+        }
+
         if (size >= input.len - input.pad) {
             j = (input.len - size) < BUFSIZ ? (input.len - size) : BUFSIZ;
             memset(&buf, 0, j);
         } else if (!feof(in)) {
-            j = fread(buf, sizeof(char), BUFSIZ, in);
+            j = input.len - input.pad - size;
+            j = fread(buf, sizeof(char), j < BUFSIZ ? j : BUFSIZ, in);
             if (ferror(in)) {
                 fputs("error reading input message\n", stderr);
                 break;
@@ -841,54 +2199,1770 @@ static int write_adjusted(FILE *in, bitsize_t flips[], size_t n, FILE *out)
             }
             i += ret;
         }
+        if (checksum)
+            crc_append(&input.crc, buf, j, checksum);
         size += i;
     }
 
+    /* Bytes after the --range window */
+    if (input.has_range && size == input.len) {
+        fileio_copy(in, out, ~(uintmax_t)0);
+        if (ferror(in) || ferror(out)) {
+            fputs("error copying input message\n", stderr);
+            return 0;
+        }
+    }
+
     return size == input.len;
 }
 
-int main(int argc, char *argv[])
+/*
+ * Write a forged message and, with --verify, check that the written bytes have
+ * the target checksum. Returns an exit code (0 for success).
+ */
+static int write_verified(FILE *in, bitsize_t flips[], size_t n, FILE *out)
 {
-    int exit_code;
-    bitoffset_t ret;
+    bitsize_t i;
+    int exit_code = 0;
+    struct bigint checksum, target;
+
+    if (!input.verify)
+        return write_adjusted(in, flips, n, out, NULL) ? 0 : 7;
+    if (!bigint_init(&checksum, input.crc.width)) {
+        fputs("out-of-memory allocating verification checksum\n", stderr);
+        return 4;
+    }
+    if (!bigint_init(&target, input.crc.width)) {
+        fputs("out-of-memory allocating verification checksum\n", stderr);
+        bigint_destroy(&checksum);
+        return 4;
+    }
+    bigint_mov(&target, &input.target);
+    bigint_load_zeros(&checksum);
+    crc(&input.crc, NULL, 0, &checksum);
+    if (!write_adjusted(in, flips, n, out, &checksum)) {
+        exit_code = 7;
+    } else if (fflush(out) != 0 || ferror(out)) {
+        fputs("error writing adjusted message\n", stderr);
+        exit_code = 7;
+    } else {
+        /* With --target-at, the checksum is compared to the output field */
+        if (input.target_at_arg)
+            field_value(flips, n, &target);
+        for (i = 0; i < input.crc.width; i++) {
+            if (bigint_get_bit(&checksum, i) != bigint_get_bit(&target, i))
+                break;
+        }
+        if (i < input.crc.width) {
+            fputs("verification FAILED! output checksum is ", stderr);
+            bigint_fprint(stderr, &checksum);
+            fputs("\n", stderr);
+            exit_code = 8;
+        } else if (input.verbose >= 1) {
+            fputs("verified output checksum\n", stderr);
+        }
+    }
+    bigint_destroy(&target);
+    bigint_destroy(&checksum);
+    return exit_code;
+}
 
-    /* Parse command-line interface arguments */
-    if ((exit_code = handle_args(argc, argv)))
-        goto finish;
+/*
+ * Check with the --oracle command that the message with flips[0..n-1] has the
+ * target checksum. On a mismatch, the cached columns are dropped, since they
+ * may be stale (e.g., the command has changed since they were learned).
+ * Returns an exit code (0 for success).
+ */
+static int check_oracle(const bitsize_t flips[], size_t n,
+                        const struct bigint *target)
+{
+    int exit_code = 0;
+    const char *error;
+    struct bigint checksum;
 
-    /* Print CRC to stdout and exit if no target checksum given */
-    if (!input.has_target) {
-        bigint_print(&input.checksum);
-        puts("");
-        exit_code = 0;
-        goto finish;
+    if (!bigint_init(&checksum, input.crc.width)) {
+        fputs("out-of-memory allocating verification checksum\n", stderr);
+        return 4;
+    }
+    if ((error = oracle_flipped(&input.oracle, flips, n, &checksum))) {
+        fprintf(stderr, "--oracle: %s\n", error);
+        exit_code = 2;
+    } else {
+        bigint_xor(&checksum, target);
+        if (!bigint_is_zero(&checksum)) {
+            bigint_xor(&checksum, target);
+            oracle_cache_drop(oracle_cache(), &input.oracle, input.len);
+            fputs("--oracle: verification FAILED! output checksum is ",
+                  stderr);
+            bigint_fprint(stderr, &checksum);
+            fputs(" (cached columns dropped, try again)\n", stderr);
+            exit_code = 8;
+        }
     }
+    bigint_destroy(&checksum);
+    return exit_code;
+}
 
-    /* Forge */
-    ret = forge(&input.target, input_crc, input.bits, input.nbits);
+/* Bit flips of solution x with the toggled free bits (returns their count) */
+static size_t variant_flips(const struct forge_space *space,
+                            const struct bigint *x,
+                            const unsigned char toggled[], size_t free_bits,
+                            bitsize_t flips[])
+{
+    size_t i, m = 0;
+    for (i = 0; i < space->rank; i++) {
+        if (bigint_get_bit(x, i))
+            flips[m++] = input.bits[i];
+    }
+    for (i = 0; i < free_bits; i++) {
+        if (toggled[i])
+            flips[m++] = input.bits[space->rank + i];
+    }
+    return m;
+}
+
+/*
+ * Write input.variants distinct forged messages.
+ *
+ * Walks the null space of the forging system in Gray code order so that each
+ * variant differs from the previous one by a single null space basis vector.
+ * Writes one file per variant with --output, otherwise prints patch lists
+ * (flipped bits in byte.bit notation) to stdout one variant per line.
+ *
+ * Returns an exit code (0 for success).
+ */
+static int write_variants(void)
+{
+    int exit_code;
+    size_t i, m, t, free_bits;
+    bitsize_t k, n, *flips;
+    struct bigint x;
+    unsigned char toggled[8 * sizeof(bitsize_t)];
+    struct forge_space space;
+    bitoffset_t ret;
 
+    ret = forge_affine(&input.target, input_crc, input.bits, input.nbits,
+                       &space);
     if (ret < 0) {
         fprintf(stderr, "FAIL! try giving %jd mutable bits more (got %zu)\n",
                 -ret, input.nbits);
-        exit_code = 6;
-        goto finish;
+        return 6;
     }
 
-    /* Show flipped bits */
+    n = input.variants;
+    if (space.dim < 8 * sizeof(bitsize_t) && n > (bitsize_t)1 << space.dim) {
+        n = (bitsize_t)1 << space.dim;
+        fprintf(stderr, "only %ju variants exist (null space dimension %zu)\n",
+                n, space.dim);
+    }
     if (input.verbose >= 1) {
-        bitoffset_t i;
-        fprintf(stderr, "flip[%jd] = {", ret);
-        for (i = 0; i < ret; i++) {
-            const char *fmt = &", %ju.%ju"[!i];
-            fprintf(stderr, fmt, input.bits[i]/8, input.bits[i]%8);
+        fprintf(stderr, "rank %zu, null space dimension %zu\n",
+                space.rank, space.dim);
+    }
+
+    /* Variant k toggles free bits of the Gray code k ^ (k >> 1) */
+    for (free_bits = 0; free_bits < space.dim && free_bits < 8 * sizeof(n)
+                        && (n-1) >> free_bits; free_bits++);
+    memset(toggled, 0, sizeof(toggled));
+    flips = malloc((space.rank + free_bits + 1) * sizeof(bitsize_t));
+    if (!flips || !bigint_init(&x, input.crc.width)) {
+        fputs("out-of-memory allocating variant work space\n", stderr);
+        forge_space_destroy(&space);
+        free(flips);
+        return 4;
+    }
+    bigint_mov(&x, &space.x);
+
+    /* With an oracle, check the solution and each basis vector used */
+    exit_code = 0;
+    for (t = 0; t <= free_bits && input.oracle_cmd && !exit_code; t++) {
+        if (t) {
+            bigint_xor(&x, &space.kernel[t-1]);
+            toggled[t-1] = 1;
+        }
+        m = variant_flips(&space, &x, toggled, free_bits, flips);
+        exit_code = check_oracle(flips, m, &input.target);
+        if (t) {
+            bigint_xor(&x, &space.kernel[t-1]);
+            toggled[t-1] = 0;
         }
-        fprintf(stderr, " }\n");
     }
 
-    if (!write_adjusted(input.in, input.bits, ret, input.out)) {
-        exit_code = 7;
+    for (k = 0; k < n && !exit_code; k++) {
+        if (k) {
+            for (t = 0; !((k >> t) & 1); t++);
+            bigint_xor(&x, &space.kernel[t]);
+            toggled[t] ^= 1;
+        }
+        m = variant_flips(&space, &x, toggled, free_bits, flips);
+
+        if (input.output) {
+            FILE *out;
+            if (fsetpos(input.in, &input.start) != 0) {
+                fputs("fsetpos() error for input message\n", stderr);
+                exit_code = 7;
+            } else if (!(out = open_output(k))) {
+                exit_code = 7;
+            } else {
+                exit_code = write_verified(input.in, flips, m, out);
+                if (fclose(out) && !exit_code) {
+                    fputs("error closing adjusted message\n", stderr);
+                    exit_code = 7;
+                }
+            }
+        } else if (merge_sort(flips, m)) {
+            for (i = 0; i < m; i++)
+                printf(&" %ju.%ju"[!i], flips[i]/8, flips[i]%8);
+            printf("\n");
+        } else {
+            fputs("out of memory for merge sort work space\n", stderr);
+            exit_code = 4;
+        }
+    }
+
+    bigint_destroy(&x);
+    forge_space_destroy(&space);
+    free(flips);
+    return exit_code;
+}
+
+/* Flip bits[0..n-1] of the message in buf (which starts at message bit first) */
+static void toggle_bits(char *buf, const bitsize_t bits[], size_t n,
+                        bitsize_t first)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+        buf[(bits[i] - first) / 8] ^= 1 << (bits[i] % 8);
+}
+
+/*
+ * Write the input message with the bit flips flips[t][0..nflips[t]-1] to each
+ * output outs[t] (t < n). The input is read only once: each chunk is written
+ * to all outputs, with the flips of an output applied for its write and then
+ * undone. With non-NULL `checksums`, the checksummed window of each output is
+ * hashed into checksums[t].
+ */
+static int write_fanout(FILE *in, bitsize_t *flips[], const size_t nflips[],
+                        FILE *outs[], size_t n, struct bigint *checksums)
+{
+    int ok = 0;
+    size_t t, j, *m;
+    uintmax_t done = 0;
+    const uintmax_t start = input.offset, data = start + input.len - input.pad,
+                    end = start + input.len;
+    static char buf[1 << 16];
+
+    if (!(m = calloc(n, sizeof(size_t)))) {
+        fputs("out-of-memory allocating output cursors\n", stderr);
+        return 0;
+    }
+    for (t = 0; t < n; t++) {
+        if (!merge_sort(flips[t], nflips[t])) {
+            fputs("out of memory for merge sort work space\n", stderr);
+            goto finish;
+        }
+    }
+
+    for (;;) {
+        /* Chunks never straddle the window or its padding */
+        uintmax_t limit = (done < start) ? start - done
+                        : (done < data) ? data - done
+                        : (done < end) ? end - done : sizeof(buf);
+        j = limit < sizeof(buf) ? (size_t)limit : sizeof(buf);
+        if (done >= data && done < end) {
+            memset(buf, 0, j);
+        } else if (done < end || input.has_range) {
+            j = fread(buf, sizeof(char), j, in);
+            if (ferror(in)) {
+                fputs("error reading input message\n", stderr);
+                goto finish;
+            }
+            if (!j && done < end) {
+                fprintf(stderr, "adjusted message has wrong length: %ju != "
+                        "%zu\n", done - start, input.len);
+                goto finish;
+            }
+        } else {
+            j = 0;
+        }
+        if (!j)
+            break;
+
+        for (t = 0; t < n; t++) {
+            size_t i, k = m[t];
+            const bitsize_t first = 8 * (done - start);
+            while (done >= start && k < nflips[t]
+                    && flips[t][k] < first + 8 * (bitsize_t)j)
+                k++;
+            toggle_bits(buf, &flips[t][m[t]], k - m[t], first);
+            for (i = 0; i < j; ) {
+                size_t ret = fwrite(buf + i, sizeof(char), j - i, outs[t]);
+                if (!ret || ferror(outs[t])) {
+                    fputs("error writing adjusted message\n", stderr);
+                    goto finish;
+                }
+                i += ret;
+            }
+            if (checksums && done >= start && done < end)
+                crc_append(&input.crc, buf, j, &checksums[t]);
+            toggle_bits(buf, &flips[t][m[t]], k - m[t], first);
+            m[t] = k;
+        }
+        done += j;
+    }
+    ok = 1;
+
+finish:
+    free(m);
+    return ok;
+}
+
+/*
+ * Forge the message to each of input.ntargets target checksums (output t is
+ * named by the --output template with t).
+ *
+ * The mutable bits are eliminated once by an incremental solver, so that each
+ * target costs only a back-substitution, and the outputs are written in one
+ * pass over the input by write_fanout(). Returns an exit code (0 for success).
+ */
+static int write_targets(void)
+{
+    int exit_code = 4;
+    size_t i, t, opened = 0, *nflips;
+    bitsize_t **flips;
+    bitoffset_t ret;
+    FILE **outs;
+    struct forge_solver *solver;
+    struct bigint *checksums = NULL;
+    const bitsize_t width = input.crc.width;
+
+    flips = calloc(input.ntargets, sizeof(bitsize_t *));
+    nflips = calloc(input.ntargets, sizeof(size_t));
+    outs = calloc(input.ntargets, sizeof(FILE *));
+    if (!flips || !nflips || !outs
+            || !(solver = forge_solver_new(width, input_crc))) {
+        fputs("out-of-memory allocating forge solver\n", stderr);
+        free(flips);
+        free(nflips);
+        free(outs);
+        return 4;
+    }
+    for (i = 0; i < input.nbits && forge_solver_rank(solver) < width; i++) {
+        if (forge_solver_add_bit(solver, input.bits[i]) < 0) {
+            fputs("out-of-memory allocating forge solver\n", stderr);
+            goto finish;
+        }
+    }
+    if (input.verbose >= 1) {
+        fprintf(stderr, "evaluated %zu of %zu mutable bits (rank %zu)\n",
+                i, input.nbits, forge_solver_rank(solver));
+    }
+
+    /* Back-substitute each target */
+    for (t = 0; t < input.ntargets; t++) {
+        if (!(flips[t] = malloc((width + 1) * sizeof(bitsize_t)))) {
+            fputs("out-of-memory allocating bit flips\n", stderr);
+            goto finish;
+        }
+        ret = forge_solver_try_solve(solver, &input.targets[t], flips[t]);
+        if (ret < 0) {
+            fprintf(stderr, "FAIL! target %s needs %jd mutable bits more "
+                    "(got %zu)\n", input.target_args[t], -ret, input.nbits);
+            exit_code = 6;
+            goto finish;
+        }
+        nflips[t] = (size_t)ret;
+        if (input.verbose >= 1) {
+            fprintf(stderr, "target %s: %zu bit flips\n",
+                    input.target_args[t], nflips[t]);
+        }
+    }
+
+    for (t = 0; t < input.ntargets && input.oracle_cmd; t++) {
+        if ((exit_code = check_oracle(flips[t], nflips[t], &input.targets[t])))
+            goto finish;
+    }
+
+    /* Fan out the input to the outputs */
+    exit_code = 7;
+    for (opened = 0; opened < input.ntargets; opened++) {
+        if (!(outs[opened] = open_output(opened)))
+            goto finish;
+    }
+    if (input.verify) {
+        if (!(checksums = bigint_array_new(input.ntargets, width))) {
+            fputs("out-of-memory allocating verification checksum\n", stderr);
+            exit_code = 4;
+            goto finish;
+        }
+        for (t = 0; t < input.ntargets; t++)
+            crc(&input.crc, NULL, 0, &checksums[t]);
+    }
+    if (fsetpos(input.in, &input.start) != 0) {
+        fputs("fsetpos() error for input message\n", stderr);
         goto finish;
     }
+    if (!write_fanout(input.in, flips, nflips, outs, input.ntargets,
+                      checksums))
+        goto finish;
+
+    exit_code = 0;
+    for (t = 0; t < input.ntargets && checksums; t++) {
+        for (i = 0; i < width; i++) {
+            if (bigint_get_bit(&checksums[t], i)
+                    != bigint_get_bit(&input.targets[t], i))
+                break;
+        }
+        if (i < width) {
+            fprintf(stderr, "verification FAILED! output %zu checksum is ", t);
+            bigint_fprint(stderr, &checksums[t]);
+            fputs("\n", stderr);
+            exit_code = 8;
+        }
+    }
+    if (checksums && !exit_code && input.verbose >= 1)
+        fputs("verified output checksums\n", stderr);
+
+finish:
+    while (opened-- > 0) {
+        if (fclose(outs[opened]) && !exit_code) {
+            fputs("error closing adjusted message\n", stderr);
+            exit_code = 7;
+        }
+    }
+    for (t = 0; t < input.ntargets; t++)
+        free(flips[t]);
+    bigint_array_delete(checksums);
+    forge_solver_delete(solver);
+    free(outs);
+    free(nflips);
+    free(flips);
+    return exit_code;
+}
+
+/*
+ * Set up forging of len-byte records: select the mutable bits and add them to
+ * a new solver. Returns an exit code (0 for success).
+ */
+static int record_solver(size_t len, struct forge_solver **solver)
+{
+    int exit_code;
+    size_t i;
+    const bitsize_t width = input.crc.width;
+
+    forge_solver_delete(*solver);
+    crc_sparse_delete(input.sparse);
+    free(input.bits);
+    *solver = NULL;
+    input.sparse = NULL;
+    input.bits = NULL;
+    input.nbits = 0;
+    input.len = len;
+    input.bitlen = 8 * (bitsize_t)len;
+
+    if ((exit_code = select_bits(input.has_offset, input.bit_offset)))
+        return exit_code;
+    for (i = 0; i < input.nbits; i++) {
+        if (input.bits[i] >= input.bitlen) {
+            fprintf(stderr, "bits[%zu]=%ju exceeds record length (%ju bits)\n",
+                    i, input.bits[i], input.bitlen);
+            return 3;
+        }
+    }
+    if (!(input.sparse = new_sparse())) {
+        fputs("error initializing sparse CRC engine (bad params?)\n", stderr);
+        return 5;
+    }
+    print_sparse(input.sparse);
+    if (!(*solver = forge_solver_new(width, input_crc))) {
+        fputs("out-of-memory allocating forge solver\n", stderr);
+        return 4;
+    }
+    for (i = 0; i < input.nbits && forge_solver_rank(*solver) < width; i++) {
+        if (forge_solver_add_bit(*solver, input.bits[i]) < 0) {
+            fputs("out-of-memory allocating forge solver\n", stderr);
+            return 4;
+        }
+    }
+    if (input.verbose >= 1) {
+        fprintf(stderr, "%zu-byte records: %zu mutable bits (rank %zu)\n",
+                len, input.nbits, forge_solver_rank(*solver));
+    }
+    return 0;
+}
+
+/* Fail unless the target is reachable in every len-byte record */
+static int check_record_rank(const struct forge_solver *solver, size_t len)
+{
+    const size_t rank = forge_solver_rank(solver);
+    if (rank < input.crc.width) {
+        fprintf(stderr, "%zu-byte records: FAIL! try giving %ju mutable bits "
+                "more (got %zu)\n", len, (uintmax_t)(input.crc.width - rank),
+                input.nbits);
+        return 6;
+    }
+    return 0;
+}
+
+/* Report a failure of crc_forge_records() at record k (returns an exit code) */
+static int record_error(int status, uintmax_t k)
+{
+    if (status == CRC_RECORDS_OOM) {
+        fputs("out-of-memory forging records\n", stderr);
+        return 4;
+    }
+    if (status == CRC_RECORDS_MISMATCH) {
+        fprintf(stderr, "record %ju: verification FAILED!\n", k);
+        return 8;
+    }
+    fprintf(stderr, "record %ju: FAIL!\n", k);
+    return 6;
+}
+
+/*
+ * Forge every input.record_size byte record of the input (--record-size).
+ *
+ * The checksum differences of the bit flips depend only on the length of a
+ * record, so the system is solved once per record length (the last record may
+ * be shorter) and each record costs a checksum and a back-substitution. The
+ * records of a batch of about RECORDS_BATCH bytes are forged in parallel
+ * threads by crc_forge_records(), and the batches are streamed to the output
+ * in order.
+ *
+ * Every record length is checked before anything is written. The length of
+ * the last record of a stream of unknown size is known only at its end, so
+ * if it cannot be forged, it is written unmodified (and the exit code tells).
+ *
+ * Returns an exit code (0 for success).
+ */
+#define RECORDS_BATCH ((size_t)1 << 20)
+
+static int forge_records(void)
+{
+    int status, exit_code = 0, deferred = 0;
+    size_t n, full, len, batch, failed, last_len = 0;
+    uintmax_t k = 0, size;
+    intmax_t mtime;
+    long pos;
+    uint8_t *buf;
+    unsigned threads = search_threads();
+    struct forge_solver *solver = NULL, *last = NULL;
+
+    batch = input.record_size;
+    if (batch < RECORDS_BATCH)
+        batch *= RECORDS_BATCH / batch;
+    if (!(buf = malloc(batch))) {
+        fputs("out-of-memory allocating record buffer\n", stderr);
+        return 4;
+    }
+
+    /* Zero base checksum of the solvers (each record has its own checksum) */
+    if (!bigint_init(&input.checksum, input.crc.width)) {
+        exit_code = 4;
+        goto finish;
+    }
+    bigint_load_zeros(&input.checksum);
+
+    if ((exit_code = record_solver(input.record_size, &solver))
+            || (exit_code = check_record_rank(solver, input.record_size)))
+        goto finish;
+    if (fileio_stat(input.in, &size, &mtime) && (pos = ftell(input.in)) >= 0
+            && (uintmax_t)pos <= size
+            && (last_len = (size - (uintmax_t)pos) % input.record_size)) {
+        if ((exit_code = record_solver(last_len, &last))
+                || (exit_code = check_record_rank(last, last_len)))
+            goto finish;
+    }
+
+    if (input.output) {
+        fclose(input.out);
+        if (!(input.out = open_output(0))) {
+            exit_code = 7;
+            goto finish;
+        }
+    }
+
+    while ((n = fread(buf, sizeof(char), batch, input.in)) > 0) {
+        full = n / input.record_size;
+        status = crc_forge_records(&input.crc, solver, &input.target, buf,
+                                   full, input.record_size, input.verify,
+                                   threads, &failed);
+        if (status) {
+            exit_code = record_error(status, k + failed);
+            goto finish;
+        }
+        k += full;
+
+        /* The short last record (written unmodified if it cannot be forged) */
+        if ((len = n - full * input.record_size)) {
+            if (len != last_len || !last) {
+                last_len = len;
+                if ((exit_code = record_solver(len, &last)) == 4)
+                    goto finish;
+            }
+            status = exit_code ? CRC_RECORDS_UNREACHABLE
+                   : crc_forge_records(&input.crc, last, &input.target,
+                                       buf + (n - len), 1, len, input.verify,
+                                       1, &failed);
+            if (status == CRC_RECORDS_UNREACHABLE) {
+                fprintf(stderr, "record %ju: FAIL! written unmodified\n", k);
+                deferred = exit_code ? exit_code : 6;
+            } else if (status) {
+                exit_code = record_error(status, k);
+                goto finish;
+            }
+            exit_code = 0;
+            k++;
+        }
+
+        if (fwrite(buf, sizeof(char), n, input.out) != n) {
+            fputs("error writing adjusted message\n", stderr);
+            exit_code = 7;
+            goto finish;
+        }
+    }
+    if (ferror(input.in)) {
+        fputs("error reading input message\n", stderr);
+        exit_code = 2;
+    } else if (fflush(input.out) != 0) {
+        fputs("error writing adjusted message\n", stderr);
+        exit_code = 7;
+    } else {
+        exit_code = deferred;
+        if (input.verbose >= 1)
+            fprintf(stderr, "forged %ju records\n", k);
+    }
+
+finish:
+    forge_solver_delete(last);
+    forge_solver_delete(solver);
+    free(buf);
+    return exit_code;
+}
+
+/* Name of a container region for messages (gzip members may have none) */
+static int region_name(const struct container_region *region, const char **name)
+{
+    *name = region->name ? (const char *)region->name : "-";
+    return region->name ? (int)region->namelen : 1;
+}
+
+/* File offset of byte i of the bytes covered by a container region */
+static uintmax_t region_offset(const struct container *container,
+                               const struct container_region *region,
+                               uintmax_t i)
+{
+    size_t k = region->span;
+    for (; i >= container->spans[k].len; k++)
+        i -= container->spans[k].len;
+    return container->spans[k].offset + i;
+}
+
+/* Write a stored CRC-32 of a container (returns zero on error) */
+static int write_stored_crc(FILE *out, uintmax_t offset, uint32_t crc,
+                            int big_endian)
+{
+    int i;
+    uint8_t bytes[4];
+    for (i = 0; i < 4; i++)
+        bytes[i] = (uint8_t)(crc >> (big_endian ? 24 - 8*i : 8*i));
+    return fileio_seek(out, offset) == 0 && fwrite(bytes, 1, 4, out) == 4;
+}
+
+/*
+ * Flip the mutable bits of a container region so that its covered bytes match
+ * the stored CRC. Only the modified bytes are written. Returns an exit code.
+ */
+static int forge_region(const struct fileio_view *view,
+                        const struct container *container,
+                        const struct container_region *region,
+                        struct forge_solver **solver, FILE *out)
+{
+    int exit_code = 0;
+    size_t i, j, n = 0;
+    bitoffset_t ret;
+    bitsize_t flips[32];
+    uintmax_t offsets[32];
+    uint8_t masks[32];
+    struct bigint *vec;     /* checksum, target and work vectors */
+    const char *name;
+    const int namelen = region_name(region, &name);
+
+    if (!region->nspans && region->len) {
+        fprintf(stderr, "%.*s: covered bytes are compressed; they can only be "
+                "re-stamped (without -oOb)\n", namelen, name);
+        return 6;
+    }
+    if (region->len != input.len || !*solver) {
+        if ((exit_code = record_solver((size_t)region->len, solver)))
+            return exit_code;
+    }
+    if (!(vec = bigint_array_new(4, input.crc.width)))
+        return 4;
+    bigint_load_u64(&vec[0], region->actual);
+    bigint_load_u64(&vec[1], region->stored);
+    if ((ret = forge_solver_solve(*solver, &vec[0], &vec[1], &vec[2],
+                                  flips)) < 0) {
+        fprintf(stderr, "%.*s: FAIL! try giving %jd mutable bits more (got "
+                "%zu)\n", namelen, name, -ret, input.nbits);
+        exit_code = 6;
+        goto finish;
+    }
+
+    /* Combine the flips of each byte */
+    for (i = 0; i < (size_t)ret; i++) {
+        const uintmax_t offset = region_offset(container, region, flips[i] / 8);
+        for (j = 0; j < n && offsets[j] != offset; j++);
+        if (j == n) {
+            offsets[n] = offset;
+            masks[n++] = 0;
+        }
+        masks[j] ^= 1 << (flips[i] % 8);
+    }
+    for (j = 0; j < n; j++) {
+        if (fileio_seek(out, offsets[j]) != 0
+                || fputc(view->data[offsets[j]] ^ masks[j], out) == EOF) {
+            fputs("error writing forged bytes\n", stderr);
+            exit_code = 7;
+            goto finish;
+        }
+    }
+
+finish:
+    bigint_array_delete(vec);
+    return exit_code;
+}
+
+/*
+ * Fix the CRC-32 fields of a PNG, gzip or ZIP file in place (--format).
+ *
+ * The file is parsed through a read-only view. Each CRC field that does not
+ * match its covered bytes is re-stamped, or, if mutable bits are given, the
+ * mutable bits of the covered bytes (relative to the first covered byte) are
+ * flipped to match the stored CRC. Only the modified bytes are rewritten. The
+ * regions are listed on stdout as "offset name crc status".
+ */
+static int fix_container(void)
+{
+    int exit_code = 0;
+    size_t i, j, fixed = 0;
+    const char *error;
+    const int forge = input.has_offset || input.nslices;
+    struct fileio_view view;
+    struct container container;
+    struct forge_solver *solver = NULL;
+    FILE *out = NULL;
+
+    /* Base checksum of the solvers (replaced by each region's checksum) */
+    if (!bigint_init(&input.checksum, input.crc.width))
+        return 4;
+    bigint_load_zeros(&input.checksum);
+
+    if (!fileio_view_open(&view, input.filename)) {
+        fprintf(stderr, "open '%s' for reading failed\n", input.filename);
+        return 2;
+    }
+    if ((error = container_parse(&container, input.format, view.data,
+                                 view.size, &input.crc))) {
+        fprintf(stderr, "%s: %s\n", input.filename, error);
+        exit_code = 2;
+        goto finish;
+    }
+
+    for (i = 0; i < container.nregions; i++) {
+        const struct container_region *region = &container.regions[i];
+        const char *status = "ok", *name;
+        const int namelen = region_name(region, &name);
+        uint32_t crc = region->stored;
+        if (region->actual != region->stored) {
+            if (!out && !(out = fopen(input.filename, "r+b"))) {
+                fprintf(stderr, "open '%s' for writing failed\n",
+                        input.filename);
+                exit_code = 7;
+                goto finish;
+            }
+            if (forge) {
+                if ((exit_code = forge_region(&view, &container, region,
+                                              &solver, out)))
+                    goto finish;
+                status = "forged";
+            } else {
+                for (j = 0; j < region->nfields; j++) {
+                    if (!write_stored_crc(out, region->field[j],
+                                          region->actual, region->big_endian)) {
+                        fputs("error writing stored CRC\n", stderr);
+                        exit_code = 7;
+                        goto finish;
+                    }
+                }
+                crc = region->actual;
+                status = "restamped";
+            }
+            fixed++;
+        }
+        printf("%ju\t%.*s\t%08lx\t%s\n", region->field[0], namelen, name,
+               (unsigned long)crc, status);
+    }
+    if (out) {
+        exit_code = fclose(out) ? 7 : 0;
+        out = NULL;
+        if (exit_code) {
+            fputs("error writing stored CRC\n", stderr);
+            goto finish;
+        }
+    }
+
+    /* Reload the written file (the view may be a copy of the old contents) */
+    if (input.verify && forge && fixed) {
+        container_destroy(&container);
+        fileio_view_close(&view);
+        if (!fileio_view_open(&view, input.filename)) {
+            fprintf(stderr, "open '%s' for reading failed\n", input.filename);
+            exit_code = 2;
+            goto finish;
+        }
+        if ((error = container_parse(&container, input.format, view.data,
+                                     view.size, &input.crc))) {
+            fprintf(stderr, "%s: %s\n", input.filename, error);
+            exit_code = 2;
+            goto finish;
+        }
+        for (i = 0; i < container.nregions; i++) {
+            const struct container_region *region = &container.regions[i];
+            const char *name;
+            const int namelen = region_name(region, &name);
+            if (region->actual != region->stored) {
+                fprintf(stderr, "%.*s: verification FAILED!\n", namelen, name);
+                exit_code = 8;
+                goto finish;
+            }
+        }
+    }
+    if (input.verbose >= 1)
+        fprintf(stderr, "fixed %zu of %zu CRCs\n", fixed, container.nregions);
+
+finish:
+    if (out && fclose(out) != 0 && !exit_code) {
+        fputs("error writing stored CRC\n", stderr);
+        exit_code = 7;
+    }
+    forge_solver_delete(solver);
+    container_destroy(&container);
+    fileio_view_close(&view);
+    return exit_code;
+}
+
+/*
+ * Checksum messages msgs[0..n-1] with crc_many() and print the checksums, one
+ * per line. Returns an exit code (0 for success).
+ */
+static int print_checksums(const void *msgs[], const size_t lens[], size_t n,
+                           struct bigint out[], char *text)
+{
+    size_t i, j;
+    const size_t digits = (input.crc.width + 3) / 4;
+
+    crc_many(&input.crc, msgs, lens, n, out);
+    for (i = 0; i < n; i++) {
+        char *p = text + i * (digits + 1);
+        for (j = 0; j < digits; j++) {
+            const bitsize_t b = 4 * (digits-1-j);
+            unsigned int nibble = (out[i].limb[b / LIMB_BITS] >> (b % LIMB_BITS));
+            if (b + 4 > input.crc.width)
+                nibble &= (1u << (input.crc.width - b)) - 1;
+            p[j] = "0123456789abcdef"[nibble & 0x0F];
+        }
+        p[digits] = '\n';
+    }
+    if (fwrite(text, digits + 1, n, stdout) != n) {
+        fputs("error writing checksums\n", stderr);
+        return 7;
+    }
+    return 0;
+}
+
+/*
+ * Print the checksum of every input.record_size byte record of the input, or
+ * of every line without its newline with --lines (one checksum per line).
+ *
+ * The records of a buffer are checksummed together by crc_many() in batches
+ * of CHECKSUM_BATCH records. Returns an exit code (0 for success).
+ */
+#define CHECKSUM_BATCH 4096
+
+static int checksum_records(void)
+{
+    int eof = 0, exit_code = 0;
+    size_t len, skip, pos, n = 0, count = 0, size = (size_t)1 << 20;
+    uintmax_t k = 0;
+    uint8_t *buf, *end;
+    const void **msgs;
+    size_t *lens;
+    char *text;
+    struct bigint *out;
+
+    buf = malloc(size);
+    msgs = malloc(CHECKSUM_BATCH * sizeof(const void *));
+    lens = malloc(CHECKSUM_BATCH * sizeof(size_t));
+    text = malloc(CHECKSUM_BATCH * ((input.crc.width + 3) / 4 + 1));
+    out = bigint_array_new(CHECKSUM_BATCH, input.crc.width);
+    if (!buf || !msgs || !lens || !text || !out) {
+        fputs("out-of-memory allocating record buffer\n", stderr);
+        exit_code = 4;
+        goto finish;
+    }
+
+    while (!eof) {
+        n += fread(buf + n, sizeof(char), size - n, input.in);
+        if (ferror(input.in)) {
+            fputs("error reading input message\n", stderr);
+            exit_code = 2;
+            goto finish;
+        }
+        eof = n < size;
+
+        /* Split the buffer into records (a partial one waits for more input) */
+        for (pos = 0; pos < n; pos += skip) {
+            if (input.lines) {
+                if (!(end = memchr(buf + pos, '\n', n - pos)) && !eof)
+                    break;
+                len = end ? (size_t)(end - (buf + pos)) : n - pos;
+                skip = len + !!end;
+            } else {
+                len = (n - pos < input.record_size) ? n - pos
+                                                    : input.record_size;
+                if (len < input.record_size && !eof)
+                    break;
+                skip = len;
+            }
+            msgs[count] = buf + pos;
+            lens[count++] = len;
+            if (count == CHECKSUM_BATCH) {
+                if ((exit_code = print_checksums(msgs, lens, count, out, text)))
+                    goto finish;
+                k += count;
+                count = 0;
+            }
+        }
+        if (count) {
+            if ((exit_code = print_checksums(msgs, lens, count, out, text)))
+                goto finish;
+            k += count;
+            count = 0;
+        }
+
+        /* Keep the partial record (and grow the buffer for long lines) */
+        memmove(buf, buf + pos, n - pos);
+        if ((n -= pos) == size) {
+            uint8_t *new = realloc(buf, 2 * size);
+            if (!new) {
+                fputs("out-of-memory allocating record buffer\n", stderr);
+                exit_code = 4;
+                goto finish;
+            }
+            buf = new;
+            size *= 2;
+        }
+    }
+    if (fflush(stdout) != 0) {
+        fputs("error writing checksums\n", stderr);
+        exit_code = 7;
+    } else if (input.verbose >= 1) {
+        fprintf(stderr, "checksummed %ju records\n", k);
+    }
+
+finish:
+    bigint_array_delete(out);
+    free(text);
+    free(lens);
+    free(msgs);
+    free(buf);
+    return exit_code;
+}
+
+/*
+ * Print a recovered CRC algorithm as crchack options (or a catalogue name).
+ */
+static int preset_matches(const struct crc_preset *preset,
+                          const struct crc_config *crc)
+{
+    int match = 0;
+    struct bigint poly, init, xor_out;
+    if (preset->width != crc->width
+            || preset->reflect_in != crc->reflect_in
+            || preset->reflect_out != crc->reflect_out)
+        return 0;
+    bigint_init(&poly, crc->width);
+    bigint_init(&init, crc->width);
+    bigint_init(&xor_out, crc->width);
+    if (bigint_from_string(&poly, preset->poly)
+            && bigint_from_string(&init, preset->init)
+            && bigint_from_string(&xor_out, preset->xor_out)) {
+        bigint_xor(&poly, &crc->poly);
+        bigint_xor(&init, &crc->init);
+        bigint_xor(&xor_out, &crc->xor_out);
+        match = bigint_is_zero(&poly) && bigint_is_zero(&init)
+             && bigint_is_zero(&xor_out);
+    }
+    bigint_destroy(&xor_out);
+    bigint_destroy(&init);
+    bigint_destroy(&poly);
+    return match;
+}
+
+static void print_recovered(const struct crc_config *crc, size_t ambiguity)
+{
+    const struct crc_preset *preset;
+    for (preset = crc_presets; preset->name; preset++) {
+        if (preset_matches(preset, crc))
+            break;
+    }
+    if (!preset->name || input.verbose >= 1) {
+        FILE *stream = preset->name ? stderr : stdout;
+        fprintf(stream, "-w%u -p", crc->width);
+        bigint_fprint(stream, &crc->poly);
+        fprintf(stream, " -i");
+        bigint_fprint(stream, &crc->init);
+        if (crc->reflect_in || crc->reflect_out) {
+            fprintf(stream, " -%s%s", crc->reflect_in ? "r" : "",
+                    crc->reflect_out ? "R" : "");
+        }
+        fprintf(stream, " -x");
+        bigint_fprint(stream, &crc->xor_out);
+        fprintf(stream, "\n");
+    }
+    if (preset->name)
+        printf("-a %s\n", preset->name);
+    if (ambiguity > input.ambiguity)
+        input.ambiguity = ambiguity;
+}
+
+/*
+ * Recover CRC parameters from the (file, checksum) samples of --recover.
+ *
+ * Returns an exit code (0 for success).
+ */
+static int recover_params(void)
+{
+    int ret, exit_code;
+    size_t i, n;
+    struct crc_sample *samples;
+
+    if (!(samples = calloc(input.nsamples, sizeof(struct crc_sample)))) {
+        fputs("out-of-memory allocating samples\n", stderr);
+        return 4;
+    }
+
+    exit_code = 0;
+    for (n = 0; n < input.nsamples; n++) {
+        const char *filename = input.samples[2*n];
+        samples[n].checksum = input.samples[2*n + 1];
+        if (!(samples[n].msg = fileio_load(filename, &samples[n].len))) {
+            fprintf(stderr, "reading sample '%s' failed\n", filename);
+            exit_code = 2;
+            goto finish;
+        }
+    }
+
+    ret = crc_recover(samples, n, &input.hint, search_threads(),
+                      print_recovered);
+    fflush(stdout);
+    if (ret > 0 && input.ambiguity) {
+        fprintf(stderr, "samples leave up to %zu bits of init and xor_out "
+                        "ambiguous\n", input.ambiguity);
+    }
+    if (ret < 0) {
+        fputs("FAIL! samples do not determine the polynomial "
+              "(give more samples of equal length or -p)\n", stderr);
+        exit_code = 6;
+    } else if (ret == 0) {
+        fputs("FAIL! no CRC algorithm matches the samples\n", stderr);
+        exit_code = 6;
+    }
+
+finish:
+    for (i = 0; i < n; i++)
+        free((void *)samples[i].msg);
+    free(samples);
+    return exit_code;
+}
+
+/*
+ * Read the original values of the sorted byte offsets[0..n) of the message.
+ */
+static int read_bytes(const bitsize_t offsets[], uint8_t values[], size_t n)
+{
+    size_t i, size;
+    static uint8_t buf[1 << 16];
+    if (fsetpos(input.in, &input.start) != 0
+            || fileio_seek(input.in, input.offset) != 0) {
+        fputs("fsetpos() error for input message\n", stderr);
+        return 0;
+    }
+    for (i = size = 0; i < n; ) {
+        size_t j;
+        if (offsets[i] >= input.len - input.pad) {
+            values[i++] = 0;
+            continue;
+        }
+        j = fread(buf, sizeof(uint8_t), sizeof(buf), input.in);
+        if (ferror(input.in) || !j) {
+            fputs("error reading input message\n", stderr);
+            return 0;
+        }
+        for (; i < n && offsets[i] < size + j; i++) {
+            if (offsets[i] >= input.len - input.pad)
+                break;
+            values[i] = buf[offsets[i] - size];
+        }
+        size += j;
+    }
+    if (fsetpos(input.in, &input.start) != 0) {
+        fputs("fsetpos() error for input message\n", stderr);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Solve w contiguous mutable bits (e.g., default -oO window) directly.
+ *
+ * Stores the bit flips in the beginning of input.bits[] and their number in
+ * `flips`. Returns zero if the mutable bits do not form such a window.
+ */
+static int forge_window(bitoffset_t *flips)
+{
+    size_t i;
+    bitsize_t first, pos;
+    struct bigint seen, delta;
+    const bitsize_t width = input.crc.width;
+    int ret = 0;
+
+    if (input.nbits != width || input.target_at_arg || input.oracle_cmd)
+        return 0;
+    first = ~(bitsize_t)0;
+    for (i = 0; i < input.nbits; i++) {
+        if ((pos = stream_bit(input.bits[i])) < first)
+            first = pos;
+    }
+    if (!bigint_init(&seen, width))
+        return 0;
+    if (!bigint_init(&delta, width)) {
+        bigint_destroy(&seen);
+        return 0;
+    }
+
+    /* Every position first..first+w-1 exactly once */
+    for (i = 0; i < input.nbits; i++) {
+        pos = stream_bit(input.bits[i]) - first;
+        if (pos >= width || bigint_get_bit(&seen, pos))
+            goto finish;
+        bigint_set_bit(&seen, pos);
+    }
+
+    bigint_mov(&delta, &input.target);
+    bigint_xor(&delta, &input.checksum);
+    if (!crc_window_solve(&input.crc, input.bitlen, first, &delta, &seen))
+        goto finish;
+    for (pos = 0, *flips = 0; pos < width; pos++) {
+        if (bigint_get_bit(&seen, pos))
+            input.bits[(*flips)++] = stream_bit(first + pos);
+    }
+    if (input.verbose >= 1)
+        fputs("solved contiguous window directly\n", stderr);
+    ret = 1;
+
+finish:
+    bigint_destroy(&delta);
+    bigint_destroy(&seen);
+    return ret;
+}
+
+/*
+ * Forge by adding mutable bits to an incremental solver until full rank.
+ *
+ * Bits beyond those needed for full rank are never evaluated. Stores the bit
+ * flips in the beginning of input.bits[] and returns their number like forge().
+ */
+static bitoffset_t forge_bits(void)
+{
+    size_t i;
+    bitoffset_t ret;
+    struct forge_solver *solver;
+    const bitsize_t width = input.crc.width;
+
+    if (forge_window(&ret))
+        return ret;
+    if (!(solver = forge_solver_new(width, input_crc)))
+        return -(bitoffset_t)(width + 1);
+    for (i = 0; i < input.nbits && forge_solver_rank(solver) < width; i++) {
+        if (forge_solver_add_bit(solver, input.bits[i]) < 0) {
+            forge_solver_delete(solver);
+            return -(bitoffset_t)(width + 2);
+        }
+    }
+    if (input.verbose >= 1) {
+        fprintf(stderr, "evaluated %zu of %zu mutable bits (rank %zu)\n",
+                i, input.nbits, forge_solver_rank(solver));
+    }
+
+    ret = forge_solver_try_solve(solver, &input.target, input.bits);
+    forge_solver_delete(solver);
+    return ret;
+}
+
+/*
+ * Forge by searching a solution whose mutated bytes stay in input.charset.
+ *
+ * Stores the bit flips in the beginning of input.bits[] and their number in
+ * `flips`. Returns an exit code (0 for success).
+ */
+static int forge_charset(bitoffset_t *flips)
+{
+    int exit_code;
+    unsigned threads;
+    size_t i, nbytes;
+    bitsize_t *offsets;
+    uint8_t *values;
+    struct forge_space space;
+    bitoffset_t ret;
+
+    ret = forge_affine(&input.target, input_crc, input.bits, input.nbits,
+                       &space);
+    if (ret < 0) {
+        fprintf(stderr, "FAIL! try giving %jd mutable bits more (got %zu)\n",
+                -ret, input.nbits);
+        return 6;
+    }
+    threads = search_threads();
+    if (input.verbose >= 1) {
+        fprintf(stderr, "rank %zu, null space dimension %zu, %u threads\n",
+                space.rank, space.dim, threads);
+    }
+
+    /* Sorted offsets and original values of the mutable bytes */
+    offsets = malloc((input.nbits + 1) * sizeof(bitsize_t));
+    values = malloc(input.nbits + 1);
+    if (!offsets || !values) {
+        fputs("out-of-memory allocating charset search\n", stderr);
+        exit_code = 4;
+        goto finish;
+    }
+    for (i = 0; i < input.nbits; i++)
+        offsets[i] = input.bits[i] / 8;
+    if (!merge_sort(offsets, input.nbits)) {
+        fputs("out of memory for merge sort work space\n", stderr);
+        exit_code = 4;
+        goto finish;
+    }
+    for (i = nbytes = 0; i < input.nbits; i++) {
+        if (!nbytes || offsets[nbytes-1] != offsets[i])
+            offsets[nbytes++] = offsets[i];
+    }
+    if (!read_bytes(offsets, values, nbytes)) {
+        exit_code = 7;
+        goto finish;
+    }
+
+    ret = search_charset(&space, input.bits, input.nbits, offsets, values,
+                         nbytes, input.charset, threads, 1, &input.budget,
+                         input.bits);
+    if (input.verbose >= 1 || ret == -1) {
+        double elapsed = input.budget.elapsed;
+        fprintf(stderr, "searched %ju candidates in %.2f s",
+                input.budget.candidates, elapsed);
+        if (elapsed > 0) {
+            fprintf(stderr, " (%.0f candidates/s)",
+                    input.budget.candidates / elapsed);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    exit_code = 0;
+    if (ret == -1) {
+        fputs("FAIL! search budget exhausted (try --budget or more bits)\n",
+              stderr);
+        exit_code = 6;
+    } else if (ret == -2) {
+        fputs("FAIL! no solution stays in the charset\n", stderr);
+        exit_code = 6;
+    } else if (ret < 0) {
+        fputs("out-of-memory allocating charset search\n", stderr);
+        exit_code = 4;
+    }
+    *flips = ret;
+
+finish:
+    forge_space_destroy(&space);
+    free(offsets);
+    free(values);
+    return exit_code;
+}
+
+/* Sort the unique mutable bits to columns.pos (with zero columns) */
+static int collect_columns(void)
+{
+    size_t i, n = 0;
+    columns.pos = malloc((input.nbits + 1) * sizeof(bitsize_t));
+    columns.col = bigint_array_new(input.nbits + 1, input.crc.width);
+    if (!columns.pos || !columns.col)
+        return 0;
+    memcpy(columns.pos, input.bits, input.nbits * sizeof(bitsize_t));
+    if (!merge_sort(columns.pos, input.nbits))
+        return 0;
+    for (i = 0; i < input.nbits; i++) {
+        if (!n || columns.pos[n-1] != columns.pos[i])
+            columns.pos[n++] = columns.pos[i];
+    }
+    columns.n = n;
+    return 1;
+}
+
+static void analyze_column(bitsize_t pos, struct bigint *out)
+{
+    const struct bigint *col = find_column(pos);
+    if (col)
+        bigint_mov(out, col);
+    else
+        bigint_load_zeros(out);
+}
+
+/* Rank of bits[0..n-1] without bits[skip..skip_end-1] (or -1 on error) */
+static bitoffset_t analyze_rank(const bitsize_t bits[], size_t n,
+                                size_t skip, size_t skip_end)
+{
+    size_t i;
+    bitoffset_t rank = -1;
+    struct forge_solver *solver;
+    if (!(solver = forge_solver_new(input.crc.width, analyze_column)))
+        return -1;
+    for (i = 0; i < n; i++) {
+        if (i == skip)
+            i = skip_end;
+        if (i == n || forge_solver_rank(solver) == input.crc.width)
+            break;
+        if (forge_solver_add_bit(solver, bits[i]) < 0)
+            goto finish;
+    }
+    rank = (bitoffset_t)forge_solver_rank(solver);
+finish:
+    forge_solver_delete(solver);
+    return rank;
+}
+
+/*
+ * Smallest span of message bits containing mutable bits of the given rank.
+ * For each first bit, bits are added until the rank is reached or the span
+ * is no smaller than the best one. Returns zero on error.
+ */
+static int analyze_window(size_t rank, size_t *first, size_t *last)
+{
+    size_t l, r, added;
+    int ok = 0;
+    bitsize_t span = 0;
+    struct forge_solver *solver;
+    if (!(solver = forge_solver_new(input.crc.width, analyze_column)))
+        return 0;
+    for (l = 0; l + rank <= columns.n && span != rank; l++) {
+        for (r = l, added = 0; r < columns.n; r++, added++) {
+            if (forge_solver_rank(solver) == rank)
+                break;
+            if (span && columns.pos[r] - columns.pos[l] >= span)
+                break;
+            if (forge_solver_add_bit(solver, columns.pos[r]) < 0)
+                goto finish;
+        }
+        if (forge_solver_rank(solver) == rank
+                && (!span || columns.pos[r-1] - columns.pos[l] + 1 < span)) {
+            span = columns.pos[r-1] - columns.pos[l] + 1;
+            *first = l;
+            *last = r-1;
+        }
+        while (added--)
+            forge_solver_remove_last(solver);
+    }
+    ok = 1;
+finish:
+    forge_solver_delete(solver);
+    return ok;
+}
+
+/*
+ * Report the rank of the mutable bits, the redundant -b slices and the
+ * smallest window of full rank. The difference columns of the bits do not
+ * depend on the message contents, so the message is never read. Returns an
+ * exit code (6 if a target checksum may not be reachable).
+ */
+static int analyze_bits(void)
+{
+    int exit_code = 4;
+    size_t i, k, n, group, first = 0, last = 0;
+    bitoffset_t rank, without;
+    const bitsize_t width = input.crc.width, limit = slice_limit();
+
+    /* Columns of the sorted unique bits */
+    if (!collect_columns())
+        goto finish;
+    for (i = 0, n = columns.n; i < n; i++) {
+        if (columns.pos[i] < input.bitlen)
+            crc_sparse_1bit(input.sparse, stream_bit(columns.pos[i]),
+                            &columns.col[i]);
+    }
+
+    if ((rank = analyze_rank(input.bits, input.nbits, 0, 0)) < 0)
+        goto finish;
+    printf("bits\t%zu (%zu distinct)\n", input.nbits, n);
+    printf("rank\t%jd of %ju\n", rank, width);
+
+    /* Slices (and the -oO bits after them) whose removal keeps the rank */
+    for (k = i = 0; k <= input.nslices; k++, i += group) {
+        bitsize_t lo, hi;
+        size_t j;
+        if (k < input.nslices) {
+            group = bits_of_slice(&input.slices[k], input.bitlen, limit, NULL);
+        } else if (!(group = input.nbits - i)) {
+            break;
+        }
+        if (group > input.nbits - i)
+            break;
+        if (!group) {
+            printf("slice\t%zu\tempty\n", k + 1);
+            continue;
+        }
+        if ((without = analyze_rank(input.bits, input.nbits, i, i + group)) < 0)
+            goto finish;
+        for (lo = hi = input.bits[i], j = i; j < i + group; j++) {
+            if (input.bits[j] < lo) lo = input.bits[j];
+            if (input.bits[j] > hi) hi = input.bits[j];
+        }
+        if (k < input.nslices)
+            printf("slice\t%zu", k + 1);
+        else
+            printf("offset");
+        printf("\t%ju.%ju..%ju.%ju\t%zu bits\t%s\n", lo/8, lo%8, hi/8, hi%8,
+               group, without == rank ? "redundant" : "needed");
+    }
+
+    /* Smallest window of full rank */
+    if (rank > 0) {
+        if (!analyze_window((size_t)rank, &first, &last))
+            goto finish;
+        printf("window\t%ju.%ju..%ju.%ju\t%ju bits\n",
+               columns.pos[first]/8, columns.pos[first]%8,
+               columns.pos[last]/8, columns.pos[last]%8,
+               columns.pos[last] - columns.pos[first] + 1);
+    }
+
+    if ((bitsize_t)rank < width) {
+        printf("FAIL! need %ju more independent bits for any target\n",
+               width - (bitsize_t)rank);
+        exit_code = 6;
+    } else {
+        exit_code = 0;
+    }
+
+finish:
+    if (exit_code == 4)
+        fputs("out-of-memory analyzing mutable bits\n", stderr);
+    return exit_code;
+}
+
+/*
+ * Print the byte ranges of the input whose checksum is one of the targets as
+ * "start:end" (usable as a --range) followed by the checksum. The ranges start
+ * at a byte of the --scan range l:r or are windows of n bytes. Returns an exit
+ * code (0 for success, 6 if no range was found).
+ */
+static int scan_ranges(void)
+{
+    int exit_code = 0;
+    size_t i, first = 0, last, nmatches;
+    bitsize_t end;
+    bitoffset_t l, r;
+    const char *error;
+    struct fileio_view view;
+    struct crc_scan_match *matches;
+
+    if (!fileio_view_open(&view, input.filename)) {
+        fprintf(stderr, "open '%s' for reading failed\n", input.filename);
+        return 2;
+    }
+    last = view.size;
+    if (!input.scan_window) {
+        /* Clamp the starts to the input like --range */
+        end = 8 * (bitsize_t)view.size;
+        l = input.scan_starts.l;
+        r = input.scan_starts.r;
+        if (l < 0 && (l += end) < 0) l = 0;
+        else if ((bitsize_t)l > end) l = end;
+        if (input.scan_starts.relative) r += l;
+        if (r < 0 && (r += end) < 0) r = 0;
+        else if ((bitsize_t)r > end) r = end;
+        first = (size_t)(l / 8);
+        last = (r < l) ? first : (size_t)(r / 8);
+    }
+
+    if ((error = crc_scan(&input.crc, view.data, view.size, input.targets,
+                          input.ntargets, input.scan_window, first, last,
+                          search_threads(), &matches, &nmatches))) {
+        fprintf(stderr, "--scan: %s\n", error);
+        fileio_view_close(&view);
+        return 4;
+    }
+    for (i = 0; i < nmatches; i++) {
+        printf("%zu:%zu\t", matches[i].start, matches[i].end);
+        bigint_print(&input.targets[matches[i].target]);
+        printf("\n");
+    }
+    if (input.verbose >= 1) {
+        fprintf(stderr, "scanned %zu bytes for %zu checksums\n", view.size,
+                input.ntargets);
+    }
+    if (!nmatches) {
+        fputs("no range has the target checksum\n", stderr);
+        exit_code = 6;
+    }
+    free(matches);
+    fileio_view_close(&view);
+    return exit_code;
+}
+
+/*
+ * Learn the checksum of the message from the --oracle command and, if there
+ * is a target, the difference columns of the mutable bits. Columns probed
+ * before for a message of the same length are read from the cache, and the
+ * rest are probed in parallel. Returns an exit code (0 for success).
+ */
+static int learn_oracle(void)
+{
+    int exit_code = 4;
+    size_t i, k, cached;
+    bitsize_t *probe = NULL;
+    unsigned char *known = NULL;
+    struct bigint *learned = NULL;
+    const char *error, *cache = oracle_cache();
+
+    if ((error = oracle_open(&input.oracle, input.oracle_cmd, input.crc.width,
+                             input.in, input.len - input.pad, input.pad,
+                             input.has_target ? search_threads() : 1))
+            || (error = oracle_checksum(&input.oracle, &input.checksum))) {
+        fprintf(stderr, "--oracle: %s\n", error);
+        return 2;
+    }
+    if (fsetpos(input.in, &input.start) != 0) {
+        fprintf(stderr, "fsetpos() error for input file '%s'\n",
+                input.filename);
+        return 2;
+    }
+    if (input.verbose >= 1) {
+        fprintf(stderr, "H(msg) = ");
+        bigint_fprint(stderr, &input.checksum);
+        fprintf(stderr, "\noracle batch = %zu files\n", input.oracle.batch);
+    }
+    if (!input.has_target)
+        return 0;
+
+    /* Cached columns first, then probe the rest */
+    if (!collect_columns()
+            || !(known = calloc(columns.n + 1, sizeof(unsigned char)))
+            || !(probe = malloc((columns.n + 1) * sizeof(bitsize_t)))
+            || !(learned = bigint_array_new(columns.n + 1, input.crc.width)))
+        goto finish;
+    cached = oracle_cache_load(cache, &input.oracle, input.len, columns.pos,
+                               columns.n, columns.col, known);
+    for (i = k = 0; i < columns.n; i++) {
+        if (!known[i])
+            probe[k++] = columns.pos[i];
+    }
+    if ((error = oracle_columns(&input.oracle, probe, k, &input.checksum,
+                                learned))) {
+        fprintf(stderr, "--oracle: %s\n", error);
+        exit_code = 2;
+        goto finish;
+    }
+    for (i = k = 0; i < columns.n; i++) {
+        if (!known[i])
+            bigint_mov(&columns.col[i], &learned[k++]);
+    }
+    if (k)
+        oracle_cache_store(cache, &input.oracle, input.len, probe, k, learned);
+    if (input.verbose >= 1) {
+        fprintf(stderr, "oracle learned %zu columns (%zu cached) in %ju "
+                "invocations\n", columns.n, cached, input.oracle.invocations);
+    }
+    exit_code = 0;
+
+finish:
+    if (exit_code == 4)
+        fputs("out-of-memory learning oracle columns\n", stderr);
+    bigint_array_delete(learned);
+    free(probe);
+    free(known);
+    return exit_code;
+}
+
+/* Progress of the --min-flips search */
+static void report_min_flips(void *ctx, size_t weight, double elapsed)
+{
+    (void)ctx;
+    fprintf(stderr, "min-flips: %zu %s after %.2f s\n", weight,
+            input.min_flips == 2 ? "bytes" : "bits", elapsed);
+}
+
+/*
+ * Forge by searching a solution with few bit flips (or mutated bytes).
+ *
+ * Stores the bit flips in the beginning of input.bits[] and their number in
+ * `flips`. Returns an exit code (0 for success).
+ */
+static int forge_min_flips(bitoffset_t *flips)
+{
+    unsigned threads;
+    struct forge_space space;
+    bitoffset_t ret;
+
+    ret = forge_affine(&input.target, input_crc, input.bits, input.nbits,
+                       &space);
+    if (ret < 0) {
+        fprintf(stderr, "FAIL! try giving %jd mutable bits more (got %zu)\n",
+                -ret, input.nbits);
+        return 6;
+    }
+    threads = search_threads();
+    if (input.verbose >= 1) {
+        fprintf(stderr, "rank %zu, null space dimension %zu, %u threads\n",
+                space.rank, space.dim, threads);
+    }
+
+    ret = search_min_weight(&space, input.bits, input.nbits,
+                            input.min_flips == 2, threads, 1, &input.budget,
+                            report_min_flips, NULL, input.bits);
+    forge_space_destroy(&space);
+    if (ret < 0) {
+        fputs("out-of-memory allocating min-flips search\n", stderr);
+        return 4;
+    }
+    if (input.verbose >= 1) {
+        double elapsed = input.budget.elapsed;
+        fprintf(stderr, "searched %ju candidates in %.2f s",
+                input.budget.candidates, elapsed);
+        if (elapsed > 0) {
+            fprintf(stderr, " (%.0f candidates/s)",
+                    input.budget.candidates / elapsed);
+        }
+        fprintf(stderr, "\n");
+    }
+    *flips = ret;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int exit_code;
+    bitoffset_t ret;
+
+    /* Parse command-line interface arguments */
+    if ((exit_code = handle_args(argc, argv)))
+        goto finish;
+
+    /* Recover CRC parameters from samples */
+    if (input.recover) {
+        exit_code = recover_params();
+        goto finish;
+    }
+
+    /* Fix the CRCs of a container file */
+    if (input.format) {
+        exit_code = fix_container();
+        goto finish;
+    }
+
+    /* Find the ranges covered by the target checksums */
+    if (input.scan_arg) {
+        exit_code = scan_ranges();
+        goto finish;
+    }
+
+    /* Checksum each line or record */
+    if (input.lines || (input.record_size && !input.has_target)) {
+        exit_code = checksum_records();
+        goto finish;
+    }
+
+    /* Report the rank of the mutable bits */
+    if (input.analyze) {
+        exit_code = analyze_bits();
+        goto finish;
+    }
+
+    /* Print CRC to stdout and exit if no target checksum given */
+    if (!input.has_target) {
+        bigint_print(&input.checksum);
+        puts("");
+        exit_code = 0;
+        goto finish;
+    }
+
+    /* Forge each record of the input */
+    if (input.record_size) {
+        exit_code = forge_records();
+        goto finish;
+    }
+
+    /* Forge to several targets */
+    if (input.ntargets) {
+        exit_code = write_targets();
+        goto finish;
+    }
+
+    /* Forge many variants */
+    if (input.variants) {
+        exit_code = write_variants();
+        goto finish;
+    }
+
+    /* Forge */
+    if (input.has_charset) {
+        if ((exit_code = forge_charset(&ret)))
+            goto finish;
+    } else if (input.min_flips) {
+        if ((exit_code = forge_min_flips(&ret)))
+            goto finish;
+    } else {
+        ret = forge_bits();
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "FAIL! try giving %jd mutable bits more (got %zu)\n",
+                -ret, input.nbits);
+        exit_code = 6;
+        goto finish;
+    }
+
+    /* Show flipped bits */
+    if (input.verbose >= 1) {
+        bitoffset_t i;
+        fprintf(stderr, "flip[%jd] = {", ret);
+        for (i = 0; i < ret; i++) {
+            const char *fmt = &", %ju.%ju"[!i];
+            fprintf(stderr, fmt, input.bits[i]/8, input.bits[i]%8);
+        }
+        fprintf(stderr, " }\n");
+    }
+    if (input.oracle_cmd
+            && (exit_code = check_oracle(input.bits, (size_t)ret,
+                                         &input.target)))
+        goto finish;
+
+    if (input.output) {
+        fclose(input.out);
+        if (!(input.out = open_output(0))) {
+            exit_code = 7;
+            goto finish;
+        }
+    }
+    if ((exit_code = write_verified(input.in, input.bits, ret, input.out)))
+        goto finish;
 
     /* Success! */
     exit_code = 0;
@@ -897,12 +3971,20 @@ finish:
     if (input.in) fclose(input.in);
     if (input.out) fclose(input.out);
     crc_sparse_delete(input.sparse);
+    oracle_close(&input.oracle);
+    crc_index_destroy(&input.index);
+    bigint_destroy(&input.prefix);
     bigint_destroy(&input.checksum);
     bigint_destroy(&input.target);
+    bigint_array_delete(input.targets);
+    bigint_destroy(&input.field);
     bigint_destroy(&input.crc.poly);
     bigint_destroy(&input.crc.init);
     bigint_destroy(&input.crc.xor_out);
+    crc_untabulate(&input.crc);
     free(input.slices);
     free(input.bits);
+    bigint_array_delete(columns.col);
+    free(columns.pos);
     return exit_code;
 }
@@ -0,0 +1,276 @@
+/*
+ * Header-only C++17 CRC engine specialized at compile time.
+ *
+ * crchack::crc<Width, Poly, Init, XorOut, RefIn, RefOut> implements the CRC
+ * algorithms of crc.h (up to 64 bits wide) with the parameters as template
+ * arguments. The lookup table and the powers of x needed for bit flips are
+ * generated by constexpr functions into std::arrays, so checksums compile down
+ * to fixed-width integer code and can be evaluated at compile time.
+ *
+ * Bit positions are crchack byte.bit positions (8*byte + bit, where bit 0 is
+ * the least significant bit of the byte).
+ *
+ *     using crc32 = crchack::crc<32, 0x04c11db7, 0xffffffff, 0xffffffff,
+ *                                true, true>;
+ *     static_assert(crc32::checksum("123456789", 9) == 0xcbf43926);
+ */
+#ifndef CRCHACK_HPP
+#define CRCHACK_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace crchack {
+
+namespace detail {
+
+/* Smallest unsigned integer type of at least width bits */
+template <unsigned Width>
+using uint_least = std::conditional_t<(Width <= 8), std::uint8_t,
+                   std::conditional_t<(Width <= 16), std::uint16_t,
+                   std::conditional_t<(Width <= 32), std::uint32_t,
+                                      std::uint64_t>>>;
+
+constexpr std::uint64_t mask(unsigned width)
+{
+    return width < 64 ? (std::uint64_t{1} << width) - 1 : ~std::uint64_t{0};
+}
+
+constexpr std::uint64_t reflect(std::uint64_t x, unsigned width)
+{
+    std::uint64_t r = 0;
+    for (unsigned i = 0; i < width; i++, x >>= 1)
+        r = (r << 1) | (x & 1);
+    return r;
+}
+
+/* Multiply a polynomial by x modulo x^width + poly */
+constexpr std::uint64_t mulx(std::uint64_t a, unsigned width,
+                             std::uint64_t poly)
+{
+    const std::uint64_t carry = (a >> (width - 1)) & 1;
+    a = (a << 1) & mask(width);
+    return carry ? a ^ poly : a;
+}
+
+/* Multiply two polynomials modulo x^width + poly */
+constexpr std::uint64_t mulmod(std::uint64_t a, std::uint64_t b,
+                               unsigned width, std::uint64_t poly)
+{
+    std::uint64_t r = 0;
+    for (unsigned i = width; i-- > 0; ) {
+        r = mulx(r, width, poly);
+        if ((b >> i) & 1)
+            r ^= a;
+    }
+    return r;
+}
+
+/*
+ * Byte-at-a-time lookup table. Reflected CRCs keep the register reflected in
+ * the low bits; others keep it aligned to the most significant bits of T.
+ */
+template <class T, unsigned Width, std::uint64_t Poly, bool RefIn>
+constexpr std::array<T, 256> make_table()
+{
+    constexpr unsigned bits = 8 * sizeof(T);
+    std::array<T, 256> table{};
+    for (unsigned i = 0; i < 256; i++) {
+        std::uint64_t c = i;
+        if (RefIn) {
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (c >> 1) ^ reflect(Poly, Width) : c >> 1;
+        } else {
+            c <<= bits - 8;
+            for (int k = 0; k < 8; k++) {
+                const std::uint64_t top = (c >> (bits - 1)) & 1;
+                c = (c << 1) & mask(bits);
+                if (top)
+                    c ^= Poly << (bits - Width);
+            }
+        }
+        table[i] = static_cast<T>(c);
+    }
+    return table;
+}
+
+/* Powers x^(2^i) modulo the generator polynomial for i = 0..63 */
+template <unsigned Width, std::uint64_t Poly>
+constexpr std::array<std::uint64_t, 64> make_squares()
+{
+    std::array<std::uint64_t, 64> squares{};
+    squares[0] = mulx(1, Width, Poly);
+    for (unsigned i = 1; i < 64; i++)
+        squares[i] = mulmod(squares[i-1], squares[i-1], Width, Poly);
+    return squares;
+}
+
+} // namespace detail
+
+template <unsigned Width, std::uint64_t Poly, std::uint64_t Init = 0,
+          std::uint64_t XorOut = 0, bool RefIn = false, bool RefOut = false>
+class crc {
+    static_assert(Width >= 1 && Width <= 64, "CRC width must be 1..64 bits");
+    static_assert(!(Poly & ~detail::mask(Width))
+                  && !(Init & ~detail::mask(Width))
+                  && !(XorOut & ~detail::mask(Width)),
+                  "CRC parameters must fit in the register");
+
+public:
+    using value_type = detail::uint_least<Width>;
+    static constexpr unsigned width = Width;
+
+    /* Checksum of a message */
+    static constexpr value_type checksum(const char *msg, std::size_t len)
+    {
+        return finalize(update(load(Init), msg, len));
+    }
+    static value_type checksum(const void *msg, std::size_t len)
+    {
+        return checksum(static_cast<const char *>(msg), len);
+    }
+
+    /* Checksum of a message continued by msg (cf. crc_append()) */
+    static constexpr value_type append(value_type checksum, const char *msg,
+                                       std::size_t len)
+    {
+        return finalize(update(load(unfinalize(checksum)), msg, len));
+    }
+    static value_type append(value_type checksum, const void *msg,
+                             std::size_t len)
+    {
+        return append(checksum, static_cast<const char *>(msg), len);
+    }
+
+    /* Checksum of a len-byte message after flipping the bit at pos */
+    static constexpr value_type sparse_flip(value_type checksum,
+                                            std::uint64_t len,
+                                            std::uint64_t pos)
+    {
+        /* Bit i (in processing order) adds x^(8*len-1-i) x^Width mod P */
+        const std::uint64_t i = RefIn ? pos : (pos & ~std::uint64_t{7})
+                                            | (7 - (pos & 7));
+        const std::uint64_t d = detail::mulmod(xpow(8*len - 1 - i), Poly,
+                                               Width, Poly);
+        return static_cast<value_type>(
+            checksum ^ (RefOut ? detail::reflect(d, Width) : d));
+    }
+
+    /*
+     * Flip a subset of the bits at positions bits[0..nbits-1] of msg so that
+     * its checksum becomes target. Returns false (leaving msg unmodified) if
+     * the bits cannot produce the target checksum.
+     */
+    static bool forge(unsigned char *msg, std::size_t len, value_type target,
+                      const std::uint64_t *bits, std::size_t nbits)
+    {
+        const std::size_t words = (nbits + 63) / 64;
+        std::array<value_type, Width> basis{};
+        std::vector<std::uint64_t> comb(Width * words), row(words);
+        std::size_t i, b, rank = 0;
+        value_type d;
+
+        /* Gaussian elimination of the bit flip checksum differences */
+        for (i = 0; i < nbits && rank < Width; i++) {
+            if (bits[i] >= 8 * static_cast<std::uint64_t>(len))
+                return false;
+            d = sparse_flip(0, len, bits[i]);
+            std::fill(row.begin(), row.end(), 0);
+            row[i / 64] = std::uint64_t{1} << (i % 64);
+            for (b = Width; b-- > 0; ) {
+                if (!((d >> b) & 1))
+                    continue;
+                if (!basis[b]) {
+                    basis[b] = d;
+                    std::copy(row.begin(), row.end(), &comb[b * words]);
+                    rank++;
+                    break;
+                }
+                d ^= basis[b];
+                for (std::size_t k = 0; k < words; k++)
+                    row[k] ^= comb[b * words + k];
+            }
+        }
+
+        /* Combination of bit flips producing the checksum difference */
+        d = checksum(reinterpret_cast<const char *>(msg), len) ^ target;
+        std::fill(row.begin(), row.end(), 0);
+        for (b = Width; b-- > 0; ) {
+            if (!((d >> b) & 1))
+                continue;
+            if (!basis[b])
+                return false;
+            d ^= basis[b];
+            for (std::size_t k = 0; k < words; k++)
+                row[k] ^= comb[b * words + k];
+        }
+        for (i = 0; i < nbits; i++) {
+            if ((row[i / 64] >> (i % 64)) & 1)
+                msg[bits[i] / 8] ^= static_cast<unsigned char>(
+                    1 << (bits[i] % 8));
+        }
+        return true;
+    }
+
+private:
+    static constexpr unsigned bits = 8 * sizeof(value_type);
+    static constexpr std::array<value_type, 256> table =
+        detail::make_table<value_type, Width, Poly, RefIn>();
+    static constexpr std::array<std::uint64_t, 64> squares =
+        detail::make_squares<Width, Poly>();
+
+    /* x^n modulo the generator polynomial */
+    static constexpr std::uint64_t xpow(std::uint64_t n)
+    {
+        std::uint64_t r = 1;
+        for (unsigned i = 0; n; i++, n >>= 1) {
+            if (n & 1)
+                r = detail::mulmod(r, squares[i], Width, Poly);
+        }
+        return r;
+    }
+
+    /* Register value to the internal (reflected or aligned) representation */
+    static constexpr value_type load(std::uint64_t r)
+    {
+        return static_cast<value_type>(RefIn ? detail::reflect(r, Width)
+                                             : r << (bits - Width));
+    }
+
+    static constexpr value_type finalize(value_type reg)
+    {
+        std::uint64_t r = RefIn ? detail::reflect(reg, Width)
+                                : reg >> (bits - Width);
+        r ^= XorOut;
+        return static_cast<value_type>(RefOut ? detail::reflect(r, Width) : r);
+    }
+
+    static constexpr std::uint64_t unfinalize(value_type checksum)
+    {
+        return (RefOut ? detail::reflect(checksum, Width) : checksum) ^ XorOut;
+    }
+
+    static constexpr value_type update(value_type reg, const char *msg,
+                                       std::size_t len)
+    {
+        for (std::size_t i = 0; i < len; i++) {
+            const unsigned byte = static_cast<unsigned char>(msg[i]);
+            if (RefIn) {
+                reg = static_cast<value_type>(
+                    (reg >> 8) ^ table[(reg ^ byte) & 0xff]);
+            } else {
+                reg = static_cast<value_type>(
+                    (reg << 8) ^ table[((reg >> (bits - 8)) ^ byte) & 0xff]);
+            }
+        }
+        return reg;
+    }
+};
+
+} // namespace crchack
+
+#endif
@@ -0,0 +1,530 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+#elif defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define FILEIO_THREADS
+#endif
+#include "fileio.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FILEIO_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* Copy n bytes in the kernel starting from the input offset *off */
+static uintmax_t kernel_copy(int in, off_t *off, int out, uintmax_t n)
+{
+    struct stat st;
+    uintmax_t done = 0;
+    int use_copy_file_range;
+    const size_t chunk = (size_t)1 << 30;
+
+    if (fstat(out, &st) != 0)
+        return 0;
+    use_copy_file_range = S_ISREG(st.st_mode);
+
+    while (done < n) {
+        ssize_t ret;
+        size_t len = (n - done < chunk) ? (size_t)(n - done) : chunk;
+        if (use_copy_file_range) {
+            ret = copy_file_range(in, off, out, NULL, len, 0);
+            if (ret < 0 && (errno == EXDEV || errno == ENOSYS
+                            || errno == EINVAL || errno == EOPNOTSUPP)) {
+                use_copy_file_range = 0;
+                continue;
+            }
+        } else {
+            ret = sendfile(out, in, off, len);
+        }
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        done += (uintmax_t)ret;
+    }
+    return done;
+}
+#endif
+
+uintmax_t fileio_copy(FILE *in, FILE *out, uintmax_t n)
+{
+    uintmax_t done = 0;
+    static char buf[1 << 16];
+
+#ifdef __linux__
+    off_t off;
+    if (n >= FILEIO_COPY_MIN && fflush(out) == 0
+            && (off = ftello(in)) >= 0) {
+        done = kernel_copy(fileno(in), &off, fileno(out), n);
+        if (fseeko(in, off, SEEK_SET) != 0)
+            return done;
+    }
+#endif
+
+    while (done < n) {
+        size_t i, j = (n - done < sizeof(buf)) ? (size_t)(n - done)
+                                                : sizeof(buf);
+        if (!(j = fread(buf, sizeof(char), j, in)))
+            break;
+        for (i = 0; i < j; ) {
+            size_t ret = fwrite(buf + i, sizeof(char), j - i, out);
+            if (!ret || ferror(out))
+                return done;
+            i += ret;
+        }
+        done += j;
+    }
+    return done;
+}
+
+uintmax_t fileio_skip_hole(FILE *stream, uintmax_t max, uintmax_t *data)
+{
+    *data = UINTMAX_MAX;
+#if defined(__linux__) && defined(SEEK_DATA) && defined(SEEK_HOLE)
+    {
+        struct stat st;
+        off_t pos, start, end;
+        uintmax_t skip;
+        int fd = fileno(stream);
+
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+                || (pos = ftello(stream)) < 0)
+            return 0;
+        if ((start = lseek(fd, pos, SEEK_DATA)) < 0) {
+            /* ENXIO if only a hole remains until the end of file */
+            start = (errno == ENXIO && st.st_size > pos) ? st.st_size : pos;
+        } else if ((end = lseek(fd, start, SEEK_HOLE)) > start) {
+            *data = (uintmax_t)(end - start);
+        }
+
+        /* Resynchronize stdio with the moved file descriptor offset */
+        skip = (uintmax_t)(start - pos);
+        if (skip > max)
+            skip = max;
+        if (fseeko(stream, pos + (off_t)skip, SEEK_SET) != 0) {
+            *data = UINTMAX_MAX;
+            return 0;
+        }
+        return skip;
+    }
+#else
+    (void)stream;
+    (void)max;
+    return 0;
+#endif
+}
+
+void fileio_sequential(FILE *stream)
+{
+#ifdef __linux__
+    posix_fadvise(fileno(stream), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    (void)stream;
+#endif
+}
+
+void fileio_readahead(FILE *stream, uintmax_t skip, uintmax_t len)
+{
+#ifdef __linux__
+    off_t pos = ftello(stream);
+    if (pos >= 0 && skip <= (uintmax_t)INTMAX_MAX - (uintmax_t)pos
+            && len <= (uintmax_t)INTMAX_MAX) {
+        posix_fadvise(fileno(stream), pos + (off_t)skip, (off_t)len,
+                      POSIX_FADV_WILLNEED);
+    }
+#else
+    (void)stream;
+    (void)skip;
+    (void)len;
+#endif
+}
+
+/* Block of a reader (skip bytes of a hole followed by n bytes of data) */
+struct fileio_block {
+    char *data;
+    size_t n;
+    uintmax_t skip;
+};
+
+struct fileio_reader {
+    FILE *stream;
+    uintmax_t left;         /* bytes left to read */
+    uintmax_t data;         /* bytes left before the next hole (or max) */
+    uintmax_t pos;          /* bytes read or skipped */
+    uintmax_t hinted;       /* end of the readahead hints */
+    char *buffer;
+
+    struct fileio_block ring[FILEIO_RING];
+    size_t head;            /* blocks read */
+    size_t tail;            /* blocks released by the caller */
+    int taken;              /* block ring[tail] is held by the caller */
+    int end;                /* 1 at the end of the input, -1 on error */
+    int stop;
+#ifdef FILEIO_THREADS
+    int threaded;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t freed;
+#endif
+};
+
+/* Read the next block (returns 0 at the end of the input, -1 on error) */
+static int read_block(struct fileio_reader *r, struct fileio_block *b)
+{
+    size_t n = FILEIO_BLOCK;
+    b->n = 0;
+    b->skip = 0;
+    if (!r->left || feof(r->stream))
+        return 0;
+
+    if (r->hinted < r->pos)
+        r->hinted = r->pos;
+    if (r->hinted < r->pos + FILEIO_READAHEAD) {
+        fileio_readahead(r->stream, r->hinted - r->pos, FILEIO_READAHEAD);
+        r->hinted += FILEIO_READAHEAD;
+    }
+    if (!r->data) {
+        b->skip = fileio_skip_hole(r->stream, r->left, &r->data);
+        r->pos += b->skip;
+        if (!(r->left -= b->skip))
+            return 1;
+    }
+
+    if (r->left < n) n = (size_t)r->left;
+    if (r->data < n) n = (size_t)r->data;
+    b->n = fread(b->data, sizeof(char), n, r->stream);
+    if (ferror(r->stream))
+        return -1;
+    r->pos += b->n;
+    r->left -= b->n;
+    if (r->data != UINTMAX_MAX)
+        r->data -= b->n;
+    return 1;
+}
+
+#ifdef FILEIO_THREADS
+/* Fill the free blocks of the ring until the end of the input */
+static void *reader_thread(void *arg)
+{
+    int ret = 1;
+    struct fileio_reader *r = arg;
+
+    pthread_mutex_lock(&r->lock);
+    while (ret > 0) {
+        while (r->head - r->tail == FILEIO_RING && !r->stop)
+            pthread_cond_wait(&r->freed, &r->lock);
+        if (r->stop)
+            break;
+        pthread_mutex_unlock(&r->lock);
+        ret = read_block(r, &r->ring[r->head % FILEIO_RING]);
+        pthread_mutex_lock(&r->lock);
+        if (ret > 0)
+            r->head++;
+        else
+            r->end = ret ? -1 : 1;
+        pthread_cond_signal(&r->filled);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+#endif
+
+struct fileio_reader *fileio_reader_new(FILE *stream, uintmax_t max,
+                                        int holes)
+{
+    size_t i;
+    struct fileio_reader *r;
+    if (!(r = calloc(1, sizeof(struct fileio_reader))))
+        return NULL;
+#ifdef FILEIO_THREADS
+    if (posix_memalign((void **)&r->buffer, 4096, FILEIO_RING * FILEIO_BLOCK))
+        r->buffer = NULL;
+#else
+    r->buffer = malloc(FILEIO_RING * FILEIO_BLOCK);
+#endif
+    if (!r->buffer) {
+        free(r);
+        return NULL;
+    }
+    for (i = 0; i < FILEIO_RING; i++)
+        r->ring[i].data = r->buffer + i * FILEIO_BLOCK;
+    r->stream = stream;
+    r->left = max;
+    r->data = holes ? 0 : UINTMAX_MAX;
+    fileio_sequential(stream);
+
+#ifdef FILEIO_THREADS
+    if (pthread_mutex_init(&r->lock, NULL)
+            || pthread_cond_init(&r->filled, NULL)
+            || pthread_cond_init(&r->freed, NULL)) {
+        free(r->buffer);
+        free(r);
+        return NULL;
+    }
+    /* Without the thread, blocks are read on demand */
+    r->threaded = !pthread_create(&r->thread, NULL, reader_thread, r);
+#endif
+    return r;
+}
+
+int fileio_reader_next(struct fileio_reader *r, const char **block,
+                       size_t *n, uintmax_t *skip)
+{
+    int ret;
+    struct fileio_block *b;
+#ifdef FILEIO_THREADS
+    if (r->threaded) {
+        pthread_mutex_lock(&r->lock);
+        if (r->taken) {
+            r->tail++;
+            pthread_cond_signal(&r->freed);
+        }
+        while (r->head == r->tail && !r->end)
+            pthread_cond_wait(&r->filled, &r->lock);
+        ret = (r->head != r->tail) ? 1 : (r->end > 0) ? 0 : -1;
+        r->taken = (ret > 0);
+        pthread_mutex_unlock(&r->lock);
+        b = &r->ring[r->tail % FILEIO_RING];
+    } else
+#endif
+    {
+        b = &r->ring[0];
+        ret = read_block(r, b);
+    }
+    *block = b->data;
+    *n = (ret > 0) ? b->n : 0;
+    *skip = (ret > 0) ? b->skip : 0;
+    return ret;
+}
+
+void fileio_reader_delete(struct fileio_reader *r)
+{
+    if (!r)
+        return;
+#ifdef FILEIO_THREADS
+    if (r->threaded) {
+        pthread_mutex_lock(&r->lock);
+        r->stop = 1;
+        pthread_cond_signal(&r->freed);
+        pthread_mutex_unlock(&r->lock);
+        pthread_join(r->thread, NULL);
+    }
+    pthread_cond_destroy(&r->freed);
+    pthread_cond_destroy(&r->filled);
+    pthread_mutex_destroy(&r->lock);
+#endif
+    free(r->buffer);
+    free(r);
+}
+
+int fileio_seek(FILE *stream, uintmax_t offset)
+{
+#ifdef __linux__
+    if ((off_t)offset < 0 || (uintmax_t)(off_t)offset != offset)
+        return -1;
+    return fseeko(stream, (off_t)offset, SEEK_SET);
+#else
+    if ((long)offset < 0 || (uintmax_t)(long)offset != offset)
+        return -1;
+    return fseek(stream, (long)offset, SEEK_SET);
+#endif
+}
+
+int fileio_size(FILE *stream, uintmax_t *size)
+{
+    fpos_t pos;
+    int ret = -1;
+    if (fgetpos(stream, &pos) != 0)
+        return -1;
+#ifdef __linux__
+    if (fseeko(stream, 0, SEEK_END) == 0) {
+        off_t end = ftello(stream);
+        if (end >= 0) {
+            *size = (uintmax_t)end;
+            ret = 0;
+        }
+    }
+#else
+    if (fseek(stream, 0, SEEK_END) == 0) {
+        long end = ftell(stream);
+        if (end >= 0) {
+            *size = (uintmax_t)end;
+            ret = 0;
+        }
+    }
+#endif
+    if (fsetpos(stream, &pos) != 0)
+        ret = -1;
+    return ret;
+}
+
+int fileio_stat(FILE *stream, uintmax_t *size, intmax_t *mtime)
+{
+#ifdef __linux__
+    struct stat st;
+    if (fstat(fileno(stream), &st) != 0 || !S_ISREG(st.st_mode))
+        return 0;
+    *size = (uintmax_t)st.st_size;
+    *mtime = (intmax_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return 1;
+#else
+    *mtime = -1;
+    return fileio_size(stream, size) == 0;
+#endif
+}
+
+void *fileio_load(const char *filename, size_t *size)
+{
+    FILE *in;
+    char *buf = NULL;
+    size_t capacity = 0;
+
+    if (!(in = !strcmp(filename, "-") ? stdin : fopen(filename, "rb")))
+        return NULL;
+    *size = 0;
+    do {
+        if (*size == capacity) {
+            char *new = realloc(buf, (capacity = 2*capacity + 4096));
+            if (!new) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = new;
+        }
+        *size += fread(buf + *size, sizeof(char), capacity - *size, in);
+    } while (!feof(in) && !ferror(in));
+
+    if (buf && ferror(in)) {
+        free(buf);
+        buf = NULL;
+    }
+    if (in != stdin)
+        fclose(in);
+    return buf;
+}
+
+/* Create the missing parent directories of a file */
+static void make_parents(const char *filename)
+{
+#ifdef __linux__
+    char *path, *p;
+    if (!(path = malloc(strlen(filename) + 1)))
+        return;
+    strcpy(path, filename);
+    for (p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        mkdir(path, 0777);
+        *p = '/';
+    }
+    free(path);
+#else
+    (void)filename;
+#endif
+}
+
+FILE *fileio_replace_open(struct fileio_replace *r, const char *filename)
+{
+    r->stream = NULL;
+    r->filename = filename;
+    if (!(r->temp = malloc(strlen(filename) + 8)))
+        return NULL;
+    sprintf(r->temp, "%s.XXXXXX", filename);
+    make_parents(filename);
+#ifdef __linux__
+    {
+        int fd = mkstemp(r->temp);
+        if (fd >= 0 && !(r->stream = fdopen(fd, "wb"))) {
+            close(fd);
+            remove(r->temp);
+        }
+    }
+#else
+    r->stream = fopen(r->temp, "wb");
+#endif
+    if (!r->stream) {
+        free(r->temp);
+        r->temp = NULL;
+    }
+    return r->stream;
+}
+
+int fileio_replace_commit(struct fileio_replace *r)
+{
+    int ok = !ferror(r->stream);
+    ok &= !fclose(r->stream);
+#ifndef __linux__
+    if (ok)
+        remove(r->filename);
+#endif
+    if (!ok || rename(r->temp, r->filename)) {
+        remove(r->temp);
+        ok = 0;
+    }
+    free(r->temp);
+    r->stream = NULL;
+    r->temp = NULL;
+    return ok;
+}
+
+void fileio_replace_abort(struct fileio_replace *r)
+{
+    fclose(r->stream);
+    remove(r->temp);
+    free(r->temp);
+    r->stream = NULL;
+    r->temp = NULL;
+}
+
+int fileio_view_open(struct fileio_view *view, const char *filename)
+{
+#ifdef __linux__
+    struct stat st;
+    int fd;
+    if (strcmp(filename, "-") && (fd = open(filename, O_RDONLY)) >= 0) {
+        void *data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+                && (uintmax_t)st.st_size <= SIZE_MAX) {
+            data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (data != MAP_FAILED) {
+            view->data = data;
+            view->size = (size_t)st.st_size;
+            view->mapped = 1;
+            return 1;
+        }
+    }
+#endif
+    view->mapped = 0;
+    view->data = fileio_load(filename, &view->size);
+    return view->data != NULL;
+}
+
+void fileio_view_close(struct fileio_view *view)
+{
+#ifdef __linux__
+    if (view->mapped) {
+        munmap((void *)view->data, view->size);
+        view->data = NULL;
+        return;
+    }
+#endif
+    free((void *)view->data);
+    view->data = NULL;
+}
@@ -0,0 +1,150 @@
+/*
+ * Platform-specific file I/O helpers.
+ */
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Spans shorter than this are not worth the system calls of fileio_copy() */
+#define FILEIO_COPY_MIN ((uintmax_t)1 << 16)
+
+/*
+ * Copy n bytes from the current position of stream `in` to stream `out`.
+ *
+ * On Linux, the data is copied in the kernel with copy_file_range(2) when the
+ * output is a regular file (which allows reflinking on filesystems supporting
+ * it) or with sendfile(2) otherwise. Anything the kernel refuses to copy falls
+ * back to fread() and fwrite(). Both streams are left positioned after the
+ * copied span. Returns the number of bytes copied, which is less than n on
+ * error or if the input ends first.
+ */
+uintmax_t fileio_copy(FILE *in, FILE *out, uintmax_t n);
+
+/*
+ * Skip a hole of a sparse file at the current position of the stream.
+ *
+ * Holes are located with lseek(2) SEEK_DATA and SEEK_HOLE on Linux. At most
+ * max bytes are skipped. The length of the data region following the hole is
+ * stored in *data, or UINTMAX_MAX if holes cannot be detected. Returns the
+ * number of skipped bytes, which read as zeros.
+ */
+uintmax_t fileio_skip_hole(FILE *stream, uintmax_t max, uintmax_t *data);
+
+/* Distance that sequential readers keep hinted ahead of their position */
+#define FILEIO_READAHEAD ((uintmax_t)8 << 20)
+
+/*
+ * Hint that the stream will be read sequentially from its current position.
+ *
+ * On Linux, posix_fadvise(2) enlarges the kernel readahead window of regular
+ * files. Elsewhere (and for pipes), this does nothing.
+ */
+void fileio_sequential(FILE *stream);
+
+/*
+ * Start reading len bytes at skip bytes past the current stream position in
+ * the background, so that the I/O overlaps with processing the data before
+ * it. On Linux, this is posix_fadvise(2) POSIX_FADV_WILLNEED; elsewhere it does
+ * nothing.
+ */
+void fileio_readahead(FILE *stream, uintmax_t skip, uintmax_t len);
+
+/* Block size and number of blocks in the ring of fileio_reader */
+#define FILEIO_BLOCK ((size_t)1 << 20)
+#define FILEIO_RING 4
+
+/*
+ * Sequential reader of a stream.
+ *
+ * A background thread reads the stream into a ring of FILEIO_RING page-aligned
+ * blocks while the caller processes the blocks read before, and the blocks are
+ * consumed in order. The thread keeps a fileio_readahead() hint ahead of its
+ * position, so the kernel fetches the data even further ahead. With `holes`
+ * set, the holes of sparse files are skipped by fileio_skip_hole(). Without
+ * threads, each block is read when it is requested.
+ */
+struct fileio_reader;
+
+/*
+ * Start reading at most max bytes from the current position of the stream.
+ *
+ * The stream must not be used until fileio_reader_delete(), which leaves it
+ * positioned after the bytes read. Returns NULL if out of memory.
+ */
+struct fileio_reader *fileio_reader_new(FILE *stream, uintmax_t max,
+                                        int holes);
+
+/*
+ * Get the next block and release the previous one.
+ *
+ * The block and its length (at most FILEIO_BLOCK bytes) are stored in *block
+ * and *n, and the length of the hole skipped before it (read as zeros) in
+ * *skip. Returns 1 for a block, 0 at the end of the input or -1 on a read
+ * error.
+ */
+int fileio_reader_next(struct fileio_reader *reader, const char **block,
+                       size_t *n, uintmax_t *skip);
+
+/* Stop the reader and release its blocks */
+void fileio_reader_delete(struct fileio_reader *reader);
+
+/* Seek to an absolute byte offset (beyond 2 GiB where supported) */
+int fileio_seek(FILE *stream, uintmax_t offset);
+
+/* Size of a seekable stream in bytes (the stream position is preserved) */
+int fileio_size(FILE *stream, uintmax_t *size);
+
+/*
+ * Size and modification time of a stream for detecting changed files.
+ *
+ * The modification time is in nanoseconds on Linux (so that rewrites within
+ * the same second are told apart) and -1 where it is not available. Returns
+ * zero if the stream is not a regular (seekable) file.
+ */
+int fileio_stat(FILE *stream, uintmax_t *size, intmax_t *mtime);
+
+/* Read a whole file ("-" for stdin) into a malloc'd buffer (NULL on error) */
+void *fileio_load(const char *filename, size_t *size);
+
+/* File being replaced by fileio_replace_open() */
+struct fileio_replace {
+    FILE *stream;           /* new contents are written here */
+    char *temp;             /* temporary file next to the target */
+    const char *filename;
+};
+
+/*
+ * Start replacing a file atomically.
+ *
+ * The missing parent directories of the file are created (like mkdir -p) and
+ * a temporary file is created next to it. Returns the stream of the temporary
+ * file (or NULL on error). fileio_replace_commit() then renames it over the
+ * target, so that readers never see a partially written file, and returns
+ * zero if writing or renaming failed. fileio_replace_abort() removes it.
+ */
+FILE *fileio_replace_open(struct fileio_replace *r, const char *filename);
+int fileio_replace_commit(struct fileio_replace *r);
+void fileio_replace_abort(struct fileio_replace *r);
+
+/* Read-only view of a whole file */
+struct fileio_view {
+    const uint8_t *data;
+    size_t size;
+    int mapped;             /* data is mmap'd (otherwise malloc'd) */
+};
+
+/*
+ * Open a read-only view of a file.
+ *
+ * Regular files are mmap(2)'d on Linux, so only the pages actually read are
+ * loaded and writes to the file through other streams show through the view.
+ * Other files are read into memory with fileio_load(). Returns zero on error.
+ */
+int fileio_view_open(struct fileio_view *view, const char *filename);
+
+/* Release a view opened by fileio_view_open() */
+void fileio_view_close(struct fileio_view *view);
+
+#endif
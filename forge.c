@@ -1,45 +1,29 @@
 #include "forge.h"
 
-bitoffset_t forge(const struct bigint *target_checksum,
-                  void (*H)(bitsize_t pos, struct bigint *out),
-                  bitsize_t bits[], size_t nbits)
+/*
+ * Gauss-Jordan elimination shared by forge(), forge_affine() and
+ * forge_affine_columns(). On entry, AT[i] is the column of bits[i] and acc
+ * is H(msg).
+ *
+ * Returns the rank of the system (or a negative value as in forge()). Upon
+ * success, bit i of acc is set if bits[i] is flipped in the solution, the
+ * first `rank` elements of bits[] are pivots and AT[j] (j >= rank) records
+ * the pivots whose combination cancels out the column of bits[j].
+ */
+static bitoffset_t reduce(const struct bigint *target_checksum,
+                          bitsize_t bits[], size_t nbits,
+                          struct bigint *AT, struct bigint *acc)
 {
-    bitoffset_t ret;
     bitsize_t i, j, p;
-    struct bigint acc, *AT;
     const bitsize_t width = target_checksum->bits;
 
-    /* Initialize accumulator vector */
-    if (!bigint_init(&acc, width))
-        return -(bitoffset_t)(width + 1);
-
-    /* Initialize bigints for matrix A */
-    if (!(AT = calloc(nbits, sizeof(struct bigint)))) {
-        bigint_destroy(&acc);
-        return -(bitoffset_t)(width + 2);
-    }
-    for (i = 0; i < nbits; i++) {
-        if (!bigint_init(&AT[i], width)) {
-            ret = -(bitoffset_t)(width + 2);
-            nbits = i;
-            goto finish;
-        }
-    }
-
-    /* A[i] = H(msg ^ bits[i]) ^ H(msg) */
-    H(~(bitsize_t)0, &acc);
-    for (i = 0; i < nbits; i++) {
-        H(bits[i], &AT[i]);
-        bigint_xor(&AT[i], &acc);
-    }
-
     /*
      * Solve Ax = b where b = target_checksum ^ H(msg).
      *
      * Accumulator combines the vectors: x = acc[..i] and b = acc[i..].
      */
     p = 0;
-    bigint_xor(&acc, target_checksum);
+    bigint_xor(acc, target_checksum);
     for (i = 0; i < width; i++) {
         /* Find a pivot row with a non-zero column i */
         for (j = p; j < nbits; j++) {
@@ -63,19 +47,60 @@ bitoffset_t forge(const struct bigint *target_checksum,
                 }
             }
 
-            if (bigint_get_bit(&acc, i)) {
-                bigint_xor(&acc, &AT[p]);
-                bigint_set_bit(&acc, p);
+            if (bigint_get_bit(acc, i)) {
+                bigint_xor(acc, &AT[p]);
+                bigint_set_bit(acc, p);
             }
 
             p++;
-        } else if (bigint_get_bit(&acc, i)) {
+        } else if (bigint_get_bit(acc, i)) {
             /* Pivot required but zero column found. Need more bits! */
-            ret = -(bitoffset_t)(width - i);
-            goto finish;
+            return -(bitoffset_t)(width - i);
         }
     }
 
+    return p;
+}
+
+/* Columns of the bits from H() for reduce() */
+static bitoffset_t eliminate(const struct bigint *target_checksum,
+                             void (*H)(bitsize_t pos, struct bigint *out),
+                             bitsize_t bits[], size_t nbits,
+                             struct bigint *AT, struct bigint *acc)
+{
+    bitsize_t i;
+
+    /* A[i] = H(msg ^ bits[i]) ^ H(msg) */
+    H(~(bitsize_t)0, acc);
+    for (i = 0; i < nbits; i++) {
+        H(bits[i], &AT[i]);
+        bigint_xor(&AT[i], acc);
+    }
+    return reduce(target_checksum, bits, nbits, AT, acc);
+}
+
+bitoffset_t forge(const struct bigint *target_checksum,
+                  void (*H)(bitsize_t pos, struct bigint *out),
+                  bitsize_t bits[], size_t nbits)
+{
+    bitoffset_t ret;
+    bitsize_t i;
+    struct bigint acc, *AT;
+    const bitsize_t width = target_checksum->bits;
+
+    /* Initialize accumulator vector */
+    if (!bigint_init(&acc, width))
+        return -(bitoffset_t)(width + 1);
+
+    /* Initialize bigints for matrix A */
+    if (!(AT = bigint_array_new(nbits, width))) {
+        bigint_destroy(&acc);
+        return -(bitoffset_t)(width + 2);
+    }
+
+    if ((ret = eliminate(target_checksum, H, bits, nbits, AT, &acc)) < 0)
+        goto finish;
+
     /* Move bit flips to the beginning of the bits array */
     ret = 0;
     for (i = 0; i < width; i++) {
@@ -89,8 +114,231 @@ bitoffset_t forge(const struct bigint *target_checksum,
 
 finish:
     bigint_destroy(&acc);
+    bigint_array_delete(AT);
+    return ret;
+}
+
+bitoffset_t forge_affine(const struct bigint *target_checksum,
+                         void (*H)(bitsize_t pos, struct bigint *out),
+                         bitsize_t bits[], size_t nbits,
+                         struct forge_space *space)
+{
+    bitoffset_t ret;
+    struct bigint *AT;
+    const bitsize_t width = target_checksum->bits;
+
+    space->kernel = NULL;
+    space->rank = space->dim = 0;
+    if (!bigint_init(&space->x, width))
+        return -(bitoffset_t)(width + 1);
+    if (!(AT = bigint_array_new(nbits, width))) {
+        bigint_destroy(&space->x);
+        return -(bitoffset_t)(width + 2);
+    }
+
+    if ((ret = eliminate(target_checksum, H, bits, nbits, AT, &space->x)) < 0) {
+        bigint_array_delete(AT);
+        bigint_destroy(&space->x);
+        return ret;
+    }
+
+    space->AT = AT;
+    space->rank = (size_t)ret;
+    space->kernel = &AT[ret];
+    space->dim = nbits - space->rank;
+    return ret;
+}
+
+bitoffset_t forge_affine_columns(const struct bigint *target_checksum,
+                                 const struct bigint *base,
+                                 const struct bigint columns[],
+                                 bitsize_t bits[], size_t nbits,
+                                 struct forge_space *space)
+{
+    bitoffset_t ret;
+    size_t i;
+    struct bigint *AT;
+    const bitsize_t width = target_checksum->bits;
+
+    space->kernel = NULL;
+    space->rank = space->dim = 0;
+    if (!bigint_init(&space->x, width))
+        return -(bitoffset_t)(width + 1);
+    if (!(AT = bigint_array_new(nbits, width))) {
+        bigint_destroy(&space->x);
+        return -(bitoffset_t)(width + 2);
+    }
+
+    bigint_mov(&space->x, base);
     for (i = 0; i < nbits; i++)
-        bigint_destroy(&AT[i]);
-    free(AT);
+        bigint_mov(&AT[i], &columns[i]);
+    if ((ret = reduce(target_checksum, bits, nbits, AT, &space->x)) < 0) {
+        bigint_array_delete(AT);
+        bigint_destroy(&space->x);
+        return ret;
+    }
+
+    space->AT = AT;
+    space->rank = (size_t)ret;
+    space->kernel = &AT[ret];
+    space->dim = nbits - space->rank;
     return ret;
 }
+
+void forge_space_destroy(struct forge_space *space)
+{
+    bigint_array_delete(space->AT);
+    bigint_destroy(&space->x);
+    space->AT = space->kernel = NULL;
+    space->rank = space->dim = 0;
+}
+
+/*
+ * Incremental solver
+ */
+struct forge_solver *forge_solver_new(bitsize_t width,
+                                      void (*H)(bitsize_t pos,
+                                                struct bigint *out))
+{
+    struct forge_solver *solver;
+    if (!(solver = calloc(1, sizeof(struct forge_solver))))
+        return NULL;
+    solver->H = H;
+    solver->width = width;
+    if (!bigint_init(&solver->base, width)
+            || !bigint_init(&solver->col, width)
+            || !bigint_init(&solver->acc, width)
+            || !(solver->vec = bigint_array_new(2 * width, width))
+            || !(solver->lead = calloc(width, sizeof(size_t)))
+            || !(solver->row = calloc(width, sizeof(size_t)))
+            || !(solver->pivot = calloc(width, sizeof(size_t)))) {
+        forge_solver_delete(solver);
+        return NULL;
+    }
+    solver->comb = &solver->vec[width];
+    H(~(bitsize_t)0, &solver->base);
+    return solver;
+}
+
+int forge_solver_add_bit(struct forge_solver *solver, bitsize_t pos)
+{
+    bitsize_t i;
+    const size_t k = solver->rank;
+    struct bigint *col = &solver->col;
+
+    if (solver->nbits == solver->capacity) {
+        size_t capacity = 2 * solver->capacity + solver->width;
+        bitsize_t *bits = realloc(solver->bits, capacity * sizeof(bitsize_t));
+        if (!bits)
+            return -1;
+        solver->bits = bits;
+        solver->capacity = capacity;
+    }
+    solver->bits[solver->nbits++] = pos;
+    if (k == solver->width)
+        return 0;
+
+    /* Reduce the column from its highest bit down to a new leading bit */
+    solver->H(pos, col);
+    bigint_xor(col, &solver->base);
+    bigint_load_zeros(&solver->comb[k]);
+    for (i = solver->width; i-- > 0; ) {
+        if (bigint_get_bit(col, i)) {
+            const size_t j = solver->row[i];
+            if (!j)
+                break;
+            bigint_xor(col, &solver->vec[j-1]);
+            bigint_xor(&solver->comb[k], &solver->comb[j-1]);
+        }
+    }
+    if (i == ~(bitsize_t)0)
+        return 0;
+
+    bigint_mov(&solver->vec[k], col);
+    bigint_set_bit(&solver->comb[k], k);
+    solver->lead[k] = (size_t)i;
+    solver->row[i] = k + 1;
+    solver->pivot[k] = solver->nbits - 1;
+    solver->rank++;
+    return 1;
+}
+
+size_t forge_solver_rank(const struct forge_solver *solver)
+{
+    return solver->rank;
+}
+
+/* Back-substitute target ^ checksum (col and acc are width-bit work vectors) */
+static bitoffset_t solve(const struct forge_solver *solver,
+                         const struct bigint *checksum,
+                         const struct bigint *target_checksum,
+                         struct bigint *col, struct bigint *acc,
+                         bitsize_t flips[])
+{
+    bitsize_t i;
+    size_t k;
+    bitoffset_t ret = 0;
+
+    bigint_mov(col, target_checksum);
+    bigint_xor(col, checksum);
+    bigint_load_zeros(acc);
+    for (i = solver->width; i-- > 0; ) {
+        if (bigint_get_bit(col, i)) {
+            const size_t j = solver->row[i];
+            if (!j)
+                return -(bitoffset_t)(solver->width - solver->rank);
+            bigint_xor(col, &solver->vec[j-1]);
+            bigint_xor(acc, &solver->comb[j-1]);
+        }
+    }
+
+    for (k = 0; k < solver->rank; k++) {
+        if (bigint_get_bit(acc, k))
+            flips[ret++] = solver->bits[solver->pivot[k]];
+    }
+    return ret;
+}
+
+bitoffset_t forge_solver_try_solve(struct forge_solver *solver,
+                                   const struct bigint *target_checksum,
+                                   bitsize_t flips[])
+{
+    return solve(solver, &solver->base, target_checksum, &solver->col,
+                 &solver->acc, flips);
+}
+
+bitoffset_t forge_solver_solve(const struct forge_solver *solver,
+                               const struct bigint *checksum,
+                               const struct bigint *target_checksum,
+                               struct bigint work[2], bitsize_t flips[])
+{
+    return solve(solver, checksum, target_checksum, &work[0], &work[1], flips);
+}
+
+int forge_solver_remove_last(struct forge_solver *solver)
+{
+    const size_t k = solver->rank;
+    if (!solver->nbits)
+        return 0;
+    solver->nbits--;
+    if (k && solver->pivot[k-1] == solver->nbits) {
+        solver->row[solver->lead[k-1]] = 0;
+        solver->rank--;
+    }
+    return 1;
+}
+
+void forge_solver_delete(struct forge_solver *solver)
+{
+    if (solver) {
+        free(solver->bits);
+        free(solver->pivot);
+        free(solver->row);
+        free(solver->lead);
+        bigint_array_delete(solver->vec);
+        bigint_destroy(&solver->acc);
+        bigint_destroy(&solver->col);
+        bigint_destroy(&solver->base);
+        free(solver);
+    }
+}
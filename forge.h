@@ -42,4 +42,120 @@ bitoffset_t forge(const struct bigint *target_checksum,
                   void (*H)(bitsize_t pos, struct bigint *out),
                   bitsize_t bits[], size_t nbits);
 
+/*
+ * Affine space of all solutions found by forge_affine().
+ *
+ * The first `rank` elements of the (permuted) bits[] array are pivot bits and
+ * the remaining `dim` elements are free bits. Bit i of the particular solution
+ * `x` is set if bits[i] is flipped (i < rank). Each free bit bits[rank + k]
+ * has a null space basis vector consisting of the free bit itself and the
+ * pivot bits bits[i] for which bit i of `kernel[k]` is set. Any solution XOR
+ * any combination of the basis vectors yields another valid solution.
+ */
+struct forge_space {
+    size_t rank;            /* number of pivot bits */
+    struct bigint x;        /* particular solution over the pivot bits */
+    struct bigint *kernel;  /* null space basis (dim vectors) */
+    size_t dim;             /* dimension of the null space */
+    struct bigint *AT;      /* storage for the kernel vectors */
+};
+
+/*
+ * Like forge() but return the whole affine space of solutions.
+ *
+ * Returns the rank of the system and fills `space` (to be released with
+ * forge_space_destroy()). On error, returns a negative value like forge().
+ */
+bitoffset_t forge_affine(const struct bigint *target_checksum,
+                         void (*H)(bitsize_t pos, struct bigint *out),
+                         bitsize_t bits[], size_t nbits,
+                         struct forge_space *space);
+
+/*
+ * Like forge_affine() but with the columns of the bits given by the caller:
+ * `base` is H(msg) and columns[i] is H(msg ^ bits[i]) ^ H(msg). No callback
+ * (and no global state behind one) is needed, so independent systems can be
+ * solved in parallel threads.
+ */
+bitoffset_t forge_affine_columns(const struct bigint *target_checksum,
+                                 const struct bigint *base,
+                                 const struct bigint columns[],
+                                 bitsize_t bits[], size_t nbits,
+                                 struct forge_space *space);
+
+/* Release a solution space filled by forge_affine() */
+void forge_space_destroy(struct forge_space *space);
+
+/*
+ * Incremental solver for choosing mutable bits adaptively.
+ *
+ * Bits are added one at a time, and each added column H(msg ^ bit) ^ H(msg) is
+ * reduced against an echelon basis kept between calls in O(w²/64) time. Bit k
+ * of comb[j] is set if vec[j] is the XOR of the column of pivot k and earlier
+ * pivot columns. Added bits are removed in the reverse order of addition.
+ */
+struct forge_solver {
+    void (*H)(bitsize_t pos, struct bigint *out);
+    bitsize_t width;        /* checksum width */
+    struct bigint base;     /* checksum of the unmodified message */
+    struct bigint col;      /* work vectors */
+    struct bigint acc;
+
+    struct bigint *vec;     /* echelon basis of the added columns (rank) */
+    struct bigint *comb;    /* pivots combined into each basis vector */
+    size_t *lead;           /* leading bit of each basis vector */
+    size_t *row;            /* 1 + basis vector leading at each bit (or 0) */
+    size_t *pivot;          /* index of the pivot bit of each basis vector */
+    size_t rank;
+
+    bitsize_t *bits;        /* added bits in the order of addition */
+    size_t nbits;
+    size_t capacity;
+};
+
+/* New incremental solver for width-bit checksums (NULL if out of memory) */
+struct forge_solver *forge_solver_new(bitsize_t width,
+                                      void (*H)(bitsize_t pos,
+                                                struct bigint *out));
+
+/*
+ * Add a mutable bit to the solver.
+ *
+ * Returns 1 if the bit increased the rank, 0 if its column is a combination of
+ * the columns of the previously added bits, or a negative value on error.
+ */
+int forge_solver_add_bit(struct forge_solver *solver, bitsize_t pos);
+
+/* Rank of the added bits (the target is always reachable at full width) */
+size_t forge_solver_rank(const struct forge_solver *solver);
+
+/*
+ * Find bit flips producing the target checksum with the added bits.
+ *
+ * Stores the flipped bits in `flips[]` (at most rank elements) and returns
+ * their count. On error, returns a negative value like forge().
+ */
+bitoffset_t forge_solver_try_solve(struct forge_solver *solver,
+                                   const struct bigint *target_checksum,
+                                   bitsize_t flips[]);
+
+/*
+ * Like forge_solver_try_solve() for another message of the same length.
+ *
+ * The columns depend only on the message length, so a solver built for one
+ * message solves any message of the same length given its checksum. The
+ * solver is not modified, so threads can share it, each passing its own two
+ * width-bit work vectors in `work[]`.
+ */
+bitoffset_t forge_solver_solve(const struct forge_solver *solver,
+                               const struct bigint *checksum,
+                               const struct bigint *target_checksum,
+                               struct bigint work[2], bitsize_t flips[]);
+
+/* Remove the last added bit (returns zero if no bits are left) */
+int forge_solver_remove_last(struct forge_solver *solver);
+
+/* Delete incremental solver */
+void forge_solver_delete(struct forge_solver *solver);
+
 #endif
@@ -0,0 +1,180 @@
+#include "index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Next whitespace-separated token of a line (NULL if none) */
+static char *token(char **p)
+{
+    char *start = *p + strspn(*p, " \t\r\n");
+    if (!*start)
+        return NULL;
+    *p = start + strcspn(start, " \t\r\n");
+    if (**p)
+        *(*p)++ = '\0';
+    return start;
+}
+
+/* Does the hexadecimal string equal b (tmp is work space) */
+static int equals(struct bigint *tmp, const char *hex, const struct bigint *b)
+{
+    bitsize_t i;
+    if (!bigint_from_string(tmp, hex))
+        return 0;
+    for (i = 0; i < b->bits; i++) {
+        if (bigint_get_bit(tmp, i) != bigint_get_bit(b, i))
+            return 0;
+    }
+    return 1;
+}
+
+static int push(struct crc_index *index, uintmax_t offset,
+                const struct bigint *checksum, const struct bigint *sample)
+{
+    struct crc_checkpoint *cp;
+    if (index->n == index->capacity) {
+        size_t capacity = 2 * index->capacity + 16;
+        cp = realloc(index->cp, capacity * sizeof(struct crc_checkpoint));
+        if (!cp)
+            return 0;
+        index->cp = cp;
+        index->capacity = capacity;
+    }
+    cp = &index->cp[index->n];
+    if (!bigint_init(&cp->checksum, checksum->bits))
+        return 0;
+    if (!bigint_init(&cp->sample, sample->bits)) {
+        bigint_destroy(&cp->checksum);
+        return 0;
+    }
+    cp->offset = offset;
+    bigint_mov(&cp->checksum, checksum);
+    bigint_mov(&cp->sample, sample);
+    index->n++;
+    return 1;
+}
+
+int crc_index_load(struct crc_index *index, const char *filename,
+                   const struct crc_config *crc)
+{
+    FILE *in;
+    size_t i, size;
+    unsigned int width;
+    struct bigint *tmp;
+    char *line, *p, *tok[7];
+    int ret = 0;
+
+    if (!(in = fopen(filename, "rb")))
+        return 0;
+    size = 3 * (crc->width / 4 + 2) + 128;
+    line = malloc(size);
+    tmp = bigint_array_new(2, crc->width);
+    if (!line || !tmp) {
+        ret = -1;
+        goto finish;
+    }
+
+    /* Header: CRC algorithm and fingerprint of the indexed file */
+    if (!fgets(line, (int)size, in))
+        goto finish;
+    for (p = line, i = 0; i < 7; i++) {
+        if (!(tok[i] = token(&p)))
+            goto finish;
+    }
+    if (strcmp(tok[0], "crchack-index") || sscanf(tok[1], "%u", &width) != 1
+            || width != crc->width || !equals(&tmp[0], tok[2], &crc->poly)
+            || !equals(&tmp[0], tok[3], &crc->init)
+            || !equals(&tmp[0], tok[4], &crc->xor_out)
+            || strcmp(tok[5], crc->reflect_in ? "1" : "0")
+            || strcmp(tok[6], crc->reflect_out ? "1" : "0"))
+        goto finish;
+    if (!fgets(line, (int)size, in)
+            || sscanf(line, "file %ju %jd", &index->size, &index->mtime) != 2)
+        goto finish;
+
+    /* Checkpoints (a truncated last line of an interrupted run is ignored) */
+    while (fgets(line, (int)size, in)) {
+        uintmax_t offset;
+        p = line;
+        if (!(tok[0] = token(&p)) || !(tok[1] = token(&p))
+                || !(tok[2] = token(&p)) || sscanf(tok[0], "%ju", &offset) != 1
+                || !bigint_from_string(&tmp[0], tok[1])
+                || !bigint_from_string(&tmp[1], tok[2]))
+            break;
+        if (!push(index, offset, &tmp[0], &tmp[1])) {
+            ret = -1;
+            goto finish;
+        }
+    }
+    ret = (int)index->n;
+
+finish:
+    bigint_array_delete(tmp);
+    free(line);
+    fclose(in);
+    return ret;
+}
+
+int crc_index_open(struct crc_index *index, const char *filename,
+                   const struct crc_config *crc, uintmax_t size,
+                   intmax_t mtime, size_t keep)
+{
+    size_t i;
+    if (!(index->out = fopen(filename, "wb")))
+        return 0;
+    index->size = size;
+    index->mtime = mtime;
+
+    fprintf(index->out, "crchack-index %u ", crc->width);
+    bigint_fprint(index->out, &crc->poly);
+    fputc(' ', index->out);
+    bigint_fprint(index->out, &crc->init);
+    fputc(' ', index->out);
+    bigint_fprint(index->out, &crc->xor_out);
+    fprintf(index->out, " %d %d\n", !!crc->reflect_in, !!crc->reflect_out);
+    fprintf(index->out, "file %ju %jd\n", size, mtime);
+
+    for (i = 0; i < index->n; i++) {
+        if (i < keep) {
+            fprintf(index->out, "%ju ", index->cp[i].offset);
+            bigint_fprint(index->out, &index->cp[i].checksum);
+            fputc(' ', index->out);
+            bigint_fprint(index->out, &index->cp[i].sample);
+            fputc('\n', index->out);
+        } else {
+            bigint_destroy(&index->cp[i].checksum);
+            bigint_destroy(&index->cp[i].sample);
+        }
+    }
+    if (index->n > keep)
+        index->n = keep;
+    return fflush(index->out) == 0 && !ferror(index->out);
+}
+
+int crc_index_add(struct crc_index *index, uintmax_t offset,
+                  const struct bigint *checksum, const struct bigint *sample)
+{
+    if (!push(index, offset, checksum, sample))
+        return 0;
+    fprintf(index->out, "%ju ", offset);
+    bigint_fprint(index->out, checksum);
+    fputc(' ', index->out);
+    bigint_fprint(index->out, sample);
+    fputc('\n', index->out);
+
+    /* Flushed so that an interrupted run can be resumed */
+    return fflush(index->out) == 0 && !ferror(index->out);
+}
+
+void crc_index_destroy(struct crc_index *index)
+{
+    size_t i;
+    if (index->out)
+        fclose(index->out);
+    for (i = 0; i < index->n; i++) {
+        bigint_destroy(&index->cp[i].checksum);
+        bigint_destroy(&index->cp[i].sample);
+    }
+    free(index->cp);
+    memset(index, 0, sizeof(struct crc_index));
+}
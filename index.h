@@ -0,0 +1,69 @@
+/*
+ * Checkpoint index sidecar files for resumable hashing.
+ */
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "crc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Distance between checkpoints in bytes */
+#define INDEX_INTERVAL ((uintmax_t)16 << 20)
+
+/* Bytes before each checkpoint fingerprinted by its sample checksum */
+#define INDEX_SAMPLE 4096
+
+/* CRC state of a file prefix */
+struct crc_checkpoint {
+    uintmax_t offset;       /* prefix length in bytes */
+    struct bigint checksum; /* checksum of the prefix */
+    struct bigint sample;   /* checksum of the INDEX_SAMPLE bytes before offset */
+};
+
+/*
+ * Checkpoints of a file.
+ *
+ * The size and modification time of the file are recorded when the index is
+ * written. If they still match, all checkpoints are valid. Otherwise (e.g.,
+ * after an append or an in-place edit), a checkpoint is trusted only if its
+ * sample and the samples of all earlier checkpoints still match; the samples
+ * cannot detect edits elsewhere in the prefix.
+ */
+struct crc_index {
+    uintmax_t size;         /* file size when indexed */
+    intmax_t mtime;         /* file modification time when indexed */
+    struct crc_checkpoint *cp;
+    size_t n;
+    size_t capacity;
+    FILE *out;              /* index file being written */
+};
+
+/*
+ * Load the checkpoints of an index file written for the same CRC algorithm.
+ *
+ * Returns the number of checkpoints loaded (zero if the file does not exist or
+ * belongs to another CRC algorithm), or a negative value if out of memory.
+ */
+int crc_index_load(struct crc_index *index, const char *filename,
+                   const struct crc_config *crc);
+
+/*
+ * Rewrite the index file for a file of the given size and modification time.
+ *
+ * The first `keep` loaded checkpoints are written back and the file is left
+ * open for crc_index_add(). Returns zero on error.
+ */
+int crc_index_open(struct crc_index *index, const char *filename,
+                   const struct crc_config *crc, uintmax_t size,
+                   intmax_t mtime, size_t keep);
+
+/* Append a checkpoint to the open index file (zero on error) */
+int crc_index_add(struct crc_index *index, uintmax_t offset,
+                  const struct bigint *checksum, const struct bigint *sample);
+
+/* Close the index file and release the checkpoints */
+void crc_index_destroy(struct crc_index *index);
+
+#endif
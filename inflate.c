@@ -0,0 +1,296 @@
+#include "inflate.h"
+
+#include <stdlib.h>
+
+/* Longest Huffman code and the history window of back-references */
+#define MAXBITS 15
+#define WINDOW 32768
+
+struct inflate_state {
+    const uint8_t *src;     /* compressed stream */
+    size_t len;
+    size_t pos;             /* next unread byte */
+    uint32_t bitbuf;        /* unread bits of src[pos-1], src[pos-2], ... */
+    int bitcnt;
+
+    uint8_t window[2*WINDOW]; /* ring buffer of the output */
+    uint64_t outpos;        /* total output bytes */
+    uint64_t flushed;       /* output bytes passed to out() */
+    inflate_output out;
+    void *ctx;
+};
+
+/* Canonical Huffman code (count of codes of each length, sorted symbols) */
+struct huffman {
+    short count[MAXBITS+1];
+    short symbol[288];
+};
+
+/* Next n bits of the stream (-1 if the input ends) */
+static int getbits(struct inflate_state *s, int n)
+{
+    int val;
+    while (s->bitcnt < n) {
+        if (s->pos == s->len)
+            return -1;
+        s->bitbuf |= (uint32_t)s->src[s->pos++] << s->bitcnt;
+        s->bitcnt += 8;
+    }
+    val = (int)(s->bitbuf & ((1UL << n) - 1));
+    s->bitbuf >>= n;
+    s->bitcnt -= n;
+    return val;
+}
+
+/* Pass the output not yet seen by out() */
+static void flush(struct inflate_state *s)
+{
+    while (s->flushed < s->outpos) {
+        size_t i = (size_t)(s->flushed % (2*WINDOW));
+        size_t n = (s->outpos - s->flushed < 2*WINDOW - i)
+                 ? (size_t)(s->outpos - s->flushed) : 2*WINDOW - i;
+        s->out(s->ctx, &s->window[i], n, INFLATE_DECODED);
+        s->flushed += n;
+    }
+}
+
+static void put(struct inflate_state *s, uint8_t byte)
+{
+    s->window[s->outpos++ % (2*WINDOW)] = byte;
+    if (s->outpos - s->flushed == WINDOW)
+        flush(s);
+}
+
+/* Uncompressed block (the stream is at a byte boundary after the header) */
+static int stored(struct inflate_state *s)
+{
+    size_t n;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    if (s->len - s->pos < 4)
+        return 0;
+    n = s->src[s->pos] | (size_t)s->src[s->pos+1] << 8;
+    if ((s->src[s->pos+2] ^ 0xFF) != (n & 0xFF)
+            || (s->src[s->pos+3] ^ 0xFF) != (n >> 8))
+        return 0;
+    s->pos += 4;
+    if (s->len - s->pos < n)
+        return 0;
+
+    flush(s);
+    s->out(s->ctx, &s->src[s->pos], n, s->pos);
+    while (n--)
+        s->window[s->outpos++ % (2*WINDOW)] = s->src[s->pos++];
+    s->flushed = s->outpos;
+    return 1;
+}
+
+/*
+ * Build a canonical Huffman code from code lengths. Returns zero for a
+ * complete code, a positive value for an incomplete one and a negative value
+ * for an over-subscribed (invalid) one.
+ */
+static int construct(struct huffman *h, const short *length, int n)
+{
+    int symbol, len, left;
+    short offs[MAXBITS+1];
+
+    for (len = 0; len <= MAXBITS; len++)
+        h->count[len] = 0;
+    for (symbol = 0; symbol < n; symbol++)
+        h->count[length[symbol]]++;
+    if (h->count[0] == n)
+        return 0;
+
+    for (left = 1, len = 1; len <= MAXBITS; len++) {
+        left = 2*left - h->count[len];
+        if (left < 0)
+            return left;
+    }
+    for (offs[1] = 0, len = 1; len < MAXBITS; len++)
+        offs[len+1] = offs[len] + h->count[len];
+    for (symbol = 0; symbol < n; symbol++) {
+        if (length[symbol])
+            h->symbol[offs[length[symbol]]++] = (short)symbol;
+    }
+    return left;
+}
+
+/* Decode a symbol bit by bit (-1 if invalid or the input ends) */
+static int decode(struct inflate_state *s, const struct huffman *h)
+{
+    int len, bit, code = 0, first = 0, index = 0;
+    for (len = 1; len <= MAXBITS; len++) {
+        if ((bit = getbits(s, 1)) < 0)
+            return -1;
+        code |= bit;
+        if (code - h->count[len] < first)
+            return h->symbol[index + (code - first)];
+        index += h->count[len];
+        first = (first + h->count[len]) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+/* Literals and back-references of a compressed block */
+static int codes(struct inflate_state *s, const struct huffman *lencode,
+                 const struct huffman *distcode)
+{
+    static const short lbase[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const short lext[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const short dbase[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+        8193, 12289, 16385, 24577 };
+    static const short dext[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    int symbol, len, dist, extra;
+
+    while ((symbol = decode(s, lencode)) != 256) {
+        if (symbol < 0)
+            return 0;
+        if (symbol < 256) {
+            put(s, (uint8_t)symbol);
+            continue;
+        }
+        if ((symbol -= 257) >= 29 || (extra = getbits(s, lext[symbol])) < 0)
+            return 0;
+        len = lbase[symbol] + extra;
+        if ((symbol = decode(s, distcode)) < 0 || symbol >= 30
+                || (extra = getbits(s, dext[symbol])) < 0)
+            return 0;
+        dist = dbase[symbol] + extra;
+        if ((uint64_t)dist > s->outpos)
+            return 0;
+        while (len--)
+            put(s, s->window[(s->outpos - dist) % (2*WINDOW)]);
+    }
+    return 1;
+}
+
+/* Block compressed with the fixed Huffman codes */
+static int fixed(struct inflate_state *s)
+{
+    int i;
+    short lengths[288];
+    struct huffman lencode, distcode;
+    for (i = 0; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    construct(&lencode, lengths, 288);
+    for (i = 0; i < 30; i++) lengths[i] = 5;
+    construct(&distcode, lengths, 30);
+    return codes(s, &lencode, &distcode);
+}
+
+/* Block compressed with Huffman codes described in its header */
+static int dynamic(struct inflate_state *s)
+{
+    static const short order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    int nlen, ndist, ncode, index, symbol, repeat, err, len = 0;
+    short lengths[320];
+    struct huffman lencode, distcode;
+
+    if ((nlen = getbits(s, 5)) < 0 || (ndist = getbits(s, 5)) < 0
+            || (ncode = getbits(s, 4)) < 0)
+        return 0;
+    nlen += 257;
+    ndist += 1;
+    ncode += 4;
+    if (nlen > 286 || ndist > 30)
+        return 0;
+
+    /* Code length code */
+    for (index = 0; index < 19; index++) {
+        if (index < ncode && (len = getbits(s, 3)) < 0)
+            return 0;
+        lengths[order[index]] = (short)(index < ncode ? len : 0);
+    }
+    if (construct(&lencode, lengths, 19) != 0)
+        return 0;
+
+    /* Literal/length and distance code lengths */
+    for (index = 0; index < nlen + ndist; ) {
+        if ((symbol = decode(s, &lencode)) < 0)
+            return 0;
+        if (symbol < 16) {
+            lengths[index++] = (short)symbol;
+            continue;
+        }
+        len = 0;
+        if (symbol == 16) {
+            if (!index || (repeat = getbits(s, 2)) < 0)
+                return 0;
+            len = lengths[index-1];
+            repeat += 3;
+        } else if (symbol == 17) {
+            if ((repeat = getbits(s, 3)) < 0)
+                return 0;
+            repeat += 3;
+        } else {
+            if ((repeat = getbits(s, 7)) < 0)
+                return 0;
+            repeat += 11;
+        }
+        if (index + repeat > nlen + ndist)
+            return 0;
+        while (repeat--)
+            lengths[index++] = (short)len;
+    }
+    if (!lengths[256])
+        return 0;
+
+    /* Incomplete codes are allowed only for a single code */
+    err = construct(&lencode, lengths, nlen);
+    if (err < 0 || (err > 0 && nlen - lencode.count[0] != 1))
+        return 0;
+    err = construct(&distcode, lengths + nlen, ndist);
+    if (err < 0 || (err > 0 && ndist - distcode.count[0] != 1))
+        return 0;
+    return codes(s, &lencode, &distcode);
+}
+
+int inflate_stream(const uint8_t *src, size_t len, size_t *used,
+                   inflate_output out, void *ctx)
+{
+    int last, type, ok;
+    struct inflate_state *s;
+    if (!(s = malloc(sizeof(struct inflate_state))))
+        return 0;
+    s->src = src;
+    s->len = len;
+    s->pos = 0;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+    s->outpos = s->flushed = 0;
+    s->out = out;
+    s->ctx = ctx;
+
+    do {
+        if ((last = getbits(s, 1)) < 0 || (type = getbits(s, 2)) < 0)
+            ok = 0;
+        else if (type == 0)
+            ok = stored(s);
+        else if (type == 1)
+            ok = fixed(s);
+        else if (type == 2)
+            ok = dynamic(s);
+        else
+            ok = 0;
+    } while (ok && !last);
+
+    if (ok) {
+        flush(s);
+        *used = s->pos;
+    }
+    free(s);
+    return ok;
+}
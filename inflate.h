@@ -0,0 +1,32 @@
+/*
+ * Minimal DEFLATE (RFC 1951) decoder for checksumming compressed data.
+ */
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Offset passed to inflate_output for bytes decoded from Huffman codes */
+#define INFLATE_DECODED SIZE_MAX
+
+/*
+ * Receiver of the decompressed data in order. Bytes copied verbatim from a
+ * stored block are passed with their offset `src` in the compressed stream;
+ * other bytes have src = INFLATE_DECODED.
+ */
+typedef void (*inflate_output)(void *ctx, const uint8_t *bytes, size_t n,
+                               size_t src);
+
+/*
+ * Decompress the DEFLATE stream at the beginning of src[0..len-1].
+ *
+ * The output is passed to `out` in chunks and not kept (apart from the 32 KiB
+ * history window), so memory use is constant. The number of bytes consumed by
+ * the stream is stored in *used. Returns zero if the stream is invalid or
+ * truncated, or if out of memory.
+ */
+int inflate_stream(const uint8_t *src, size_t len, size_t *used,
+                   inflate_output out, void *ctx);
+
+#endif
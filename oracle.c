@@ -0,0 +1,576 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define ORACLE_POSIX
+#endif
+#include "oracle.h"
+#include "fileio.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ORACLE_POSIX
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* Files per invocation of a batching oracle, total size of the probe files */
+#define ORACLE_BATCH 32
+#define ORACLE_SPACE ((uintmax_t)256 << 20)
+
+#ifdef ORACLE_POSIX
+/* New probe file in $TMPDIR (or /tmp) */
+static FILE *probe_file(char **path)
+{
+    int fd;
+    FILE *file;
+    const char *dir = getenv("TMPDIR");
+    size_t size;
+    if (!dir || !*dir)
+        dir = "/tmp";
+    size = strlen(dir) + sizeof("/crchack-XXXXXX");
+    if (!(*path = malloc(size)))
+        return NULL;
+    snprintf(*path, size, "%s/crchack-XXXXXX", dir);
+    if ((fd = mkstemp(*path)) < 0) {
+        free(*path);
+        *path = NULL;
+        return NULL;
+    }
+    if (!(file = fdopen(fd, "w+b"))) {
+        close(fd);
+        remove(*path);
+        free(*path);
+        *path = NULL;
+    }
+    return file;
+}
+
+/* Flip a bit of a probe file */
+static int flip(FILE *file, bitsize_t bit)
+{
+    int c;
+    if (fileio_seek(file, bit / 8) != 0 || (c = fgetc(file)) == EOF)
+        return 0;
+    if (fileio_seek(file, bit / 8) != 0
+            || fputc(c ^ (1 << (bit % 8)), file) == EOF)
+        return 0;
+    return fflush(file) == 0;
+}
+
+/*
+ * Append `path` to the command at `dst` as a single-quoted shell word (each '
+ * becomes '\''). Returns the end of the command.
+ */
+static char *quote_path(char *dst, const char *path)
+{
+    *dst++ = ' ';
+    *dst++ = '\'';
+    for (; *path; path++) {
+        if (*path == '\'') {
+            memcpy(dst, "'\\''", 4);
+            dst += 4;
+        } else {
+            *dst++ = *path;
+        }
+    }
+    *dst++ = '\'';
+    *dst = '\0';
+    return dst;
+}
+
+/*
+ * Run the command on paths[0..n-1] and parse the checksums into out[].
+ * Returns the number of checksums printed, or -1 if the command failed or
+ * printed something other than checksums.
+ */
+static int run(const struct oracle *oracle, char *const paths[], size_t n,
+               struct bigint out[])
+{
+    FILE *pipe;
+    char *cmd, *end, line[4096];
+    const char *p;
+    size_t i, size = strlen(oracle->command) + 1;
+    int k = 0;
+
+    for (i = 0; i < n; i++) {
+        size += strlen(paths[i]) + 3;
+        for (p = paths[i]; (p = strchr(p, '\'')); p++)
+            size += 3;
+    }
+    if (!(cmd = malloc(size)))
+        return -1;
+    end = cmd + strlen(strcpy(cmd, oracle->command));
+    for (i = 0; i < n; i++)
+        end = quote_path(end, paths[i]);
+    fflush(NULL);
+    pipe = popen(cmd, "r");
+    free(cmd);
+    if (!pipe)
+        return -1;
+
+    while (fgets(line, sizeof(line), pipe)) {
+        char *p = line;
+        size_t len = strlen(line);
+        while (len && strchr(" \t\r\n", line[len-1]))
+            line[--len] = '\0';
+        p += strspn(p, " \t");
+        if (k < 0 || (size_t)k == n || !bigint_from_string(&out[k], p))
+            k = -1;
+        else
+            k++;
+    }
+    return (pclose(pipe) == 0) ? k : -1;
+}
+
+/* Work shared by the probe threads */
+struct probe_work {
+    struct oracle *oracle;
+    const bitsize_t *bits;
+    size_t n;
+    size_t next;            /* next bit to probe */
+    size_t per;             /* bits per invocation */
+    const struct bigint *base;
+    struct bigint *cols;
+    const char *error;
+    pthread_mutex_t lock;
+};
+
+struct probe_worker {
+    struct probe_work *work;
+    size_t first;           /* first probe file of the worker */
+    uintmax_t invocations;
+    pthread_t thread;
+};
+
+static void *probe(void *arg)
+{
+    struct probe_worker *worker = arg;
+    struct probe_work *work = worker->work;
+    struct oracle *oracle = work->oracle;
+    FILE **files = &oracle->files[worker->first];
+    const char *error;
+    size_t i, k, m;
+
+    for (;;) {
+        pthread_mutex_lock(&work->lock);
+        i = work->next;
+        m = (work->n - i < work->per) ? work->n - i : work->per;
+        work->next += m;
+        error = work->error;
+        pthread_mutex_unlock(&work->lock);
+        if (!m || error)
+            break;
+
+        for (k = 0; k < m && flip(files[k], work->bits[i+k]); k++);
+        if (k < m) {
+            error = "error writing oracle probe file";
+        } else if (run(oracle, &oracle->paths[worker->first], m,
+                       &work->cols[i]) != (int)m) {
+            error = "oracle command failed or printed too few checksums";
+        }
+        worker->invocations++;
+        while (k-- > 0) {
+            if (!flip(files[k], work->bits[i+k]))
+                error = "error writing oracle probe file";
+        }
+        for (k = 0; k < m; k++)
+            bigint_xor(&work->cols[i+k], work->base);
+        if (error) {
+            pthread_mutex_lock(&work->lock);
+            work->error = error;
+            pthread_mutex_unlock(&work->lock);
+            break;
+        }
+    }
+    return NULL;
+}
+#endif
+
+const char *oracle_open(struct oracle *oracle, const char *command,
+                        bitsize_t width, FILE *in, uintmax_t size, size_t pad,
+                        unsigned threads)
+{
+#ifdef ORACLE_POSIX
+    size_t i, n;
+    uintmax_t total = size + pad;
+    static const char zeros[256];
+
+    memset(oracle, 0, sizeof(*oracle));
+    oracle->command = command;
+    oracle->width = width;
+    oracle->batch = 1;
+    oracle->threads = threads ? threads : 1;
+
+    /* At least one copy of the message */
+    n = oracle->threads * ORACLE_BATCH;
+    if (total && ORACLE_SPACE / total < n)
+        n = (ORACLE_SPACE / total) ? (size_t)(ORACLE_SPACE / total) : 1;
+    oracle->paths = calloc(n, sizeof(char *));
+    oracle->files = calloc(n, sizeof(FILE *));
+    if (!oracle->paths || !oracle->files)
+        return "out of memory";
+
+    for (i = 0; i < n; i++) {
+        uintmax_t left;
+        if (!(oracle->files[i] = probe_file(&oracle->paths[i])))
+            return "error creating oracle probe file";
+        oracle->nfiles++;
+        if (i) {
+            rewind(oracle->files[0]);
+            if (fileio_copy(oracle->files[0], oracle->files[i], total)
+                    != total)
+                return "error copying oracle probe file";
+        } else if (fileio_copy(in, oracle->files[0], size) != size) {
+            return "error copying message to oracle probe file";
+        } else {
+            for (left = pad; left > 0; ) {
+                size_t k = left < sizeof(zeros) ? (size_t)left : sizeof(zeros);
+                if (fwrite(zeros, 1, k, oracle->files[0]) != k)
+                    return "error copying message to oracle probe file";
+                left -= k;
+            }
+        }
+        if (fflush(oracle->files[i]) != 0)
+            return "error writing oracle probe file";
+    }
+    return NULL;
+#else
+    (void)command; (void)width; (void)in; (void)size; (void)pad;
+    (void)threads;
+    memset(oracle, 0, sizeof(*oracle));
+    return "checksum oracles need a POSIX system";
+#endif
+}
+
+const char *oracle_checksum(struct oracle *oracle, struct bigint *checksum)
+{
+#ifdef ORACLE_POSIX
+    struct bigint *two;
+    int ret;
+
+    /* Two copies of the message checksum equally if batching works */
+    if (oracle->nfiles >= 2) {
+        if (!(two = bigint_array_new(2, oracle->width)))
+            return "out of memory";
+        ret = run(oracle, oracle->paths, 2, two);
+        oracle->invocations++;
+        if (ret == 2 && !memcmp(two[0].limb, two[1].limb,
+                                bigint_limbs(&two[0]) * sizeof(limb_t))) {
+            oracle->batch = ORACLE_BATCH;
+            bigint_mov(checksum, &two[0]);
+            bigint_array_delete(two);
+            return NULL;
+        }
+        bigint_array_delete(two);
+    }
+    oracle->batch = 1;
+    oracle->invocations++;
+    if (run(oracle, oracle->paths, 1, checksum) != 1)
+        return "oracle command failed or did not print a checksum";
+    return NULL;
+#else
+    (void)oracle; (void)checksum;
+    return "checksum oracles need a POSIX system";
+#endif
+}
+
+const char *oracle_columns(struct oracle *oracle, const bitsize_t bits[],
+                           size_t n, const struct bigint *base,
+                           struct bigint cols[])
+{
+#ifdef ORACLE_POSIX
+    struct probe_work work;
+    struct probe_worker *workers;
+    size_t t, nworkers;
+
+    if (!n)
+        return NULL;
+    memset(&work, 0, sizeof(work));
+    work.oracle = oracle;
+    work.bits = bits;
+    work.n = n;
+    work.base = base;
+    work.cols = cols;
+
+    /* Spread the bits over the workers and their probe files */
+    work.per = (n + oracle->threads - 1) / oracle->threads;
+    if (work.per > oracle->batch)
+        work.per = oracle->batch;
+    if (work.per > oracle->nfiles)
+        work.per = oracle->nfiles;
+    nworkers = oracle->nfiles / work.per;
+    if (nworkers > oracle->threads)
+        nworkers = oracle->threads;
+    if (!(workers = calloc(nworkers, sizeof(struct probe_worker))))
+        return "out of memory";
+    if (pthread_mutex_init(&work.lock, NULL)) {
+        free(workers);
+        return "out of memory";
+    }
+
+    for (t = 0; t < nworkers; t++) {
+        workers[t].work = &work;
+        workers[t].first = t * work.per;
+    }
+    for (t = 1; t < nworkers; t++) {
+        if (pthread_create(&workers[t].thread, NULL, probe, &workers[t]))
+            break;
+    }
+    probe(&workers[0]);
+    while (--t > 0)
+        pthread_join(workers[t].thread, NULL);
+    for (t = 0; t < nworkers; t++)
+        oracle->invocations += workers[t].invocations;
+
+    pthread_mutex_destroy(&work.lock);
+    free(workers);
+    return work.error;
+#else
+    (void)oracle; (void)bits; (void)n; (void)base; (void)cols;
+    return "checksum oracles need a POSIX system";
+#endif
+}
+
+const char *oracle_flipped(struct oracle *oracle, const bitsize_t bits[],
+                           size_t n, struct bigint *checksum)
+{
+#ifdef ORACLE_POSIX
+    size_t k;
+    const char *error = NULL;
+    for (k = 0; k < n && flip(oracle->files[0], bits[k]); k++);
+    if (k < n) {
+        error = "error writing oracle probe file";
+    } else if (run(oracle, oracle->paths, 1, checksum) != 1) {
+        error = "oracle command failed or did not print a checksum";
+    }
+    oracle->invocations++;
+    while (k-- > 0) {
+        if (!flip(oracle->files[0], bits[k]))
+            error = "error writing oracle probe file";
+    }
+    return error;
+#else
+    (void)oracle; (void)bits; (void)n; (void)checksum;
+    return "checksum oracles need a POSIX system";
+#endif
+}
+
+void oracle_close(struct oracle *oracle)
+{
+    size_t i;
+    for (i = 0; i < oracle->nfiles; i++) {
+        fclose(oracle->files[i]);
+        remove(oracle->paths[i]);
+        free(oracle->paths[i]);
+    }
+    free(oracle->paths);
+    free(oracle->files);
+    oracle->paths = NULL;
+    oracle->files = NULL;
+    oracle->nfiles = 0;
+}
+
+const char *oracle_cache(void)
+{
+    int n;
+    const char *dir;
+    static char path[4096];
+    if ((dir = getenv("XDG_CACHE_HOME")) && *dir) {
+        n = snprintf(path, sizeof(path), "%s/crchack.oracle", dir);
+    } else if ((dir = getenv("HOME")) && *dir) {
+        n = snprintf(path, sizeof(path), "%s/.cache/crchack.oracle", dir);
+    } else {
+        return NULL;
+    }
+    return (n > 0 && (size_t)n < sizeof(path)) ? path : NULL;
+}
+
+/* Cache key "len width command" (NULL if the command cannot be a key) */
+static char *cache_key(const struct oracle *oracle, uintmax_t len)
+{
+    char *key;
+    size_t size = strlen(oracle->command) + 64;
+    if (strpbrk(oracle->command, "\t\n") || !(key = malloc(size)))
+        return NULL;
+    snprintf(key, size, "%ju %ju %s", len, oracle->width, oracle->command);
+    return key;
+}
+
+/* Line of a key in the cache file buffer (NULL if not found) */
+static const char *cache_entry(const char *buf, size_t size, const char *key,
+                               size_t *len)
+{
+    const size_t n = strlen(key);
+    const char *line = buf, *end = buf + size;
+    while (line < end) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol)
+            eol = end;
+        if ((size_t)(eol - line) > n && line[n] == '\t'
+                && !memcmp(line, key, n)) {
+            *len = (size_t)(eol - line) + (eol < end);
+            return line;
+        }
+        line = eol + (eol < end);
+    }
+    return NULL;
+}
+
+/* Index of position p in the sorted array pos[0..n-1] (n if not found) */
+static size_t find(const bitsize_t pos[], size_t n, bitsize_t p)
+{
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pos[mid] < p) lo = mid + 1; else hi = mid;
+    }
+    return (lo < n && pos[lo] == p) ? lo : n;
+}
+
+/*
+ * Visit the "pos:hex" columns of a cache entry (tokens are at most 255
+ * characters). The callback gets the token and its parsed position.
+ */
+static void cache_columns(const char *entry, size_t len,
+                          void (*visit)(void *ctx, const char *token,
+                                        bitsize_t pos),
+                          void *ctx)
+{
+    char token[256], *end;
+    const char *p = memchr(entry, '\t', len), *stop = entry + len;
+    while (p && p < stop) {
+        size_t n;
+        p += strspn(p, " \t");
+        if (p >= stop || *p == '\n')
+            break;
+        n = strcspn(p, " \n");
+        if (n < sizeof(token) && p + n <= stop) {
+            bitsize_t pos;
+            memcpy(token, p, n);
+            token[n] = '\0';
+            pos = (bitsize_t)strtoull(token, &end, 10);
+            if (*end == ':')
+                visit(ctx, token, pos);
+        }
+        p += n;
+    }
+}
+
+struct cache_lookup {
+    const bitsize_t *pos;
+    size_t n;
+    struct bigint *cols;
+    unsigned char *known;
+    size_t found;
+};
+
+static void lookup_column(void *ctx, const char *token, bitsize_t pos)
+{
+    struct cache_lookup *lookup = ctx;
+    size_t i = find(lookup->pos, lookup->n, pos);
+    if (i < lookup->n && !lookup->known[i]
+            && bigint_from_string(&lookup->cols[i], strchr(token, ':') + 1)) {
+        lookup->known[i] = 1;
+        lookup->found++;
+    }
+}
+
+size_t oracle_cache_load(const char *cache, const struct oracle *oracle,
+                         uintmax_t len, const bitsize_t pos[], size_t n,
+                         struct bigint cols[], unsigned char known[])
+{
+    char *buf, *key;
+    const char *entry;
+    size_t size, entry_len;
+    struct cache_lookup lookup;
+
+    lookup.pos = pos;
+    lookup.n = n;
+    lookup.cols = cols;
+    lookup.known = known;
+    lookup.found = 0;
+    if (!cache || !(key = cache_key(oracle, len)))
+        return 0;
+    if ((buf = fileio_load(cache, &size))) {
+        if ((entry = cache_entry(buf, size, key, &entry_len)))
+            cache_columns(entry, entry_len, lookup_column, &lookup);
+        free(buf);
+    }
+    free(key);
+    return lookup.found;
+}
+
+struct cache_merge {
+    FILE *out;
+    const bitsize_t *pos;
+    size_t n;
+};
+
+/* Keep an old column that is not replaced */
+static void keep_column(void *ctx, const char *token, bitsize_t pos)
+{
+    struct cache_merge *merge = ctx;
+    if (find(merge->pos, merge->n, pos) == merge->n)
+        fprintf(merge->out, " %s", token);
+}
+
+/* Rewrite the cache with the entry of a key replaced (or removed if !cols) */
+static void cache_rewrite(const char *cache, const struct oracle *oracle,
+                          uintmax_t len, const bitsize_t pos[], size_t n,
+                          const struct bigint cols[])
+{
+    FILE *out;
+    size_t i, entry_len, size = 0;
+    const char *entry = NULL;
+    char *buf, *key;
+    struct cache_merge merge;
+    struct fileio_replace replace;
+
+    if (!cache || !(key = cache_key(oracle, len)))
+        return;
+    if ((buf = fileio_load(cache, &size)))
+        entry = cache_entry(buf, size, key, &entry_len);
+    if ((!entry && !cols) || !(out = fileio_replace_open(&replace, cache))) {
+        free(buf);
+        free(key);
+        return;
+    }
+    if (entry) {
+        fwrite(buf, sizeof(char), (size_t)(entry - buf), out);
+        fwrite(entry + entry_len, sizeof(char),
+               size - (size_t)(entry - buf) - entry_len, out);
+    } else if (buf) {
+        fwrite(buf, sizeof(char), size, out);
+    }
+
+    if (cols) {
+        fprintf(out, "%s\t", key);
+        for (i = 0; i < n; i++) {
+            fprintf(out, &" %ju:"[!i], pos[i]);
+            bigint_fprint(out, &cols[i]);
+        }
+        if (entry) {
+            merge.out = out;
+            merge.pos = pos;
+            merge.n = n;
+            cache_columns(entry, entry_len, keep_column, &merge);
+        }
+        fputc('\n', out);
+    }
+    fileio_replace_commit(&replace);
+    free(buf);
+    free(key);
+}
+
+void oracle_cache_store(const char *cache, const struct oracle *oracle,
+                        uintmax_t len, const bitsize_t pos[], size_t n,
+                        const struct bigint cols[])
+{
+    cache_rewrite(cache, oracle, len, pos, n, cols);
+}
+
+void oracle_cache_drop(const char *cache, const struct oracle *oracle,
+                       uintmax_t len)
+{
+    cache_rewrite(cache, oracle, len, NULL, 0, NULL);
+}
@@ -0,0 +1,98 @@
+/*
+ * Black-box checksum oracles (external programs) for forging.
+ */
+#ifndef ORACLE_H
+#define ORACLE_H
+
+#include "bigint.h"
+
+#include <stdio.h>
+
+/*
+ * Oracle command and its probe files.
+ *
+ * The command is run by the shell with the names of one or more message files
+ * appended, and it prints the hexadecimal checksum of each file on its own
+ * line. Each probe file is a copy of the message; a probe flips one bit of a
+ * file, runs the command and flips the bit back.
+ */
+struct oracle {
+    const char *command;
+    bitsize_t width;
+    size_t batch;           /* files per invocation (1 if not supported) */
+    unsigned threads;       /* parallel invocations */
+    uintmax_t invocations;  /* number of commands run */
+
+    char **paths;           /* probe files */
+    FILE **files;
+    size_t nfiles;
+};
+
+/*
+ * Copy the message (size bytes of `in` followed by pad zero bytes) to probe
+ * files for up to `threads` parallel invocations. The copies are limited to
+ * 256 MiB in total. Returns NULL on success or a description of the error;
+ * the oracle must be released with oracle_close() in both cases.
+ */
+const char *oracle_open(struct oracle *oracle, const char *command,
+                        bitsize_t width, FILE *in, uintmax_t size, size_t pad,
+                        unsigned threads);
+
+/*
+ * Checksum of the unmodified message. Also finds out whether the command
+ * accepts several files at once. Returns NULL or a description of the error.
+ */
+const char *oracle_checksum(struct oracle *oracle, struct bigint *checksum);
+
+/*
+ * Difference columns of bits[0..n-1]: cols[i] is the checksum of the message
+ * with bit bits[i] flipped XOR `base` (the checksum of the message). The
+ * probes are batched and run in parallel. Returns NULL or an error.
+ */
+const char *oracle_columns(struct oracle *oracle, const bitsize_t bits[],
+                           size_t n, const struct bigint *base,
+                           struct bigint cols[]);
+
+/*
+ * Checksum of the message with bits[0..n-1] flipped, computed by a single
+ * invocation on a probe file (the bits are flipped back afterwards). Returns
+ * NULL or a description of the error.
+ */
+const char *oracle_flipped(struct oracle *oracle, const bitsize_t bits[],
+                           size_t n, struct bigint *checksum);
+
+/* Remove the probe files */
+void oracle_close(struct oracle *oracle);
+
+/*
+ * Default cache file of learned columns ($XDG_CACHE_HOME/crchack.oracle or
+ * ~/.cache/crchack.oracle, NULL if neither variable is set).
+ */
+const char *oracle_cache(void);
+
+/*
+ * Look up the columns of the sorted bits pos[0..n-1] of a len-byte message
+ * from the cache. Columns depend only on the command, width and message
+ * length. Sets known[i] for each column found and returns their number.
+ */
+size_t oracle_cache_load(const char *cache, const struct oracle *oracle,
+                         uintmax_t len, const bitsize_t pos[], size_t n,
+                         struct bigint cols[], unsigned char known[]);
+
+/*
+ * Add the columns of pos[0..n-1] to the cache (errors are ignored). The cache
+ * is rewritten through a temporary file renamed over it, so concurrent runs
+ * never see a partially written cache.
+ */
+void oracle_cache_store(const char *cache, const struct oracle *oracle,
+                        uintmax_t len, const bitsize_t pos[], size_t n,
+                        const struct bigint cols[]);
+
+/*
+ * Remove the columns of a len-byte message from the cache (for example, when
+ * they turn out to be stale because the command has changed).
+ */
+void oracle_cache_drop(const char *cache, const struct oracle *oracle,
+                       uintmax_t len);
+
+#endif
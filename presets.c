@@ -0,0 +1,196 @@
+#include "presets.h"
+
+#include <ctype.h>
+
+/*
+ * https://reveng.sourceforge.io/crc-catalogue/ (see also check.sh)
+ */
+const struct crc_preset crc_presets[] = {
+    { "CRC-3/GSM", 3, "3", "0", "7", 0, 0, "4" },
+    { "CRC-3/ROHC", 3, "3", "7", "0", 1, 1, "6" },
+    { "CRC-4/G-704", 4, "3", "0", "0", 1, 1, "7" },
+    { "CRC-4/INTERLAKEN", 4, "3", "f", "f", 0, 0, "b" },
+    { "CRC-5/EPC-C1G2", 5, "09", "09", "0", 0, 0, "00" },
+    { "CRC-5/G-704", 5, "15", "0", "0", 1, 1, "07" },
+    { "CRC-5/USB", 5, "05", "1f", "1f", 1, 1, "19" },
+    { "CRC-6/CDMA2000-A", 6, "27", "3f", "0", 0, 0, "0d" },
+    { "CRC-6/CDMA2000-B", 6, "07", "3f", "0", 0, 0, "3b" },
+    { "CRC-6/DARC", 6, "19", "0", "0", 1, 1, "26" },
+    { "CRC-6/G-704", 6, "03", "0", "0", 1, 1, "06" },
+    { "CRC-6/GSM", 6, "2f", "0", "3f", 0, 0, "13" },
+    { "CRC-7/MMC", 7, "09", "0", "0", 0, 0, "75" },
+    { "CRC-7/ROHC", 7, "4f", "7f", "0", 1, 1, "53" },
+    { "CRC-7/UMTS", 7, "45", "0", "0", 0, 0, "61" },
+    { "CRC-8/AUTOSAR", 8, "2f", "ff", "ff", 0, 0, "df" },
+    { "CRC-8/BLUETOOTH", 8, "a7", "0", "0", 1, 1, "26" },
+    { "CRC-8/CDMA2000", 8, "9b", "ff", "0", 0, 0, "da" },
+    { "CRC-8/DARC", 8, "39", "0", "0", 1, 1, "15" },
+    { "CRC-8/DVB-S2", 8, "d5", "0", "0", 0, 0, "bc" },
+    { "CRC-8/GSM-A", 8, "1d", "0", "0", 0, 0, "37" },
+    { "CRC-8/GSM-B", 8, "49", "0", "ff", 0, 0, "94" },
+    { "CRC-8/HITAG", 8, "1d", "ff", "0", 0, 0, "b4" },
+    { "CRC-8/I-432-1", 8, "07", "0", "55", 0, 0, "a1" },
+    { "CRC-8/I-CODE", 8, "1d", "fd", "0", 0, 0, "7e" },
+    { "CRC-8/LTE", 8, "9b", "0", "0", 0, 0, "ea" },
+    { "CRC-8/MAXIM-DOW", 8, "31", "0", "0", 1, 1, "a1" },
+    { "CRC-8/MIFARE-MAD", 8, "1d", "c7", "0", 0, 0, "99" },
+    { "CRC-8/NRSC-5", 8, "31", "ff", "0", 0, 0, "f7" },
+    { "CRC-8/OPENSAFETY", 8, "2f", "0", "0", 0, 0, "3e" },
+    { "CRC-8/ROHC", 8, "07", "ff", "0", 1, 1, "d0" },
+    { "CRC-8/SAE-J1850", 8, "1d", "ff", "ff", 0, 0, "4b" },
+    { "CRC-8/SMBUS", 8, "07", "0", "0", 0, 0, "f4" },
+    { "CRC-8/TECH-3250", 8, "1d", "ff", "0", 1, 1, "97" },
+    { "CRC-8/WCDMA", 8, "9b", "0", "0", 1, 1, "25" },
+    { "CRC-10/ATM", 10, "233", "0", "0", 0, 0, "199" },
+    { "CRC-10/CDMA2000", 10, "3d9", "3ff", "0", 0, 0, "233" },
+    { "CRC-10/GSM", 10, "175", "0", "3ff", 0, 0, "12a" },
+    { "CRC-11/FLEXRAY", 11, "385", "01a", "0", 0, 0, "5a3" },
+    { "CRC-11/UMTS", 11, "307", "0", "0", 0, 0, "061" },
+    { "CRC-12/CDMA2000", 12, "f13", "fff", "0", 0, 0, "d4d" },
+    { "CRC-12/DECT", 12, "80f", "0", "0", 0, 0, "f5b" },
+    { "CRC-12/GSM", 12, "d31", "0", "fff", 0, 0, "b34" },
+    { "CRC-12/UMTS", 12, "80f", "0", "0", 0, 1, "daf" },
+    { "CRC-13/BBC", 13, "1cf5", "0", "0", 0, 0, "04fa" },
+    { "CRC-14/DARC", 14, "0805", "0", "0", 1, 1, "082d" },
+    { "CRC-14/GSM", 14, "202d", "0", "3fff", 0, 0, "30ae" },
+    { "CRC-15/CAN", 15, "4599", "0", "0", 0, 0, "059e" },
+    { "CRC-15/MPT1327", 15, "6815", "0", "0001", 0, 0, "2566" },
+    { "CRC-16/ARC", 16, "8005", "0", "0", 1, 1, "bb3d" },
+    { "CRC-16/CDMA2000", 16, "c867", "ffff", "0", 0, 0, "4c06" },
+    { "CRC-16/CMS", 16, "8005", "ffff", "0", 0, 0, "aee7" },
+    { "CRC-16/DDS-110", 16, "8005", "800d", "0", 0, 0, "9ecf" },
+    { "CRC-16/DECT-R", 16, "0589", "0", "0001", 0, 0, "007e" },
+    { "CRC-16/DECT-X", 16, "0589", "0", "0", 0, 0, "007f" },
+    { "CRC-16/DNP", 16, "3d65", "0", "ffff", 1, 1, "ea82" },
+    { "CRC-16/EN-13757", 16, "3d65", "0", "ffff", 0, 0, "c2b7" },
+    { "CRC-16/GENIBUS", 16, "1021", "ffff", "ffff", 0, 0, "d64e" },
+    { "CRC-16/GSM", 16, "1021", "0", "ffff", 0, 0, "ce3c" },
+    { "CRC-16/IBM-3740", 16, "1021", "ffff", "0", 0, 0, "29b1" },
+    { "CRC-16/IBM-SDLC", 16, "1021", "ffff", "ffff", 1, 1, "906e" },
+    { "CRC-16/ISO-IEC-14443-3-A", 16, "1021", "c6c6", "0", 1, 1, "bf05" },
+    { "CRC-16/KERMIT", 16, "1021", "0", "0", 1, 1, "2189" },
+    { "CRC-16/LJ1200", 16, "6f63", "0", "0", 0, 0, "bdf4" },
+    { "CRC-16/M17", 16, "5935", "ffff", "0", 0, 0, "772b" },
+    { "CRC-16/MAXIM-DOW", 16, "8005", "0", "ffff", 1, 1, "44c2" },
+    { "CRC-16/MCRF4XX", 16, "1021", "ffff", "0", 1, 1, "6f91" },
+    { "CRC-16/MODBUS", 16, "8005", "ffff", "0", 1, 1, "4b37" },
+    { "CRC-16/NRSC-5", 16, "080b", "ffff", "0", 1, 1, "a066" },
+    { "CRC-16/OPENSAFETY-A", 16, "5935", "0", "0", 0, 0, "5d38" },
+    { "CRC-16/OPENSAFETY-B", 16, "755b", "0", "0", 0, 0, "20fe" },
+    { "CRC-16/PROFIBUS", 16, "1dcf", "ffff", "ffff", 0, 0, "a819" },
+    { "CRC-16/RIELLO", 16, "1021", "b2aa", "0", 1, 1, "63d0" },
+    { "CRC-16/SPI-FUJITSU", 16, "1021", "1d0f", "0", 0, 0, "e5cc" },
+    { "CRC-16/T10-DIF", 16, "8bb7", "0", "0", 0, 0, "d0db" },
+    { "CRC-16/TELEDISK", 16, "a097", "0", "0", 0, 0, "0fb3" },
+    { "CRC-16/TMS37157", 16, "1021", "89ec", "0", 1, 1, "26b1" },
+    { "CRC-16/UMTS", 16, "8005", "0", "0", 0, 0, "fee8" },
+    { "CRC-16/USB", 16, "8005", "ffff", "ffff", 1, 1, "b4c8" },
+    { "CRC-16/XMODEM", 16, "1021", "0", "0", 0, 0, "31c3" },
+    { "CRC-17/CAN-FD", 17, "1685b", "0", "0", 0, 0, "04f03" },
+    { "CRC-21/CAN-FD", 21, "102899", "0", "0", 0, 0, "0ed841" },
+    { "CRC-24/BLE", 24, "00065b", "555555", "0", 1, 1, "c25a56" },
+    { "CRC-24/FLEXRAY-A", 24, "5d6dcb", "fedcba", "0", 0, 0, "7979bd" },
+    { "CRC-24/FLEXRAY-B", 24, "5d6dcb", "abcdef", "0", 0, 0, "1f23b8" },
+    { "CRC-24/INTERLAKEN", 24, "328b63", "ffffff", "ffffff", 0, 0, "b4f3e6" },
+    { "CRC-24/LTE-A", 24, "864cfb", "0", "0", 0, 0, "cde703" },
+    { "CRC-24/LTE-B", 24, "800063", "0", "0", 0, 0, "23ef52" },
+    { "CRC-24/OPENPGP", 24, "864cfb", "b704ce", "0", 0, 0, "21cf02" },
+    { "CRC-24/OS-9", 24, "800063", "ffffff", "ffffff", 0, 0, "200fa5" },
+    { "CRC-30/CDMA", 30, "2030b9c7", "3fffffff", "3fffffff", 0, 0, "04c34abf" },
+    { "CRC-31/PHILIPS", 31, "04c11db7", "7fffffff", "7fffffff", 0, 0, "0ce9e46c" },
+    { "CRC-32/AIXM", 32, "814141ab", "0", "0", 0, 0, "3010bf7f" },
+    { "CRC-32/AUTOSAR", 32, "f4acfb13", "ffffffff", "ffffffff", 1, 1, "1697d06a" },
+    { "CRC-32/BASE91-D", 32, "a833982b", "ffffffff", "ffffffff", 1, 1, "87315576" },
+    { "CRC-32/BZIP2", 32, "04c11db7", "ffffffff", "ffffffff", 0, 0, "fc891918" },
+    { "CRC-32/CD-ROM-EDC", 32, "8001801b", "0", "0", 1, 1, "6ec2edc4" },
+    { "CRC-32/CKSUM", 32, "04c11db7", "0", "ffffffff", 0, 0, "765e7680" },
+    { "CRC-32/ISCSI", 32, "1edc6f41", "ffffffff", "ffffffff", 1, 1, "e3069283" },
+    { "CRC-32/ISO-HDLC", 32, "04c11db7", "ffffffff", "ffffffff", 1, 1, "cbf43926" },
+    { "CRC-32/JAMCRC", 32, "04c11db7", "ffffffff", "0", 1, 1, "340bc6d9" },
+    { "CRC-32/MEF", 32, "741b8cd7", "ffffffff", "0", 1, 1, "d2c22f51" },
+    { "CRC-32/MPEG-2", 32, "04c11db7", "ffffffff", "0", 0, 0, "0376e6e7" },
+    { "CRC-32/XFER", 32, "000000af", "0", "0", 0, 0, "bd0be338" },
+    { "CRC-40/GSM", 40, "0004820009", "0", "ffffffffff", 0, 0, "d4164fc646" },
+    { "CRC-64/ECMA-182", 64, "42f0e1eba9ea3693", "0", "0", 0, 0, "6c40df5f0b497347" },
+    { "CRC-64/GO-ISO", 64, "000000000000001b", "ffffffffffffffff", "ffffffffffffffff", 1, 1, "b90956c775a41001" },
+    { "CRC-64/MS", 64, "259c84cba6426349", "ffffffffffffffff", "0", 1, 1, "75d4b74f024eceea" },
+    { "CRC-64/REDIS", 64, "ad93d23594c935a9", "0", "0", 1, 1, "e9c6d914c4b8d9ca" },
+    { "CRC-64/WE", 64, "42f0e1eba9ea3693", "ffffffffffffffff", "ffffffffffffffff", 0, 0, "62ec59e3f1a4f00a" },
+    { "CRC-64/XZ", 64, "42f0e1eba9ea3693", "ffffffffffffffff", "ffffffffffffffff", 1, 1, "995dc9bbdf1939fa" },
+    { "CRC-82/DARC", 82, "0308c0111011401440411", "0", "0", 1, 1, "09ea83f625023801fd612" },
+    { NULL, 0, NULL, NULL, NULL, 0, 0, NULL }
+};
+
+/* Common aliases of the catalogue entries */
+static const struct {
+    const char *alias;
+    const char *name;
+} aliases[] = {
+    { "CRC-8", "CRC-8/SMBUS" },
+    { "CRC-8/MAXIM", "CRC-8/MAXIM-DOW" },
+    { "DOW-CRC", "CRC-8/MAXIM-DOW" },
+    { "CRC-16", "CRC-16/ARC" },
+    { "ARC", "CRC-16/ARC" },
+    { "CRC-IBM", "CRC-16/ARC" },
+    { "CRC-16/LHA", "CRC-16/ARC" },
+    { "CRC-16/CCITT-FALSE", "CRC-16/IBM-3740" },
+    { "CRC-16/AUTOSAR", "CRC-16/IBM-3740" },
+    { "CRC-16/X-25", "CRC-16/IBM-SDLC" },
+    { "X-25", "CRC-16/IBM-SDLC" },
+    { "CRC-16/CCITT", "CRC-16/KERMIT" },
+    { "CRC-CCITT", "CRC-16/KERMIT" },
+    { "KERMIT", "CRC-16/KERMIT" },
+    { "MODBUS", "CRC-16/MODBUS" },
+    { "XMODEM", "CRC-16/XMODEM" },
+    { "ZMODEM", "CRC-16/XMODEM" },
+    { "CRC-24", "CRC-24/OPENPGP" },
+    { "CRC-32", "CRC-32/ISO-HDLC" },
+    { "CRC-32/ADCCP", "CRC-32/ISO-HDLC" },
+    { "CRC-32/V-42", "CRC-32/ISO-HDLC" },
+    { "CRC-32/XZ", "CRC-32/ISO-HDLC" },
+    { "PKZIP", "CRC-32/ISO-HDLC" },
+    { "CRC-32C", "CRC-32/ISCSI" },
+    { "CRC-32/CASTAGNOLI", "CRC-32/ISCSI" },
+    { "CRC-32/INTERLAKEN", "CRC-32/ISCSI" },
+    { "CRC-32/NVME", "CRC-32/ISCSI" },
+    { "CRC-32D", "CRC-32/BASE91-D" },
+    { "CRC-32Q", "CRC-32/AIXM" },
+    { "CRC-32/AAL5", "CRC-32/BZIP2" },
+    { "CRC-32/POSIX", "CRC-32/CKSUM" },
+    { "CKSUM", "CRC-32/CKSUM" },
+    { "JAMCRC", "CRC-32/JAMCRC" },
+    { "XFER", "CRC-32/XFER" },
+    { "CRC-64", "CRC-64/ECMA-182" },
+    { "CRC-64/GO-ECMA", "CRC-64/XZ" },
+    { NULL, NULL }
+};
+
+static int strcaseeq(const char *a, const char *b)
+{
+    while (*a && toupper((unsigned char)*a) == toupper((unsigned char)*b))
+        a++, b++;
+    return *a == *b;
+}
+
+const struct crc_preset *crc_preset_find(const char *name)
+{
+    size_t i;
+    for (i = 0; aliases[i].alias; i++) {
+        if (strcaseeq(name, aliases[i].alias)) {
+            name = aliases[i].name;
+            break;
+        }
+    }
+    for (i = 0; crc_presets[i].name; i++) {
+        if (strcaseeq(name, crc_presets[i].name))
+            return &crc_presets[i];
+    }
+    return NULL;
+}
+
+void crc_presets_fprint(FILE *stream)
+{
+    size_t i;
+    for (i = 0; crc_presets[i].name; i++)
+        fprintf(stream, "%s\n", crc_presets[i].name);
+}
@@ -0,0 +1,30 @@
+/*
+ * Built-in catalogue of CRC algorithms (CRC RevEng naming).
+ */
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <stdio.h>
+
+/* CRC algorithm parameters in the form of hexadecimal strings */
+struct crc_preset {
+    const char *name;       /* canonical CRC RevEng name */
+    unsigned int width;     /* CRC register width in bits */
+    const char *poly;       /* generator polynomial */
+    const char *init;       /* initial register value */
+    const char *xor_out;    /* final register XOR mask */
+    int reflect_in;         /* reverse input bits */
+    int reflect_out;        /* reverse final register */
+    const char *check;      /* checksum of the ASCII string "123456789" */
+};
+
+/* Catalogue entries terminated by an entry with a NULL name */
+extern const struct crc_preset crc_presets[];
+
+/* Find a preset by its name or a common alias (case-insensitive) */
+const struct crc_preset *crc_preset_find(const char *name);
+
+/* Print names of the catalogue entries (one per line) to stream */
+void crc_presets_fprint(FILE *stream);
+
+#endif
@@ -0,0 +1,161 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define RECORDS_THREADS
+#endif
+#include "records.h"
+
+#include <stdlib.h>
+
+#ifdef RECORDS_THREADS
+#include <pthread.h>
+#endif
+
+/* Bytes of records per chunk of work */
+#define RECORDS_CHUNK ((size_t)1 << 16)
+
+/* Records shared by the worker threads */
+struct records {
+    const struct crc_config *crc;
+    const struct forge_solver *solver;
+    const struct bigint *target;
+    uint8_t *data;
+    size_t n;
+    size_t len;
+    int verify;
+
+    size_t chunk;           /* records per chunk */
+    size_t next;            /* first record of the next chunk */
+    size_t failed;
+    enum crc_records_status status;
+#ifdef RECORDS_THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+static void lock_records(struct records *s)
+{
+#ifdef RECORDS_THREADS
+    pthread_mutex_lock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static void unlock_records(struct records *s)
+{
+#ifdef RECORDS_THREADS
+    pthread_mutex_unlock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+/* Forge record i (vec holds the checksum and two work vectors) */
+static enum crc_records_status forge_record(struct records *s, size_t i,
+                                            struct bigint vec[3],
+                                            bitsize_t flips[])
+{
+    size_t j;
+    bitoffset_t ret;
+    uint8_t *record = s->data + i * s->len;
+
+    crc(s->crc, record, s->len, &vec[0]);
+    ret = forge_solver_solve(s->solver, &vec[0], s->target, &vec[1], flips);
+    if (ret < 0)
+        return CRC_RECORDS_UNREACHABLE;
+    for (j = 0; j < (size_t)ret; j++)
+        record[flips[j] / 8] ^= 1 << (flips[j] % 8);
+
+    if (s->verify) {
+        crc(s->crc, record, s->len, &vec[0]);
+        bigint_xor(&vec[0], s->target);
+        if (!bigint_is_zero(&vec[0]))
+            return CRC_RECORDS_MISMATCH;
+    }
+    return CRC_RECORDS_OK;
+}
+
+/* Chunks of records taken by the threads until done or failed */
+static void *records_worker(void *arg)
+{
+    struct records *s = arg;
+    struct bigint *vec;
+    bitsize_t *flips;
+    enum crc_records_status status = CRC_RECORDS_OK;
+    size_t i, end;
+
+    vec = bigint_array_new(3, s->crc->width);
+    flips = malloc(s->crc->width * sizeof(bitsize_t));
+    if (!vec || !flips)
+        status = CRC_RECORDS_OOM;
+    for (i = 0; ; ) {
+        lock_records(s);
+        if (status && !s->status) {
+            s->status = status;
+            s->failed = i;
+        }
+        i = s->next;
+        s->next += s->chunk;
+        status = s->status;
+        unlock_records(s);
+        if (i >= s->n || status)
+            break;
+        end = (s->n - i < s->chunk) ? s->n : i + s->chunk;
+        for (; i < end; i++) {
+            if ((status = forge_record(s, i, vec, flips)))
+                break;
+        }
+    }
+    bigint_array_delete(vec);
+    free(flips);
+    return NULL;
+}
+
+enum crc_records_status crc_forge_records(const struct crc_config *crc,
+                                          const struct forge_solver *solver,
+                                          const struct bigint *target,
+                                          uint8_t *data, size_t n, size_t len,
+                                          int verify, unsigned threads,
+                                          size_t *failed)
+{
+    struct records s;
+    unsigned t = 0;
+#ifdef RECORDS_THREADS
+    pthread_t *thread = NULL;
+#endif
+
+    s.crc = crc;
+    s.solver = solver;
+    s.target = target;
+    s.data = data;
+    s.n = n;
+    s.len = len;
+    s.verify = verify;
+    s.chunk = (len < RECORDS_CHUNK) ? RECORDS_CHUNK / len : 1;
+    s.next = 0;
+    s.failed = 0;
+    s.status = CRC_RECORDS_OK;
+#ifdef RECORDS_THREADS
+    if (pthread_mutex_init(&s.lock, NULL))
+        return CRC_RECORDS_OOM;
+    if (threads > (n + s.chunk - 1) / s.chunk)
+        threads = (unsigned)((n + s.chunk - 1) / s.chunk);
+    if (threads > 1 && (thread = malloc(threads * sizeof(pthread_t)))) {
+        for (t = 1; t < threads; t++) {
+            if (pthread_create(&thread[t], NULL, records_worker, &s))
+                break;
+        }
+    }
+#else
+    (void)threads;
+#endif
+    records_worker(&s);
+#ifdef RECORDS_THREADS
+    while (t-- > 1)
+        pthread_join(thread[t], NULL);
+    free(thread);
+    pthread_mutex_destroy(&s.lock);
+#endif
+    *failed = s.failed;
+    return s.status;
+}
@@ -0,0 +1,39 @@
+/*
+ * Forging of fixed-size records in parallel threads.
+ */
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include "crc.h"
+#include "forge.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Result of crc_forge_records() */
+enum crc_records_status {
+    CRC_RECORDS_OK = 0,
+    CRC_RECORDS_OOM = -1,           /* out of memory */
+    CRC_RECORDS_UNREACHABLE = 1,    /* target out of reach of the bits */
+    CRC_RECORDS_MISMATCH = 2        /* a forged record failed verification */
+};
+
+/*
+ * Forge the CRC of each of the n len-byte records of data[0..n*len-1] in
+ * place to `target`.
+ *
+ * `solver` holds the mutable bits of a len-byte record. It is only read, so
+ * the `threads` threads share it, each forging chunks of records with its own
+ * work vectors. With `verify` set, each forged record is checksummed again.
+ *
+ * On failure, `*failed` receives the index of a record that could not be
+ * forged (and is left unmodified) or that failed verification.
+ */
+enum crc_records_status crc_forge_records(const struct crc_config *crc,
+                                          const struct forge_solver *solver,
+                                          const struct bigint *target,
+                                          uint8_t *data, size_t n, size_t len,
+                                          int verify, unsigned threads,
+                                          size_t *failed);
+
+#endif
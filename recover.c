@@ -0,0 +1,648 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define RECOVER_THREADS
+#endif
+#include "recover.h"
+#include "forge.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef RECOVER_THREADS
+#include <pthread.h>
+#endif
+
+/* Brute-force divisors (or cofactors) of the GCD up to this degree */
+#define RECOVER_DIVISOR_WIDTH 16
+
+/* Divisor candidates tested per work item */
+#define RECOVER_CHUNK 1024
+
+/* List every init and xor_out solution up to this many ambiguous bits */
+#define RECOVER_AMBIGUITY 4
+
+/*
+ * Polynomials over GF(2) in bigints (bit i is the coefficient of x^i).
+ */
+static bitoffset_t poly_degree(const struct bigint *a)
+{
+    size_t i = bigint_limbs(a);
+    while (i--) {
+        if (a->limb[i]) {
+            bitoffset_t d = (bitoffset_t)i * LIMB_BITS;
+            limb_t limb = a->limb[i];
+            while (limb >>= 1) d++;
+            return d;
+        }
+    }
+    return -1;
+}
+
+/* a ^= b*x^s where deg(b) = d and deg(a) >= d + s */
+static void poly_xor_shifted(struct bigint *a, const struct bigint *b,
+                             bitsize_t d, bitsize_t s)
+{
+    size_t i, n = BITS_TO_LIMBS(d + 1), q = s / LIMB_BITS;
+    const unsigned int r = s % LIMB_BITS;
+    for (i = 0; i < n; i++) {
+        a->limb[q + i] ^= b->limb[i] << r;
+        if (r && q + i + 1 < bigint_limbs(a))
+            a->limb[q + i + 1] ^= b->limb[i] >> (LIMB_BITS - r);
+    }
+}
+
+/* a = a mod b (b non-zero) */
+static void poly_mod(struct bigint *a, const struct bigint *b)
+{
+    bitoffset_t da, db = poly_degree(b);
+    while ((da = poly_degree(a)) >= db)
+        poly_xor_shifted(a, b, db, da - db);
+}
+
+/* a = gcd(a, b) (b is destroyed) */
+static void poly_gcd(struct bigint *a, struct bigint *b)
+{
+    while (!bigint_is_zero(b)) {
+        poly_mod(a, b);
+        bigint_swap(a, b);
+    }
+}
+
+/*
+ * Test whether x^w + poly divides a (w <= 56). The remainder is taken a byte
+ * at a time with a table of h*x^w mod (x^w + poly) for the bytes h shifted
+ * out of the register.
+ */
+static int poly_divides(uint64_t poly, unsigned int w, const struct bigint *a)
+{
+    size_t i, j, h;
+    uint64_t table[256], x = poly, r = 0;
+    const uint64_t mask = ((uint64_t)1 << w) - 1;
+    const bitoffset_t d = poly_degree(a);
+
+    table[0] = 0;
+    for (i = 0; i < 8; i++) {
+        for (h = 0; h < (size_t)1 << i; h++)
+            table[h | (size_t)1 << i] = table[h] ^ x;
+        x = ((x << 1) & mask) ^ (poly & -((x >> (w - 1)) & 1));
+    }
+    for (j = (d < 0) ? 0 : (size_t)d / 8 + 1; j-- > 0; ) {
+        const limb_t limb = a->limb[j / sizeof(limb_t)];
+        r = (r << 8) | ((limb >> 8 * (j % sizeof(limb_t))) & 0xFF);
+        r = (r & mask) ^ table[r >> w];
+    }
+    return !r;
+}
+
+/*
+ * Difference polynomial of equal-length samples a and b: the CRC register
+ * difference satisfies (M_a - M_b) * x^w = R_a - R_b (mod P), so P divides
+ * (M_a - M_b) * x^w + (R_a - R_b).
+ */
+static void difference(const struct crc_sample *a, const struct bigint *sum_a,
+                       const struct crc_sample *b, const struct bigint *sum_b,
+                       unsigned int w, int reflect_in, int reflect_out,
+                       struct bigint *out)
+{
+    size_t i;
+    const bitsize_t top = 8 * (bitsize_t)a->len - 1 + w;
+    bigint_load_zeros(out);
+    for (i = 0; i < a->len; i++) {
+        int j, bits = a->msg[i] ^ b->msg[i];
+        for (j = 0; bits && j < 8; j++) {
+            if ((bits >> (reflect_in ? j : 7 - j)) & 1)
+                bigint_set_bit(out, top - (8 * (bitsize_t)i + j));
+        }
+    }
+
+    {
+        unsigned int k;
+        struct bigint r;
+        if (!bigint_init(&r, w))
+            return;
+        bigint_mov(&r, sum_a);
+        bigint_xor(&r, sum_b);
+        if (reflect_out)
+            bigint_reflect(&r);
+        for (k = 0; k < w; k++) {
+            if (bigint_get_bit(&r, k))
+                bigint_flip_bit(out, k);
+        }
+        bigint_destroy(&r);
+    }
+}
+
+/* CRC algorithm found by a work item */
+struct recover_hit {
+    struct crc_config config;
+    size_t ambiguity;
+};
+
+/* Outcome of the GCD pass for a family */
+enum recover_status {
+    RECOVER_NONE,           /* no algorithm of the family fits */
+    RECOVER_UNDETERMINED,   /* the samples do not determine the polynomial */
+    RECOVER_KNOWN,          /* the polynomial is given by the hint */
+    RECOVER_DIVISORS        /* enumerate the divisors (or cofactors) of G */
+};
+
+/* CRC algorithms of a width and reflection flags */
+struct recover_family {
+    unsigned int w;
+    int reflect_in;
+    int reflect_out;
+    struct bigint *sums;    /* sample checksums */
+    struct bigint G;        /* GCD of the sample differences */
+    unsigned int k;         /* degree of the enumerated polynomials */
+    int cofactor;           /* enumerate the cofactors of degree-w divisors */
+    enum recover_status status;
+};
+
+/* Range lo..hi-1 of the enumerated polynomials of a family */
+struct recover_item {
+    size_t family;
+    uint64_t lo, hi;
+    struct recover_hit *hits;
+    size_t nhits;
+    size_t capacity;
+    int error;
+};
+
+/* Passes over the families and the work items */
+enum recover_pass { RECOVER_GCD, RECOVER_SOLVE };
+
+/* Search state shared by the threads */
+struct recover {
+    const struct crc_sample *samples;
+    size_t n;
+    const struct crc_hint *hint;
+    const uint8_t *zeros;
+    bitsize_t gbits;        /* size of the GCD polynomials */
+
+    struct recover_family *families;
+    size_t nfamilies;
+    struct recover_item *items;
+    size_t nitems;
+
+    enum recover_pass pass;
+    size_t next;
+    int error;
+#ifdef RECOVER_THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+/* Keep a copy of a found CRC algorithm (zero if out of memory) */
+static int keep(struct recover_item *item, const struct crc_config *config,
+                size_t ambiguity)
+{
+    struct recover_hit *hit;
+    const unsigned int w = config->width;
+    if (item->nhits == item->capacity) {
+        size_t capacity = 2*item->capacity + 4;
+        if (!(hit = realloc(item->hits, capacity * sizeof(*hit))))
+            return 0;
+        item->hits = hit;
+        item->capacity = capacity;
+    }
+    hit = &item->hits[item->nhits];
+    memset(hit, 0, sizeof(*hit));
+    hit->config.width = w;
+    hit->config.reflect_in = config->reflect_in;
+    hit->config.reflect_out = config->reflect_out;
+    hit->ambiguity = ambiguity;
+    if (!bigint_init(&hit->config.poly, w)
+            || !bigint_init(&hit->config.init, w)
+            || !bigint_init(&hit->config.xor_out, w)) {
+        bigint_destroy(&hit->config.poly);
+        bigint_destroy(&hit->config.init);
+        return 0;
+    }
+    bigint_mov(&hit->config.poly, &config->poly);
+    bigint_mov(&hit->config.init, &config->init);
+    bigint_mov(&hit->config.xor_out, &config->xor_out);
+    item->nhits++;
+    return 1;
+}
+
+/* Store w-bit value v to bits i*w..i*w+w-1 of out */
+static void place(struct bigint *out, size_t i, const struct bigint *v)
+{
+    bitsize_t k;
+    for (k = 0; k < v->bits; k++) {
+        if (bigint_get_bit(v, k))
+            bigint_set_bit(out, i * v->bits + k);
+    }
+}
+
+/* Flip bit v of init (v < w) or bit v - w of xor_out */
+static void toggle(struct crc_config *config, bitsize_t v)
+{
+    if (v < config->width) {
+        bigint_flip_bit(&config->init, v);
+    } else {
+        bigint_flip_bit(&config->xor_out, v - config->width);
+    }
+}
+
+/*
+ * Solve init and xor_out of a candidate CRC algorithm from the samples.
+ *
+ * CRC checksums are affine functions of init and xor_out, so the bits of the
+ * two values can be treated as the mutable bits of a virtual message whose
+ * "checksum" is the concatenation of the sample checksums. The solutions are
+ * kept in the work item. Returns their number (or -1 if out of memory).
+ */
+static int solve(const struct crc_sample samples[], size_t n,
+                 const struct bigint *sums, const uint8_t *zeros,
+                 struct crc_config *config, struct recover_item *item)
+{
+    size_t i;
+    int ret = 0;
+    struct bigint sum, target, base, *delta;
+    struct forge_space space;
+    size_t m, r, t;
+    bitsize_t k, *vars;
+    const unsigned int w = config->width;
+    const bitsize_t nvars = 2 * (bitsize_t)w, nbits = (bitsize_t)w * n;
+
+    delta = bigint_array_new(nvars, nbits);
+    vars = malloc(nvars * sizeof(bitsize_t));
+    bigint_init(&sum, w);
+    bigint_init(&target, nbits);
+    bigint_init(&base, nbits);
+    if (!delta || !vars || !sum.limb || !target.limb || !base.limb) {
+        ret = -1;
+        goto finish;
+    }
+    crc_tabulate(config);
+
+    /* Pivot on xor_out bits first so that ambiguous init bits stay zero */
+    for (k = 0; k < nvars; k++)
+        vars[k] = (k + w) % nvars;
+
+    /* Checksums with zero init and xor_out, and the effect of each bit */
+    bigint_load_zeros(&config->init);
+    bigint_load_zeros(&config->xor_out);
+    for (i = 0; i < n; i++) {
+        crc(config, samples[i].msg, samples[i].len, &sum);
+        place(&base, i, &sum);
+        place(&target, i, &sums[i]);
+    }
+    for (k = 0; k < nvars; k++) {
+        struct bigint *var = (vars[k] < w) ? &config->init : &config->xor_out;
+        bigint_set_bit(var, vars[k] % w);
+        for (i = 0; i < n; i++) {
+            crc(config, zeros, samples[i].len, &sum);
+            place(&delta[k], i, &sum);
+        }
+        bigint_clear_bit(var, vars[k] % w);
+    }
+
+    if (forge_affine_columns(&target, &base, delta, vars, nvars,
+                             &space) >= 0) {
+        for (k = 0; k < space.rank; k++) {
+            if (bigint_get_bit(&space.x, k))
+                toggle(config, vars[k]);
+        }
+        /* List all solutions of small ambiguous systems */
+        m = (space.dim <= RECOVER_AMBIGUITY) ? (size_t)1 << space.dim : 1;
+        for (t = 0; t < m; t++) {
+            if (t) {
+                for (r = 0; !((t >> r) & 1); r++);
+                toggle(config, vars[space.rank + r]);
+                for (k = 0; k < space.rank; k++) {
+                    if (bigint_get_bit(&space.kernel[r], k))
+                        toggle(config, vars[k]);
+                }
+            }
+            if (!keep(item, config, space.dim)) {
+                ret = -1;
+                break;
+            }
+            ret++;
+        }
+        forge_space_destroy(&space);
+    }
+
+finish:
+    crc_untabulate(config);
+    bigint_destroy(&base);
+    bigint_destroy(&target);
+    bigint_destroy(&sum);
+    bigint_array_delete(delta);
+    free(vars);
+    return ret;
+}
+
+/*
+ * GCD pass: the candidate polynomials of a family, as the degree-w divisors
+ * of the GCD of the differences of equal-length samples (enumerated directly
+ * or through their cofactors, whichever have the smaller degree).
+ */
+static int gcd_family(struct recover *s, struct recover_family *f,
+                      struct bigint *Q)
+{
+    size_t i, j;
+    int have;
+    bitoffset_t d;
+    const struct crc_sample *samples = s->samples;
+    const unsigned int w = f->w;
+
+    f->status = RECOVER_NONE;
+    if (!(f->sums = bigint_array_new(s->n, w)))
+        return 0;
+
+    /* Checksums must fit in the CRC register */
+    for (i = 0; i < s->n; i++) {
+        if (!bigint_from_string(&f->sums[i], samples[i].checksum))
+            return 1;
+    }
+
+    /* Known polynomial */
+    if (s->hint->poly) {
+        f->status = RECOVER_KNOWN;
+        return 1;
+    }
+
+    if (!bigint_init(&f->G, s->gbits))
+        return 0;
+    for (i = have = 0; i < s->n; i++) {
+        for (j = 0; j < i && samples[j].len != samples[i].len; j++);
+        if (j == i)
+            continue;
+        difference(&samples[j], &f->sums[j], &samples[i], &f->sums[i],
+                   w, f->reflect_in, f->reflect_out, have ? Q : &f->G);
+        if (have)
+            poly_gcd(&f->G, Q);
+        have = 1;
+    }
+    if (!have || (d = poly_degree(&f->G)) < 0) {
+        f->status = RECOVER_UNDETERMINED;
+        return 1;
+    }
+    if (d < (bitoffset_t)w)
+        return 1;
+    f->cofactor = (bitsize_t)d - w < w;
+    f->k = f->cofactor ? (unsigned int)(d - w) : w;
+    f->status = (f->k > RECOVER_DIVISOR_WIDTH) ? RECOVER_UNDETERMINED
+                                               : RECOVER_DIVISORS;
+    return 1;
+}
+
+/*
+ * Solving pass: solve init and xor_out for the polynomials of a work item.
+ */
+static int solve_item(struct recover *s, struct recover_item *item,
+                      struct bigint *Q, struct bigint *C)
+{
+    int ok = 0;
+    uint64_t c;
+    bitoffset_t e;
+    struct crc_config config;
+    const struct recover_family *f = &s->families[item->family];
+    const unsigned int w = f->w, k = f->k;
+
+    memset(&config, 0, sizeof(config));
+    config.width = w;
+    config.reflect_in = f->reflect_in;
+    config.reflect_out = f->reflect_out;
+    if (!bigint_init(&config.poly, w) || !bigint_init(&config.init, w)
+            || !bigint_init(&config.xor_out, w))
+        goto finish;
+
+    if (f->status == RECOVER_KNOWN) {
+        ok = !bigint_from_string(&config.poly, s->hint->poly)
+          || solve(s->samples, s->n, f->sums, s->zeros, &config, item) >= 0;
+        goto finish;
+    }
+    for (c = item->lo; c < item->hi; c++) {
+        if (k && !poly_divides(c, k, &f->G))
+            continue;
+        if (f->cofactor) {
+            /* Quotient of G and x^k + c */
+            bigint_mov(Q, &f->G);
+            bigint_load_u64(C, c);
+            bigint_set_bit(C, k);
+            bigint_load_zeros(&config.poly);
+            while ((e = poly_degree(Q)) >= (bitoffset_t)k) {
+                poly_xor_shifted(Q, C, k, e - k);
+                if (e - k < (bitoffset_t)w)
+                    bigint_set_bit(&config.poly, e - k);
+            }
+        } else {
+            bigint_load_u64(&config.poly, c);
+        }
+        if (solve(s->samples, s->n, f->sums, s->zeros, &config, item) < 0)
+            goto finish;
+    }
+    ok = 1;
+
+finish:
+    bigint_destroy(&config.xor_out);
+    bigint_destroy(&config.init);
+    bigint_destroy(&config.poly);
+    return ok;
+}
+
+static void lock_recover(struct recover *s)
+{
+#ifdef RECOVER_THREADS
+    pthread_mutex_lock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static void unlock_recover(struct recover *s)
+{
+#ifdef RECOVER_THREADS
+    pthread_mutex_unlock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+/* Families (or work items) of a pass taken by the threads */
+static void *recover_worker(void *arg)
+{
+    struct recover *s = arg;
+    struct bigint Q, C;
+    size_t i, n;
+    int error;
+
+    n = (s->pass == RECOVER_GCD) ? s->nfamilies : s->nitems;
+    error = !bigint_init(&Q, s->gbits) | !bigint_init(&C, s->gbits);
+    for (;;) {
+        lock_recover(s);
+        s->error |= error;
+        i = s->next++;
+        error = s->error;
+        unlock_recover(s);
+        if (i >= n || error)
+            break;
+        if (s->pass == RECOVER_GCD)
+            error = !gcd_family(s, &s->families[i], &Q);
+        else if (!solve_item(s, &s->items[i], &Q, &C))
+            s->items[i].error = 1;
+    }
+    bigint_destroy(&C);
+    bigint_destroy(&Q);
+    return NULL;
+}
+
+/* Run a pass in `threads` threads (returns zero if out of memory) */
+static int run_pass(struct recover *s, enum recover_pass pass, size_t n,
+                    unsigned threads)
+{
+    unsigned t = 0;
+#ifdef RECOVER_THREADS
+    pthread_t *thread = NULL;
+#endif
+
+    s->pass = pass;
+    s->next = 0;
+#ifdef RECOVER_THREADS
+    if (pthread_mutex_init(&s->lock, NULL))
+        return 0;
+    if (threads > n)
+        threads = (unsigned)n;
+    if (threads > 1 && (thread = malloc(threads * sizeof(pthread_t)))) {
+        for (t = 1; t < threads; t++) {
+            if (pthread_create(&thread[t], NULL, recover_worker, s))
+                break;
+        }
+    }
+#else
+    (void)threads;
+    (void)n;
+#endif
+    recover_worker(s);
+#ifdef RECOVER_THREADS
+    while (t-- > 1)
+        pthread_join(thread[t], NULL);
+    free(thread);
+    pthread_mutex_destroy(&s->lock);
+#endif
+    return !s->error;
+}
+
+int crc_recover(const struct crc_sample samples[], size_t n,
+                const struct crc_hint *hint, unsigned threads,
+                void (*found)(const struct crc_config *crc, size_t ambiguity))
+{
+    struct recover s;
+    size_t i, j, maxlen, digits;
+    unsigned int w, lo, hi;
+    int ri, ro, count, undetermined, ret = -1;
+    uint8_t *zeros;
+
+    for (i = maxlen = digits = 0; i < n; i++) {
+        const char *hex = samples[i].checksum;
+        if (hex[0] == '0' && hex[1] == 'x')
+            hex += 2;
+        if (strlen(hex) > digits)
+            digits = strlen(hex);
+        if (samples[i].len > maxlen)
+            maxlen = samples[i].len;
+    }
+    lo = hint->width ? hint->width : (digits > 1 ? 4 * digits - 3 : 1);
+    hi = hint->width ? hint->width : 4 * digits;
+
+    memset(&s, 0, sizeof(s));
+    s.samples = samples;
+    s.n = n;
+    s.hint = hint;
+    s.gbits = 8 * (bitsize_t)maxlen + hi + 1;
+    if (!(s.zeros = zeros = calloc(maxlen + 1, sizeof(uint8_t)))
+            || !(s.families = calloc(4 * (hi - lo + 1),
+                                     sizeof(struct recover_family))))
+        goto finish;
+
+    /* Families of the widths and reflection flags */
+    for (w = lo; w <= hi; w++) {
+        for (ri = 0; ri <= 1; ri++) {
+            if (hint->reflect_in >= 0 && ri != hint->reflect_in)
+                continue;
+            for (ro = 0; ro <= 1; ro++) {
+                struct recover_family *f = &s.families[s.nfamilies];
+                if (hint->reflect_out >= 0 && ro != hint->reflect_out)
+                    continue;
+                f->w = w;
+                f->reflect_in = ri;
+                f->reflect_out = ro;
+                s.nfamilies++;
+            }
+        }
+    }
+    if (!run_pass(&s, RECOVER_GCD, s.nfamilies, threads))
+        goto finish;
+    for (i = 0; i < s.nfamilies; i++) {
+        if (s.families[i].status != RECOVER_DIVISORS)
+            bigint_destroy(&s.families[i].G);
+    }
+
+    /* Work items over the candidate polynomials */
+    for (i = 0; i < s.nfamilies; i++) {
+        const struct recover_family *f = &s.families[i];
+        if (f->status == RECOVER_KNOWN)
+            s.nitems++;
+        else if (f->status == RECOVER_DIVISORS)
+            s.nitems += (((uint64_t)1 << f->k) + RECOVER_CHUNK-1) / RECOVER_CHUNK;
+    }
+    if (!(s.items = calloc(s.nitems + 1, sizeof(struct recover_item))))
+        goto finish;
+    for (i = j = 0; i < s.nfamilies; i++) {
+        const struct recover_family *f = &s.families[i];
+        uint64_t c, end = (f->status == RECOVER_KNOWN) ? 1
+                        : (f->status == RECOVER_DIVISORS) ? (uint64_t)1 << f->k
+                        : 0;
+        for (c = 0; c < end; c += RECOVER_CHUNK, j++) {
+            s.items[j].family = i;
+            s.items[j].lo = c;
+            s.items[j].hi = (end - c > RECOVER_CHUNK) ? c + RECOVER_CHUNK : end;
+        }
+    }
+    if (!run_pass(&s, RECOVER_SOLVE, s.nitems, threads))
+        goto finish;
+
+    /* Report the algorithms in the order of the families and polynomials */
+    count = undetermined = 0;
+    for (i = j = 0; i < s.nfamilies; i++) {
+        int family = 0;
+        if (s.families[i].status == RECOVER_UNDETERMINED)
+            undetermined = 1;
+        for (; j < s.nitems && s.items[j].family == i; j++) {
+            struct recover_item *item = &s.items[j];
+            size_t k;
+            for (k = 0; k < item->nhits; k++)
+                found(&item->hits[k].config, item->hits[k].ambiguity);
+            family = (family < 0 || item->error) ? -1
+                   : family + (int)item->nhits;
+        }
+        if (family < 0)
+            undetermined = 1;
+        else
+            count += family;
+    }
+    ret = (!count && undetermined) ? -1 : count;
+
+finish:
+    for (i = 0; s.items && i < s.nitems; i++) {
+        for (j = 0; j < s.items[i].nhits; j++) {
+            struct crc_config *config = &s.items[i].hits[j].config;
+            bigint_destroy(&config->xor_out);
+            bigint_destroy(&config->init);
+            bigint_destroy(&config->poly);
+        }
+        free(s.items[i].hits);
+    }
+    free(s.items);
+    for (i = 0; s.families && i < s.nfamilies; i++) {
+        bigint_destroy(&s.families[i].G);
+        bigint_array_delete(s.families[i].sums);
+    }
+    free(s.families);
+    free(zeros);
+    return ret;
+}
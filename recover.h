@@ -0,0 +1,54 @@
+/*
+ * Recovery of CRC parameters from sample messages and their checksums.
+ */
+#ifndef RECOVER_H
+#define RECOVER_H
+
+#include "crc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Message and its checksum */
+struct crc_sample {
+    const uint8_t *msg;
+    size_t len;
+    const char *checksum;   /* hexadecimal string */
+};
+
+/*
+ * Known CRC parameters limiting the search.
+ *
+ * Zero width or poly means unknown. Negative reflect_in or reflect_out means
+ * that both values of the flag are tried.
+ */
+struct crc_hint {
+    unsigned int width;
+    const char *poly;
+    int reflect_in;
+    int reflect_out;
+};
+
+/*
+ * Find CRC algorithms producing the sample checksums.
+ *
+ * Candidate polynomials are the divisors of the GCD of the differences of
+ * equal-length samples, which cancel out init and xor_out. For each candidate
+ * polynomial, init and xor_out are solved from the samples with forge().
+ *
+ * The GCDs of the candidate widths and reflection flags, and then ranges of
+ * their candidate polynomials, are taken by `threads` threads.
+ *
+ * Callback `found` receives each consistent CRC algorithm and the number of
+ * bits in init and xor_out left ambiguous by the samples (in the order of
+ * width, reflection flags and polynomial, from the calling thread). All
+ * solutions are listed if there are only a few ambiguous bits; otherwise only
+ * the solution with the ambiguous init bits cleared is. Returns the number of
+ * algorithms found, or a negative value if the samples cannot determine the
+ * polynomial.
+ */
+int crc_recover(const struct crc_sample samples[], size_t n,
+                const struct crc_hint *hint, unsigned threads,
+                void (*found)(const struct crc_config *crc, size_t ambiguity));
+
+#endif
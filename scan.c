@@ -0,0 +1,589 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define SCAN_THREADS
+#endif
+#include "scan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SCAN_THREADS
+#include <pthread.h>
+#endif
+
+/* Bytes (or window starts) per chunk of work */
+#define SCAN_CHUNK ((size_t)1 << 20)
+
+static const char *const out_of_memory = "out of memory";
+
+/*
+ * Hash table of 64-bit keys. Entries with equal hashes are chained by next[]
+ * (SIZE_MAX ends a chain), and the index of an entry identifies its value.
+ */
+struct scan_set {
+    const uint64_t *keys;
+    size_t *bucket;
+    size_t *next;
+    unsigned shift;
+};
+
+static size_t set_hash(const struct scan_set *set, uint64_t key)
+{
+    return (size_t)((key * 0x9E3779B97F4A7C15) >> set->shift);
+}
+
+static int set_init(struct scan_set *set, const uint64_t keys[], size_t n)
+{
+    size_t i, h;
+    unsigned bits = 1;
+    while (bits < 8 * sizeof(size_t) - 1 && ((size_t)1 << bits) < 2 * n)
+        bits++;
+    set->keys = keys;
+    set->shift = 64 - bits;
+    set->bucket = malloc(((size_t)1 << bits) * sizeof(size_t));
+    set->next = malloc((n + 1) * sizeof(size_t));
+    if (!set->bucket || !set->next)
+        return 0;
+    memset(set->bucket, 0xFF, ((size_t)1 << bits) * sizeof(size_t));
+    for (i = n; i-- > 0; ) {
+        h = set_hash(set, keys[i]);
+        set->next[i] = set->bucket[h];
+        set->bucket[h] = i;
+    }
+    return 1;
+}
+
+static void set_destroy(struct scan_set *set)
+{
+    free(set->bucket);
+    free(set->next);
+}
+
+/* First entry of a key (or SIZE_MAX), and the next entry of the same key */
+static size_t set_find(const struct scan_set *set, uint64_t key)
+{
+    size_t i = set->bucket[set_hash(set, key)];
+    while (i != SIZE_MAX && set->keys[i] != key)
+        i = set->next[i];
+    return i;
+}
+
+static size_t set_next(const struct scan_set *set, size_t i)
+{
+    const uint64_t key = set->keys[i];
+    do {
+        i = set->next[i];
+    } while (i != SIZE_MAX && set->keys[i] != key);
+    return i;
+}
+
+/* Matches found in a chunk */
+struct scan_chunk {
+    struct crc_scan_match *m;
+    size_t n;
+    size_t capacity;
+};
+
+/*
+ * Scan state. Registers are polynomials modulo P (bit k is the coefficient of
+ * x^k) without init, xor_out or reflection.
+ */
+struct scan {
+    struct crc_config zero; /* the CRC without init, xor_out or reflection */
+    unsigned int w;
+    uint64_t mask;
+    uint64_t poly;          /* P - x^w = x^w mod P */
+    int reflect_in;
+    uint64_t init;
+    uint64_t step[256];     /* byte c (in processing order) times x^w */
+    uint64_t roll[256];     /* byte leaving a window */
+    uint64_t ymul[8][256];  /* multiplication by y = x^-8 */
+    uint64_t y;
+
+    const uint8_t *data;
+    size_t size;
+    const uint64_t *targets;
+    size_t ntargets;
+    size_t window, first, last;
+
+    size_t nchunks;
+    uint64_t *state;        /* S(p) at the chunk starts */
+    uint64_t *keys;         /* (S(s) + init)·y^s of the starts */
+    struct scan_set set;
+    struct scan_chunk *chunks;
+};
+
+static uint64_t mulx(const struct scan *s, uint64_t a)
+{
+    uint64_t carry = (a >> (s->w - 1)) & 1;
+    return ((a << 1) & s->mask) ^ (s->poly & -carry);
+}
+
+static uint64_t mulmod(const struct scan *s, uint64_t a, uint64_t b)
+{
+    uint64_t x = 0;
+    unsigned int i = s->w;
+    while (i--) {
+        x = mulx(s, x);
+        if ((b >> i) & 1)
+            x ^= a;
+    }
+    return x;
+}
+
+static uint64_t powmod(const struct scan *s, uint64_t a, uintmax_t n)
+{
+    uint64_t r = 1;
+    while (n) {
+        if (n & 1)
+            r = mulmod(s, r, a);
+        a = mulmod(s, a, a);
+        n >>= 1;
+    }
+    return r;
+}
+
+/* Byte in processing order (the first bit is the coefficient of x^7) */
+static unsigned int byte_poly(const struct scan *s, uint8_t b)
+{
+    if (s->reflect_in) {
+        b = (uint8_t)((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+        b = (uint8_t)((b & 0xCC) >> 2 | (b & 0x33) << 2);
+        b = (uint8_t)((b & 0xAA) >> 1 | (b & 0x55) << 1);
+    }
+    return b;
+}
+
+/* r·x^8 + c·x^w mod P */
+static uint64_t step(const struct scan *s, uint64_t r, unsigned int c)
+{
+    if (s->w < 8)
+        return s->step[(r << (8 - s->w)) ^ c];
+    return ((r << 8) & s->mask) ^ s->step[(r >> (s->w - 8)) ^ c];
+}
+
+/* c·a mod P for a byte c (in processing order) */
+static uint64_t mulbyte(const struct scan *s, unsigned int c, uint64_t a)
+{
+    int i;
+    uint64_t x = 0;
+    for (i = 7; i >= 0; i--)
+        x = mulx(s, x) ^ (a & -(uint64_t)((c >> i) & 1));
+    return x;
+}
+
+static uint64_t muly(const struct scan *s, uint64_t a)
+{
+    unsigned int k;
+    uint64_t x = 0;
+    for (k = 0; 8 * k < s->w; k++)
+        x ^= s->ymul[k][(a >> 8 * k) & 0xFF];
+    return x;
+}
+
+/* Register of data[from..to-1] (from zero) */
+static uint64_t chunk_register(const struct scan *s, size_t from, size_t to,
+                               struct bigint *reg)
+{
+    crc(&s->zero, s->data + from, to - from, reg);
+    return bigint_get_u64(reg) & s->mask;
+}
+
+static int add_match(struct scan_chunk *chunk, size_t start, size_t end,
+                     size_t target)
+{
+    if (chunk->n == chunk->capacity) {
+        size_t capacity = 2*chunk->capacity + 16;
+        struct crc_scan_match *m = realloc(chunk->m, capacity * sizeof(*m));
+        if (!m)
+            return 0;
+        chunk->m = m;
+        chunk->capacity = capacity;
+    }
+    chunk->m[chunk->n].start = start;
+    chunk->m[chunk->n].end = end;
+    chunk->m[chunk->n].target = target;
+    chunk->n++;
+    return 1;
+}
+
+/* Passes over the chunks */
+enum scan_pass { SCAN_LOCAL, SCAN_STARTS, SCAN_ENDS, SCAN_WINDOWS };
+
+/* Windows starting in chunk k */
+static const char *scan_windows(struct scan *s, size_t k, struct bigint *reg)
+{
+    size_t from = s->first + k * SCAN_CHUNK, to = from + SCAN_CHUNK, i;
+    const size_t n = s->window;
+    uint64_t r;
+    if (to > s->last)
+        to = s->last;
+    r = chunk_register(s, from, from + n, reg);
+    for (;;) {
+        i = set_find(&s->set, r);
+        for (; i != SIZE_MAX; i = set_next(&s->set, i)) {
+            if (!add_match(&s->chunks[k], from, from + n, i))
+                return out_of_memory;
+        }
+        if (++from == to)
+            break;
+        r = step(s, r, byte_poly(s, s->data[from + n - 1]))
+          ^ s->roll[s->data[from - 1]];
+    }
+    return NULL;
+}
+
+/*
+ * Positions p of chunk k (from S(p) at the chunk start). For the starts, the
+ * keys (S(p) + init)·y^p are stored; for the ends, (S(p) + T)·y^p of each
+ * target is looked up from the starts.
+ */
+static const char *scan_positions(struct scan *s, size_t k, int ends)
+{
+    size_t p = k * SCAN_CHUNK, stop = p + SCAN_CHUNK, lo, hi, t, i;
+    uint64_t u, z, yp, *v;
+
+    lo = ends ? s->first + 1 : s->first;
+    hi = ends ? s->size + 1 : s->last;
+    if (stop > hi)
+        stop = hi;
+    if (stop <= lo || p >= stop)
+        return NULL;
+    if (!(v = malloc((s->ntargets + 1) * sizeof(uint64_t))))
+        return out_of_memory;
+
+    /* u = S(p)·y^p, z = x^w·y^(p+1) and v[] = init or targets times y^p */
+    yp = powmod(s, s->y, p);
+    u = mulmod(s, s->state[k], yp);
+    z = mulmod(s, s->poly, mulmod(s, yp, s->y));
+    if (ends) {
+        for (t = 0; t < s->ntargets; t++)
+            v[t] = mulmod(s, s->targets[t], yp);
+    } else {
+        v[0] = mulmod(s, s->init, yp);
+    }
+
+    for (;;) {
+        if (p >= lo && !ends) {
+            s->keys[p - s->first] = u ^ v[0];
+        } else if (p >= lo) {
+            for (t = 0; t < s->ntargets; t++) {
+                i = set_find(&s->set, u ^ v[t]);
+                for (; i != SIZE_MAX; i = set_next(&s->set, i)) {
+                    if (s->first + i < p
+                            && !add_match(&s->chunks[k], s->first + i, p, t)) {
+                        free(v);
+                        return out_of_memory;
+                    }
+                }
+            }
+        }
+        if (++p == stop)
+            break;
+        u ^= mulbyte(s, byte_poly(s, s->data[p - 1]), z);
+        z = muly(s, z);
+        for (t = 0; t < (ends ? s->ntargets : 1); t++)
+            v[t] = muly(s, v[t]);
+    }
+    free(v);
+    return NULL;
+}
+
+static const char *scan_chunk(struct scan *s, enum scan_pass pass, size_t k,
+                              struct bigint *reg)
+{
+    size_t from = k * SCAN_CHUNK, to = from + SCAN_CHUNK;
+    switch (pass) {
+    case SCAN_LOCAL:
+        /* Register of the chunk bytes (combined to S(p) later) */
+        if (to > s->size)
+            to = s->size;
+        s->state[k] = from < to ? chunk_register(s, from, to, reg) : 0;
+        return NULL;
+    case SCAN_STARTS:
+        return scan_positions(s, k, 0);
+    case SCAN_ENDS:
+        return scan_positions(s, k, 1);
+    case SCAN_WINDOWS:
+        return scan_windows(s, k, reg);
+    }
+    return NULL;
+}
+
+/* Chunks of a pass taken by the threads */
+struct scan_work {
+    struct scan *scan;
+    enum scan_pass pass;
+    size_t next;
+    size_t n;
+    const char *error;
+#ifdef SCAN_THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+static void *scan_worker(void *arg)
+{
+    struct scan_work *work = arg;
+    struct bigint reg;
+    const char *error;
+    size_t k;
+
+    if (!bigint_init(&reg, work->scan->w)) {
+        work->error = out_of_memory;
+        return NULL;
+    }
+    for (;;) {
+#ifdef SCAN_THREADS
+        pthread_mutex_lock(&work->lock);
+#endif
+        k = work->next++;
+        error = work->error;
+#ifdef SCAN_THREADS
+        pthread_mutex_unlock(&work->lock);
+#endif
+        if (k >= work->n || error)
+            break;
+        if ((error = scan_chunk(work->scan, work->pass, k, &reg))) {
+#ifdef SCAN_THREADS
+            pthread_mutex_lock(&work->lock);
+#endif
+            work->error = error;
+#ifdef SCAN_THREADS
+            pthread_mutex_unlock(&work->lock);
+#endif
+            break;
+        }
+    }
+    bigint_destroy(&reg);
+    return NULL;
+}
+
+static const char *run_pass(struct scan *s, enum scan_pass pass, size_t n,
+                            unsigned threads)
+{
+    struct scan_work work;
+    unsigned t = 0;
+#ifdef SCAN_THREADS
+    pthread_t *thread = NULL;
+#endif
+
+    memset(&work, 0, sizeof(work));
+    work.scan = s;
+    work.pass = pass;
+    work.n = n;
+#ifdef SCAN_THREADS
+    if (pthread_mutex_init(&work.lock, NULL))
+        return out_of_memory;
+    if (threads > n)
+        threads = (unsigned)n;
+    if (threads > 1 && (thread = malloc(threads * sizeof(pthread_t)))) {
+        for (t = 1; t < threads; t++) {
+            if (pthread_create(&thread[t], NULL, scan_worker, &work))
+                break;
+        }
+    }
+#else
+    (void)threads;
+#endif
+    scan_worker(&work);
+#ifdef SCAN_THREADS
+    while (t-- > 1)
+        pthread_join(thread[t], NULL);
+    free(thread);
+    pthread_mutex_destroy(&work.lock);
+#endif
+    return work.error;
+}
+
+static int compare_matches(const void *a, const void *b)
+{
+    const struct crc_scan_match *x = a, *y = b;
+    if (x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    if (x->end != y->end)
+        return x->end < y->end ? -1 : 1;
+    return (x->target > y->target) - (x->target < y->target);
+}
+
+/* Tables and the registers of the targets */
+static const char *scan_init(struct scan *s, const struct crc_config *crc,
+                             const struct bigint targets[], uint64_t tk[])
+{
+    size_t i, k;
+    uint64_t basis[64], v;
+    struct bigint t;
+
+    s->w = crc->width;
+    s->mask = ~(uint64_t)0 >> (64 - s->w);
+    s->poly = bigint_get_u64(&crc->poly) & s->mask;
+    s->reflect_in = crc->reflect_in;
+    s->init = bigint_get_u64(&crc->init) & s->mask;
+    for (i = 0; i < 256; i++) {
+        /* i·x^w mod P (bits of i from x^7 down to x^0) */
+        for (v = 0, k = 8; k-- > 0; ) {
+            v = mulx(s, v);
+            if ((i >> k) & 1)
+                v ^= s->poly;
+        }
+        s->step[i] = v;
+    }
+
+    /* Target registers without reflection and xor_out */
+    if (!bigint_init(&t, s->w))
+        return out_of_memory;
+    for (i = 0; i < s->ntargets; i++) {
+        bigint_mov(&t, &targets[i]);
+        if (crc->reflect_out)
+            bigint_reflect(&t);
+        bigint_xor(&t, &crc->xor_out);
+        tk[i] = bigint_get_u64(&t) & s->mask;
+    }
+    bigint_destroy(&t);
+
+    if (!s->window) {
+        /* y = (x^-1)^8 where x^-1 = (P + 1) / x */
+        if (!(s->poly & 1))
+            return "the generator polynomial has no x^0 term";
+        s->y = powmod(s, (s->poly >> 1) | (uint64_t)1 << (s->w - 1), 8);
+        for (v = s->y, k = 0; k < 64; k++, v = mulx(s, v))
+            basis[k] = v;
+        for (k = 0; k < 8; k++) {
+            for (i = 0; i < 256; i++) {
+                unsigned int j;
+                for (v = 0, j = 0; j < 8; j++) {
+                    if ((i >> j) & 1)
+                        v ^= basis[8*k + j];
+                }
+                s->ymul[k][i] = v;
+            }
+        }
+    } else {
+        /* Windows compare targets + init·x^8n to the rolled register */
+        const uint64_t xn = powmod(s, mulx(s, 1), 8 * (uintmax_t)s->window);
+        v = mulmod(s, s->init, xn);
+        for (i = 0; i < s->ntargets; i++)
+            tk[i] ^= v;
+        for (i = 0; i < 256; i++)
+            s->roll[i] = mulmod(s, s->step[byte_poly(s, (uint8_t)i)], xn);
+    }
+    return NULL;
+}
+
+const char *crc_scan(const struct crc_config *crc, const uint8_t *data,
+                     size_t size, const struct bigint targets[], size_t n,
+                     size_t window, size_t first, size_t last,
+                     unsigned threads, struct crc_scan_match **matches,
+                     size_t *nmatches)
+{
+    size_t k, total;
+    uint64_t xc, prefix, *tk;
+    const char *error = NULL;
+    struct scan *s;
+
+    *matches = NULL;
+    *nmatches = 0;
+    if (!crc->width || crc->width > 64)
+        return "scanning needs a CRC of at most 64 bits";
+    if (!(s = calloc(1, sizeof(struct scan))))
+        return out_of_memory;
+    if (!(tk = malloc((n + 1) * sizeof(uint64_t)))) {
+        free(s);
+        return out_of_memory;
+    }
+    s->data = data;
+    s->size = size;
+    s->targets = tk;
+    s->ntargets = n;
+    s->window = window;
+    if (last > size)
+        last = size;
+    if (window && size < window)
+        last = 0;
+    else if (window && last > size - window + 1)
+        last = size - window + 1;
+    s->first = first;
+    s->last = last;
+
+    /* Copy of the CRC without init, xor_out and reflection (same tables) */
+    s->zero = *crc;
+    s->zero.reflect_out = 0;
+    bigint_init(&s->zero.init, crc->width);
+    bigint_init(&s->zero.xor_out, crc->width);
+    if (!s->zero.init.limb || !s->zero.xor_out.limb) {
+        error = out_of_memory;
+        goto finish;
+    }
+    if ((error = scan_init(s, crc, targets, tk)) || first >= last)
+        goto finish;
+
+    if (window) {
+        s->nchunks = (last - first + SCAN_CHUNK - 1) / SCAN_CHUNK;
+        if (!(s->chunks = calloc(s->nchunks, sizeof(struct scan_chunk)))
+                || !set_init(&s->set, tk, n)) {
+            error = out_of_memory;
+            goto finish;
+        }
+        error = run_pass(s, SCAN_WINDOWS, s->nchunks, threads);
+    } else {
+        /* S(p) at the chunk starts from the registers of the chunks */
+        s->nchunks = size / SCAN_CHUNK + 1;
+        s->state = malloc(s->nchunks * sizeof(uint64_t));
+        s->keys = malloc((last - first) * sizeof(uint64_t));
+        s->chunks = calloc(s->nchunks, sizeof(struct scan_chunk));
+        if (!s->state || !s->keys || !s->chunks) {
+            error = out_of_memory;
+            goto finish;
+        }
+        if ((error = run_pass(s, SCAN_LOCAL, s->nchunks, threads)))
+            goto finish;
+        xc = powmod(s, mulx(s, 1), 8 * (uintmax_t)SCAN_CHUNK);
+        for (k = 0, prefix = 0; k < s->nchunks; k++) {
+            const uint64_t local = s->state[k];
+            s->state[k] = prefix;
+            prefix = mulmod(s, prefix, xc) ^ local;
+        }
+        if ((error = run_pass(s, SCAN_STARTS, s->nchunks, threads)))
+            goto finish;
+        if (!set_init(&s->set, s->keys, last - first)) {
+            error = out_of_memory;
+            goto finish;
+        }
+        error = run_pass(s, SCAN_ENDS, s->nchunks, threads);
+    }
+    if (error)
+        goto finish;
+
+    /* Collect the matches */
+    for (k = total = 0; k < s->nchunks; k++)
+        total += s->chunks[k].n;
+    if (!total)
+        goto finish;
+    if (!(*matches = malloc(total * sizeof(struct crc_scan_match)))) {
+        error = out_of_memory;
+        goto finish;
+    }
+    for (k = 0; k < s->nchunks; k++) {
+        if (!s->chunks[k].n)
+            continue;
+        memcpy(*matches + *nmatches, s->chunks[k].m,
+               s->chunks[k].n * sizeof(struct crc_scan_match));
+        *nmatches += s->chunks[k].n;
+    }
+    qsort(*matches, *nmatches, sizeof(struct crc_scan_match), compare_matches);
+
+finish:
+    if (s->chunks) {
+        for (k = 0; k < s->nchunks; k++)
+            free(s->chunks[k].m);
+    }
+    set_destroy(&s->set);
+    bigint_destroy(&s->zero.init);
+    bigint_destroy(&s->zero.xor_out);
+    free(s->chunks);
+    free(s->state);
+    free(s->keys);
+    free(tk);
+    free(s);
+    return error;
+}
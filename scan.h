@@ -0,0 +1,44 @@
+/*
+ * Search for the byte ranges of a message covered by known CRC values.
+ */
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "crc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Range data[start..end-1] whose CRC is targets[target] */
+struct crc_scan_match {
+    size_t start;
+    size_t end;
+    size_t target;
+};
+
+/*
+ * Find the ranges of data[0..size-1] whose CRC is one of targets[0..n-1].
+ *
+ * With a nonzero `window`, every window of that many bytes starting at a byte
+ * in first..last-1 is checked. The register of the window is rolled one byte
+ * at a time (the leaving byte is cancelled by a lookup table), and it is
+ * looked up from a hash table of the targets.
+ *
+ * Otherwise, every non-empty range starting at a byte in first..last-1 is
+ * checked. With S(p) the register of data[0..p-1] from zero, the CRC of a
+ * range is target T iff (S(start) + init)·x^-8start = (S(end) + T)·x^-8end,
+ * so both sides are computed in a single pass and the start values are looked
+ * up from a hash table (the generator polynomial must have an x^0 term).
+ *
+ * Both scans run in `threads` threads over chunks of the data. The matches
+ * are sorted by start and end and stored in a malloc'd array. The width of
+ * the CRC must be at most 64 bits. Returns NULL on success or a description
+ * of the error.
+ */
+const char *crc_scan(const struct crc_config *crc, const uint8_t *data,
+                     size_t size, const struct bigint targets[], size_t n,
+                     size_t window, size_t first, size_t last,
+                     unsigned threads, struct crc_scan_match **matches,
+                     size_t *nmatches);
+
+#endif
@@ -0,0 +1,728 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define SEARCH_THREADS
+#endif
+#include "search.h"
+
+#include <time.h>
+
+#ifdef SEARCH_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Charset search state shared by the worker threads.
+ *
+ * Mutable bits are renumbered by their message position (q = 0, 1, ...) and
+ * grouped into bytes (slots). The highest set bit ("lead") of each vector of
+ * the reduced null space basis is clear in all other basis vectors. Rows are
+ * sorted by their lead positions, so rows group[k]..group[k+1]-1 are the basis
+ * vectors leading in byte slot k and no row leading in an earlier slot touches
+ * the bits of slot k.
+ */
+struct charset_search {
+    const uint8_t *charset;
+    const uint8_t *values;
+
+    bitsize_t *pos;         /* message bit position of q */
+    size_t *slot;           /* first q of each slot (nslots + 1 elements) */
+    size_t *group;          /* first basis row of each slot (nslots + 1) */
+    size_t nslots;
+
+    struct bigint *basis;   /* reduced null space basis */
+    struct bigint x;        /* particular solution */
+    struct bigint found;    /* solution found by a worker */
+    int result;             /* 1 if found, -2 if there is no solution */
+    int done;
+
+    double start;
+    struct search_budget *budget;
+#ifdef SEARCH_THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+/* Depth-first search of a worker in its own random order */
+struct charset_worker {
+    struct charset_search *s;
+    struct bigint cur;      /* current solution */
+    unsigned long rng;
+    uintmax_t candidates;   /* not yet added to the budget */
+    int expired;
+#ifdef SEARCH_THREADS
+    pthread_t thread;
+#endif
+};
+
+/* Position of message bit b in the sorted array pos[0..n) */
+static size_t position(const bitsize_t pos[], size_t n, bitsize_t b)
+{
+    size_t lo = 0, hi = n;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pos[mid] <= b) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+static int compare_bits(const void *a, const void *b)
+{
+    const bitsize_t x = *(const bitsize_t *)a, y = *(const bitsize_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Seconds from an arbitrary starting point (CPU time without POSIX clocks) */
+static double wall_clock(void)
+{
+#ifdef SEARCH_THREADS
+    struct timespec ts;
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static unsigned long xorshift(unsigned long *state)
+{
+    unsigned long x = *state;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    return *state = x;
+}
+
+static void lock_charset(struct charset_search *s)
+{
+#ifdef SEARCH_THREADS
+    pthread_mutex_lock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static void unlock_charset(struct charset_search *s)
+{
+#ifdef SEARCH_THREADS
+    pthread_mutex_unlock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+/*
+ * Count a candidate. Every 256 candidates, the count is added to the shared
+ * budget and the search is stopped if the budget is exhausted or if another
+ * worker has finished.
+ */
+static int out_of_budget(struct charset_worker *w)
+{
+    struct charset_search *s = w->s;
+    struct search_budget *budget = s->budget;
+    if (++w->candidates & 0xFF)
+        return 0;
+    lock_charset(s);
+    budget->candidates += w->candidates;
+    w->candidates = 0;
+    if ((budget->work && budget->candidates >= budget->work)
+            || (budget->seconds > 0
+                && wall_clock() - s->start >= budget->seconds))
+        s->done = 1;
+    w->expired = s->done;
+    unlock_charset(s);
+    return w->expired;
+}
+
+/* Value of a byte slot in the current solution */
+static int slot_value(const struct charset_worker *w, size_t k)
+{
+    size_t q;
+    const struct charset_search *s = w->s;
+    int value = s->values[k];
+    for (q = s->slot[k]; q < s->slot[k+1]; q++) {
+        if (bigint_get_bit(&w->cur, q))
+            value ^= 1 << (s->pos[q] % 8);
+    }
+    return value;
+}
+
+/*
+ * Visit byte slots k-1, k-2, ..., 0. Every combination of the basis vectors
+ * leading in slot k-1 is tried in Gray code order starting from a random one.
+ * Returns non-zero if a solution is found (left in w->cur).
+ */
+static int search_slots(struct charset_worker *w, size_t k)
+{
+    int value;
+    size_t r, m, first;
+    unsigned long t, mask, on;
+    const struct charset_search *s = w->s;
+    if (k-- == 0)
+        return 1;
+
+    first = s->group[k];
+    m = s->group[k+1] - first;
+    mask = xorshift(&w->rng) & ((1UL << m) - 1);
+    for (r = 0; r < m; r++) {
+        if ((mask >> r) & 1)
+            bigint_xor(&w->cur, &s->basis[first + r]);
+    }
+
+    on = mask;
+    for (t = 0; t < 1UL << m; t++) {
+        if (t) {
+            for (r = 0; !((t >> r) & 1); r++);
+            bigint_xor(&w->cur, &s->basis[first + r]);
+            on ^= 1UL << r;
+        }
+        if (out_of_budget(w))
+            break;
+        value = slot_value(w, k);
+        if (!((s->charset[value / 8] >> (value % 8)) & 1))
+            continue;
+        if (search_slots(w, k))
+            return 1;
+        if (w->expired)
+            break;
+    }
+
+    for (r = 0; r < m; r++) {
+        if ((on >> r) & 1)
+            bigint_xor(&w->cur, &s->basis[first + r]);
+    }
+    return 0;
+}
+
+/*
+ * Search the whole tree in the order of the worker. The first solution found
+ * (or the proof that there is none) stops the other workers.
+ */
+static void *charset_worker_run(void *arg)
+{
+    struct charset_worker *w = arg;
+    struct charset_search *s = w->s;
+    int found = search_slots(w, s->nslots);
+    lock_charset(s);
+    s->budget->candidates += w->candidates;
+    w->candidates = 0;
+    if (!s->result && (found || !w->expired)) {
+        if (found)
+            bigint_mov(&s->found, &w->cur);
+        s->result = found ? 1 : -2;
+    }
+    s->done = 1;
+    unlock_charset(s);
+    return NULL;
+}
+
+bitoffset_t search_charset(const struct forge_space *space,
+                           const bitsize_t bits[], size_t nbits,
+                           const bitsize_t offsets[], const uint8_t values[],
+                           size_t nbytes, const uint8_t charset[32],
+                           unsigned threads, unsigned long seed,
+                           struct search_budget *budget, bitsize_t flips[])
+{
+    struct charset_search s;
+    struct charset_worker *workers;
+    size_t i, k, q, r, rows, t, started = 0;
+    bitoffset_t ret = -3;
+
+    memset(&s, 0, sizeof(s));
+    s.charset = charset;
+    s.values = values;
+    s.nslots = nbytes;
+    s.budget = budget;
+    budget->candidates = 0;
+    budget->elapsed = 0;
+    if (!threads)
+        threads = 1;
+
+    workers = calloc(threads, sizeof(struct charset_worker));
+    s.pos = malloc((nbits + 1) * sizeof(bitsize_t));
+    s.slot = malloc((nbytes + 1) * sizeof(size_t));
+    s.group = malloc((nbytes + 1) * sizeof(size_t));
+    s.basis = bigint_array_new(space->dim + 1, nbits + 1);
+    if (!workers || !s.pos || !s.slot || !s.group || !s.basis
+            || !bigint_init(&s.x, nbits + 1)
+            || !bigint_init(&s.found, nbits + 1))
+        goto finish;
+
+    /* Renumber bits by position and locate byte slots */
+    memcpy(s.pos, bits, nbits * sizeof(bitsize_t));
+    qsort(s.pos, nbits, sizeof(bitsize_t), compare_bits);
+    for (k = q = 0; k < nbytes; k++) {
+        s.slot[k] = q;
+        while (q < nbits && s.pos[q] / 8 == offsets[k])
+            q++;
+    }
+    s.slot[nbytes] = q;
+
+    /* Particular solution and null space basis over the positions */
+    for (i = 0; i < space->rank; i++) {
+        if (bigint_get_bit(&space->x, i))
+            bigint_flip_bit(&s.x, position(s.pos, nbits, bits[i]));
+    }
+    for (r = 0; r < space->dim; r++) {
+        bigint_set_bit(&s.basis[r],
+                       position(s.pos, nbits, bits[space->rank + r]));
+        for (i = 0; i < space->rank; i++) {
+            if (bigint_get_bit(&space->kernel[r], i))
+                bigint_flip_bit(&s.basis[r], position(s.pos, nbits, bits[i]));
+        }
+    }
+
+    /* Reduced echelon form with leads at the highest possible positions */
+    k = nbytes;
+    s.group[k] = rows = 0;
+    for (q = nbits; q-- > 0 && rows < space->dim; ) {
+        for (; k > 0 && q < s.slot[k]; k--)
+            s.group[k] = rows;
+        for (r = rows; r < space->dim; r++) {
+            if (bigint_get_bit(&s.basis[r], q))
+                break;
+        }
+        if (r == space->dim)
+            continue;
+        bigint_swap(&s.basis[r], &s.basis[rows]);
+        for (r = 0; r < space->dim; r++) {
+            if (r != rows && bigint_get_bit(&s.basis[r], q))
+                bigint_xor(&s.basis[r], &s.basis[rows]);
+        }
+        rows++;
+    }
+    do s.group[k] = rows; while (k-- > 0);
+
+    /* Rows were collected from the last slot down; renumber groups */
+    for (k = 0; k <= nbytes; k++)
+        s.group[k] = rows - s.group[k];
+    for (r = 0; r < rows / 2; r++)
+        bigint_swap(&s.basis[r], &s.basis[rows - 1 - r]);
+
+    /* Workers start from the particular solution with their own seeds */
+    for (t = 0; t < threads; t++) {
+        unsigned long rng = (seed + 0x9E3779B9UL * t) & 0xFFFFFFFFUL;
+        if (!bigint_init(&workers[t].cur, nbits + 1))
+            goto finish;
+        started++;
+        bigint_mov(&workers[t].cur, &s.x);
+        workers[t].s = &s;
+        workers[t].rng = rng ? rng : 0x2545F491UL;
+    }
+
+    /* Depth-first searches from the last byte to the first */
+#ifdef SEARCH_THREADS
+    if (pthread_mutex_init(&s.lock, NULL))
+        goto finish;
+    s.start = wall_clock();
+    for (t = 1; t < threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, charset_worker_run,
+                           &workers[t]))
+            break;
+    }
+    charset_worker_run(&workers[0]);
+    while (--t > 0)
+        pthread_join(workers[t].thread, NULL);
+    pthread_mutex_destroy(&s.lock);
+#else
+    s.start = wall_clock();
+    charset_worker_run(&workers[0]);
+#endif
+    budget->elapsed = wall_clock() - s.start;
+
+    if (s.result == 1) {
+        for (q = 0, ret = 0; q < nbits; q++) {
+            if (bigint_get_bit(&s.found, q))
+                flips[ret++] = s.pos[q];
+        }
+    } else {
+        ret = s.result ? -2 : -1;
+    }
+
+finish:
+    while (started--)
+        bigint_destroy(&workers[started].cur);
+    free(workers);
+    bigint_destroy(&s.found);
+    bigint_destroy(&s.x);
+    bigint_array_delete(s.basis);
+    free(s.group);
+    free(s.slot);
+    free(s.pos);
+    return ret;
+}
+
+/*
+ * Low-weight search state shared by the worker threads.
+ *
+ * Columns are numbered like bits[]: the first rank columns are the pivots of
+ * forge_affine() and the rest are free. Column c of a solution is set if bit
+ * bits[c] is flipped.
+ */
+struct weight_search {
+    size_t rank;
+    size_t ncols;
+    size_t *byte;           /* byte slot of each column (for byte weights) */
+    size_t nbytes;
+    const struct forge_space *space;
+
+    struct bigint best;     /* lightest solution found */
+    size_t weight;          /* its weight */
+    size_t bound;           /* stop at or below this weight */
+    int done;
+
+    struct search_budget *budget;
+    double start;
+    void (*report)(void *ctx, size_t weight, double elapsed);
+    void *ctx;
+#ifdef SEARCH_THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+/*
+ * Systematic parity check matrix of a worker. The solutions are the vectors v
+ * with col[0]*v[0] ^ col[1]*v[1] ^ ... = syn. Column piv[i] is the unit vector
+ * of row i, so v = syn over the pivots (and zero elsewhere) is a solution.
+ */
+struct weight_worker {
+    struct weight_search *s;
+    struct bigint *col;     /* ncols columns of rank bits */
+    struct bigint syn;
+    struct bigint cand;     /* candidate solution over the columns */
+    size_t *piv;            /* pivot column of each row */
+    size_t *row;            /* 1 + row of each pivot column (or 0) */
+    size_t *stamp;          /* byte slots counted for a candidate */
+    size_t gen;
+    unsigned long rng;
+    uintmax_t candidates;
+#ifdef SEARCH_THREADS
+    pthread_t thread;
+#endif
+};
+
+static size_t popcount(limb_t x)
+{
+#ifdef __GNUC__
+    return (size_t)__builtin_popcountl(x);
+#else
+    size_t n;
+    for (n = 0; x; n++)
+        x &= x - 1;
+    return n;
+#endif
+}
+
+static void lock_search(struct weight_search *s)
+{
+#ifdef SEARCH_THREADS
+    pthread_mutex_lock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static void unlock_search(struct weight_search *s)
+{
+#ifdef SEARCH_THREADS
+    pthread_mutex_unlock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+/*
+ * Weight of the solution setting column c (none if c = ncols) and the pivots
+ * of syn ^ col[c]. Byte weights count the distinct byte slots; the result is
+ * only exact if it is below `limit`.
+ */
+static size_t candidate_weight(struct weight_worker *w, size_t c, size_t limit)
+{
+    size_t i, j, bits = 0, bytes = 0;
+    const struct weight_search *s = w->s;
+    const size_t limbs = bigint_limbs(&w->syn);
+    const limb_t *x = w->syn.limb, *y = (c < s->ncols) ? w->col[c].limb : NULL;
+
+    for (i = 0; i < limbs; i++)
+        bits += popcount(y ? x[i] ^ y[i] : x[i]);
+    bits += (y != NULL);
+    if (!s->byte)
+        return bits;
+
+    /* Every byte holds at most 8 flips */
+    if ((bits + 7) / 8 >= limit)
+        return limit;
+    w->gen++;
+    if (y) {
+        w->stamp[s->byte[c]] = w->gen;
+        bytes++;
+    }
+    for (i = 0; i < limbs; i++) {
+        limb_t v = y ? x[i] ^ y[i] : x[i];
+        for (j = 0; v; j++, v >>= 1) {
+            size_t slot;
+            if (!(v & 1))
+                continue;
+            slot = s->byte[w->piv[i * LIMB_BITS + j]];
+            if (w->stamp[slot] != w->gen) {
+                w->stamp[slot] = w->gen;
+                if (++bytes >= limit)
+                    return limit;
+            }
+        }
+    }
+    return bytes;
+}
+
+/* Publish a lighter solution (called with the search locked) */
+static void publish(struct weight_worker *w, size_t c, size_t weight)
+{
+    size_t i;
+    struct weight_search *s = w->s;
+    bigint_load_zeros(&s->best);
+    for (i = 0; i < s->rank; i++) {
+        int bit = bigint_get_bit(&w->syn, i);
+        if (c < s->ncols)
+            bit ^= bigint_get_bit(&w->col[c], i);
+        if (bit)
+            bigint_set_bit(&s->best, w->piv[i]);
+    }
+    if (c < s->ncols)
+        bigint_set_bit(&s->best, c);
+    s->weight = weight;
+    if (s->report)
+        s->report(s->ctx, weight, wall_clock() - s->start);
+}
+
+/* Make column c the pivot of row i */
+static void pivot(struct weight_worker *w, size_t i, size_t c)
+{
+    size_t k;
+    struct weight_search *s = w->s;
+    bigint_mov(&w->cand, &w->col[c]);
+    bigint_clear_bit(&w->cand, i);
+    for (k = 0; k < s->ncols; k++) {
+        if (k != c && bigint_get_bit(&w->col[k], i))
+            bigint_xor(&w->col[k], &w->cand);
+    }
+    if (bigint_get_bit(&w->syn, i))
+        bigint_xor(&w->syn, &w->cand);
+    bigint_load_zeros(&w->col[c]);
+    bigint_set_bit(&w->col[c], i);
+    w->row[w->piv[i]] = 0;
+    w->row[c] = 1 + i;
+    w->piv[i] = c;
+}
+
+/*
+ * Lee-Brickell information set decoding with p <= 1: each information set
+ * (the pivots of the systematic form) yields the solution without free
+ * columns and the solutions with one free column. The next information set
+ * swaps a random pivot for a random free column (a random walk).
+ */
+static void *weight_worker_run(void *arg)
+{
+    struct weight_worker *w = arg;
+    struct weight_search *s = w->s;
+    struct search_budget *budget = s->budget;
+    size_t c, i, k, best, weight, tries;
+    int done;
+
+    lock_search(s);
+    best = s->weight;
+    unlock_search(s);
+    for (;;) {
+        /* Candidates of the information set */
+        for (c = 0; c <= s->ncols; c++) {
+            if (c < s->ncols && w->row[c])
+                continue;
+            w->candidates++;
+            if ((weight = candidate_weight(w, c, best)) < best) {
+                lock_search(s);
+                if (weight < s->weight)
+                    publish(w, c, weight);
+                best = s->weight;
+                unlock_search(s);
+            }
+        }
+
+        lock_search(s);
+        budget->candidates += w->candidates;
+        w->candidates = 0;
+        if (s->weight <= s->bound
+                || (budget->work && budget->candidates >= budget->work)
+                || (budget->seconds > 0
+                    && wall_clock() - s->start >= budget->seconds))
+            s->done = 1;
+        best = s->weight;
+        done = s->done;
+        unlock_search(s);
+        if (done || s->rank == s->ncols)
+            break;
+
+        /*
+         * Swap a pivot for a free column with a non-zero entry in its row.
+         * Any free column (not just the initially free ones) may come back,
+         * so the walk reaches every information set.
+         */
+        for (tries = 0; tries < 64; tries++) {
+            k = xorshift(&w->rng) % (s->ncols - s->rank);
+            for (c = 0; w->row[c] || k-- > 0; c++);
+            if (bigint_is_zero(&w->col[c]))
+                continue;
+            i = xorshift(&w->rng) % s->rank;
+            while (!bigint_get_bit(&w->col[c], i))
+                i = (i + 1) % s->rank;
+            pivot(w, i, c);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void weight_worker_destroy(struct weight_worker *w)
+{
+    bigint_array_delete(w->col);
+    bigint_destroy(&w->syn);
+    bigint_destroy(&w->cand);
+    free(w->piv);
+    free(w->row);
+    free(w->stamp);
+}
+
+/*
+ * Copy the first n bits of a checksum-wide vector of forge_affine(), which
+ * may be narrower than the rank + 1 bits of the worker vectors.
+ */
+static void copy_pivots(struct bigint *dest, const struct bigint *src, size_t n)
+{
+    size_t i;
+    bigint_load_zeros(dest);
+    for (i = 0; i < n; i++) {
+        if (bigint_get_bit(src, i))
+            bigint_set_bit(dest, i);
+    }
+}
+
+/* Systematic form of the space of forge_affine() (zero if out of memory) */
+static int weight_worker_init(struct weight_worker *w, struct weight_search *s,
+                              unsigned long seed)
+{
+    size_t i, k;
+    const struct forge_space *space = s->space;
+    memset(w, 0, sizeof(*w));
+    w->s = s;
+    w->rng = (seed & 0xFFFFFFFFUL) ? (seed & 0xFFFFFFFFUL) : 0x2545F491UL;
+    w->col = bigint_array_new(s->ncols, s->rank + 1);
+    w->piv = malloc((s->rank + 1) * sizeof(size_t));
+    w->row = calloc(s->ncols, sizeof(size_t));
+    w->stamp = calloc(s->nbytes + 1, sizeof(size_t));
+    if (!w->col || !w->piv || !w->row || !w->stamp
+            || !bigint_init(&w->syn, s->rank + 1)
+            || !bigint_init(&w->cand, s->rank + 1)) {
+        weight_worker_destroy(w);
+        return 0;
+    }
+    copy_pivots(&w->syn, &space->x, s->rank);
+    for (i = 0; i < s->rank; i++) {
+        bigint_set_bit(&w->col[i], i);
+        w->piv[i] = i;
+        w->row[i] = 1 + i;
+    }
+    for (k = 0; k < space->dim; k++)
+        copy_pivots(&w->col[s->rank + k], &space->kernel[k], s->rank);
+    return 1;
+}
+
+unsigned search_threads(void)
+{
+#ifdef SEARCH_THREADS
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 1) ? (n < 256 ? (unsigned)n : 256) : 1;
+#else
+    return 1;
+#endif
+}
+
+bitoffset_t search_min_weight(const struct forge_space *space,
+                              const bitsize_t bits[], size_t nbits,
+                              int bytes, unsigned threads, unsigned long seed,
+                              struct search_budget *budget,
+                              void (*report)(void *ctx, size_t weight,
+                                             double elapsed),
+                              void *ctx, bitsize_t flips[])
+{
+    struct weight_search s;
+    struct weight_worker *workers;
+    bitsize_t *pos = NULL;
+    size_t c, t, started = 0;
+    bitoffset_t ret = -3;
+
+    memset(&s, 0, sizeof(s));
+    s.space = space;
+    s.rank = space->rank;
+    s.ncols = nbits;
+    s.weight = (size_t)-1;
+    s.bound = bigint_is_zero(&space->x) ? 0 : 1;
+    s.budget = budget;
+    s.report = report;
+    s.ctx = ctx;
+    budget->candidates = 0;
+    budget->elapsed = 0;
+    if (!threads)
+        threads = 1;
+    if (!(workers = calloc(threads, sizeof(struct weight_worker)))
+            || !bigint_init(&s.best, nbits + 1))
+        goto finish;
+
+    /* Byte slots of the columns */
+    if (bytes) {
+        if (!(s.byte = malloc((nbits + 1) * sizeof(size_t)))
+                || !(pos = malloc((nbits + 1) * sizeof(bitsize_t))))
+            goto finish;
+        for (c = 0; c < nbits; c++)
+            pos[c] = bits[c] / 8;
+        qsort(pos, nbits, sizeof(bitsize_t), compare_bits);
+        for (c = 0; c < nbits; c++)
+            s.byte[c] = position(pos, nbits, bits[c] / 8);
+        s.nbytes = nbits;
+    }
+
+    for (t = 0; t < threads; t++) {
+        if (!weight_worker_init(&workers[t], &s, seed + 0x9E3779B9UL * t))
+            goto finish;
+        started++;
+    }
+#ifdef SEARCH_THREADS
+    if (pthread_mutex_init(&s.lock, NULL))
+        goto finish;
+    s.start = wall_clock();
+    for (t = 1; t < threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, weight_worker_run,
+                           &workers[t]))
+            break;
+    }
+    weight_worker_run(&workers[0]);
+    while (--t > 0)
+        pthread_join(workers[t].thread, NULL);
+    pthread_mutex_destroy(&s.lock);
+#else
+    s.start = wall_clock();
+    weight_worker_run(&workers[0]);
+#endif
+    budget->elapsed = wall_clock() - s.start;
+
+    /* Columns in increasing order, so flips[] may alias bits[] */
+    for (c = 0, ret = 0; c < nbits; c++) {
+        if (bigint_get_bit(&s.best, c))
+            flips[ret++] = bits[c];
+    }
+
+finish:
+    while (started--)
+        weight_worker_destroy(&workers[started]);
+    free(workers);
+    free(pos);
+    free(s.byte);
+    bigint_destroy(&s.best);
+    return ret;
+}
@@ -0,0 +1,70 @@
+/*
+ * Searches over the affine space of forging solutions.
+ */
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "forge.h"
+
+/* Search budget and statistics */
+struct search_budget {
+    double seconds;         /* wall-clock time limit (0 = unlimited) */
+    uintmax_t work;         /* candidate limit (0 = unlimited) */
+    uintmax_t candidates;   /* number of candidates examined */
+    double elapsed;         /* wall-clock seconds spent */
+};
+
+/*
+ * Find a solution keeping every byte containing mutable bits in a charset.
+ *
+ * `space` describes the solutions of forge_affine() over the array `bits[]`
+ * (of `nbits` elements). Arrays `offsets[]` and `values[]` (of `nbytes`
+ * elements, sorted by offset) give the original values of the bytes that
+ * contain mutable bits. Byte value c is allowed if bit c of `charset` is set.
+ *
+ * The search is a depth-first search from the last byte to the first byte
+ * over a null space basis in reduced echelon form, so that the value of each
+ * byte is fixed (and checked against the charset) as soon as the search
+ * reaches it. Each of the `threads` threads walks the tree visiting children
+ * in its own randomized order seeded from `seed`, and the first thread to
+ * find a solution (or to exhaust the tree) stops the others. The budget is
+ * shared by the threads.
+ *
+ * Returns the number of bit flips stored in `flips[]` (at most nbits), or
+ * a negative value if no solution was found within the budget (-1), if the
+ * search space does not contain a solution at all (-2) or if out of memory.
+ */
+bitoffset_t search_charset(const struct forge_space *space,
+                           const bitsize_t bits[], size_t nbits,
+                           const bitsize_t offsets[], const uint8_t values[],
+                           size_t nbytes, const uint8_t charset[32],
+                           unsigned threads, unsigned long seed,
+                           struct search_budget *budget, bitsize_t flips[]);
+
+/*
+ * Find a solution with few bit flips, or few mutated bytes if `bytes` is set.
+ *
+ * `space` describes the solutions of forge_affine() over the array `bits[]`
+ * (of `nbits` elements). Finding the lightest solution is the syndrome
+ * decoding problem, which is searched by information set decoding (Lee and
+ * Brickell with at most one free bit): random walks over the systematic forms
+ * of the parity check matrix in `threads` threads seeded from `seed`. The
+ * search stops when a solution of weight one is found or when the budget
+ * (in wall-clock seconds) is exhausted. `report(ctx, weight, elapsed)` is
+ * called whenever a lighter solution is found.
+ *
+ * Returns the number of bit flips stored in `flips[]` (which may alias
+ * `bits[]`), or a negative value if out of memory.
+ */
+bitoffset_t search_min_weight(const struct forge_space *space,
+                              const bitsize_t bits[], size_t nbits,
+                              int bytes, unsigned threads, unsigned long seed,
+                              struct search_budget *budget,
+                              void (*report)(void *ctx, size_t weight,
+                                             double elapsed),
+                              void *ctx, bitsize_t flips[]);
+
+/* Number of threads used for searching (the online processors) */
+unsigned search_threads(void);
+
+#endif
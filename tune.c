@@ -0,0 +1,372 @@
+#include "tune.h"
+#include "fileio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Minimum duration of a single benchmark in seconds */
+#define TUNE_SECONDS 0.002
+
+/* Benchmark buffer size */
+#define TUNE_BYTES ((size_t)1 << 14)
+
+/* Matrix sparse engines of wider CRCs take too long to build for a benchmark */
+#define TUNE_MATRIX_WIDTH 128
+
+static const char *const engine_names[] = { "serial", "table", "sse42" };
+static const char *const sparse_names[] = { "matrix", "poly" };
+
+const char *crc_engine_name(enum crc_engine engine)
+{
+    return engine_names[engine];
+}
+
+const char *crc_sparse_name(enum crc_sparse_method method)
+{
+    return sparse_names[method];
+}
+
+const char *crc_tune_cache(void)
+{
+    int n;
+    const char *dir;
+    static char path[4096];
+    if ((dir = getenv("XDG_CACHE_HOME")) && *dir) {
+        n = snprintf(path, sizeof(path), "%s/crchack.tune", dir);
+    } else if ((dir = getenv("HOME")) && *dir) {
+        n = snprintf(path, sizeof(path), "%s/.cache/crchack.tune", dir);
+    } else {
+        return NULL;
+    }
+    return (n > 0 && (size_t)n < sizeof(path)) ? path : NULL;
+}
+
+static unsigned long xorshift(unsigned long *state)
+{
+    unsigned long x = *state;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    return *state = x;
+}
+
+static double elapsed(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Bytes per second hashed by the selected engine */
+static double time_engine(const struct crc_config *crc, const uint8_t *buf)
+{
+    double t;
+    uintmax_t n = 0;
+    clock_t start;
+    struct bigint checksum;
+    if (!bigint_init(&checksum, crc->width))
+        return 0;
+    start = clock();
+    do {
+        crc_append(crc, buf, TUNE_BYTES, &checksum);
+        n += TUNE_BYTES;
+    } while ((t = elapsed(start)) < TUNE_SECONDS);
+    bigint_destroy(&checksum);
+    return (double)n / t;
+}
+
+/*
+ * Bit flips per second by a new sparse engine for a message of `bits` bits
+ * (including its construction).
+ */
+static double time_sparse(const struct crc_config *crc, bitsize_t bits)
+{
+    double t;
+    size_t i;
+    uintmax_t n = 0;
+    clock_t start;
+    unsigned long rng = 1;
+    struct bigint checksum;
+    struct crc_sparse *engine;
+    if (!bigint_init(&checksum, crc->width))
+        return 0;
+    start = clock();
+    do {
+        if (!(engine = crc_sparse_new(crc, bits))) {
+            bigint_destroy(&checksum);
+            return 0;
+        }
+        for (i = 0; i < 4 * (size_t)crc->width; i++) {
+            bitsize_t pos = xorshift(&rng) % bits;
+            crc_sparse_1bit(engine, pos, &checksum);
+        }
+        crc_sparse_delete(engine);
+        n += i;
+    } while ((t = elapsed(start)) < TUNE_SECONDS);
+    bigint_destroy(&checksum);
+    return (double)n / t;
+}
+
+/* Cache key "cpu model<TAB>width poly reflect_in" (malloc'd) */
+static char *tune_key(const struct crc_config *crc)
+{
+    FILE *f;
+    char *key, *p;
+    bitsize_t i;
+    char model[256], line[512];
+    static const char digits[] = "0123456789abcdef";
+
+    strcpy(model, "unknown");
+    if ((f = fopen("/proc/cpuinfo", "r"))) {
+        while (fgets(line, sizeof(line), f)) {
+            if (!strncmp(line, "model name", 10) && (p = strchr(line, ':'))) {
+                p += 1 + strspn(p + 1, " \t");
+                p[strcspn(p, "\r\n")] = '\0';
+                snprintf(model, sizeof(model), "%s", p);
+                break;
+            }
+        }
+        fclose(f);
+    }
+    for (p = model; *p; p++) {
+        if (*p == '\t')
+            *p = ' ';
+    }
+
+    if (!(key = malloc(strlen(model) + crc->width / 4 + 32)))
+        return NULL;
+    p = key + sprintf(key, "%s\t%u ", model, crc->width);
+    for (i = (crc->width + 3) / 4; i-- > 0; ) {
+        int b, digit = 0;
+        for (b = 0; b < 4 && 4*i + b < crc->width; b++)
+            digit |= bigint_get_bit(&crc->poly, 4*i + b) << b;
+        *p++ = digits[digit];
+    }
+    sprintf(p, " %d", !!crc->reflect_in);
+    return key;
+}
+
+/* Look up the entry of a key from the cache file contents */
+static const char *cache_entry(const char *buf, size_t size, const char *key,
+                               size_t *len)
+{
+    const size_t n = strlen(key);
+    const char *line = buf, *end = buf + size;
+    while (line < end) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol)
+            eol = end;
+        if ((size_t)(eol - line) > n && line[n] == '\t'
+                && !memcmp(line, key, n)) {
+            *len = (size_t)(eol - line) + (eol < end);
+            return line;
+        }
+        line = eol + (eol < end);
+    }
+    return NULL;
+}
+
+/*
+ * Look up the value of a key from the cache file. The value is the name of
+ * one of the `n` choices in names[]. Returns the index of the choice (or -1).
+ */
+static int cache_load(const char *cache, const char *key,
+                      const char *const names[], int n)
+{
+    size_t len, size;
+    const char *entry;
+    char *buf, value[64], name[16];
+    int i, found = 0;
+
+    if (!(buf = fileio_load(cache, &size)))
+        return -1;
+    if ((entry = cache_entry(buf, size, key, &len))) {
+        len -= strlen(key) + 1;
+        entry += strlen(key) + 1;
+        if (len < sizeof(value)) {
+            memcpy(value, entry, len);
+            value[len] = '\0';
+            found = sscanf(value, "%15s", name) == 1;
+        }
+    }
+    free(buf);
+    for (i = 0; found && i < n; i++) {
+        if (!strcmp(name, names[i]))
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Replace the entry of a key in the cache file being replaced by `out` (the
+ * file is left as it was if writing fails).
+ */
+static void cache_store(struct fileio_replace *out, const char *key,
+                        const char *value)
+{
+    size_t len, size = 0;
+    const char *entry = NULL;
+    char *buf;
+
+    if ((buf = fileio_load(out->filename, &size)))
+        entry = cache_entry(buf, size, key, &len);
+    if (entry) {
+        fwrite(buf, sizeof(char), (size_t)(entry - buf), out->stream);
+        fwrite(entry + len, sizeof(char), size - (size_t)(entry - buf) - len,
+               out->stream);
+    } else if (buf) {
+        fwrite(buf, sizeof(char), size, out->stream);
+    }
+    fprintf(out->stream, "%s\t%s\n", key, value);
+    fileio_replace_commit(out);
+    free(buf);
+}
+
+/*
+ * Cached choice of a key, or an open replacement of the cache file for
+ * storing a new one. Returns the cached choice, -1 if the choice should be
+ * benchmarked (with out->stream set if it can be stored) or -2 if the cache
+ * cannot be written.
+ */
+static int cache_lookup(const char *cache, int force, const char *key,
+                        const char *const names[], int n,
+                        struct fileio_replace *out)
+{
+    int choice;
+    out->stream = NULL;
+    if (!cache)
+        return -1;
+    if (!force && (choice = cache_load(cache, key, names, n)) >= 0)
+        return choice;
+    if (!fileio_replace_open(out, cache) && !force)
+        return -2;
+    return -1;
+}
+
+int crc_autotune(struct crc_config *crc, const char *cache, int force,
+                 struct crc_tuning *tuning)
+{
+    int e, best, supported;
+    double rate;
+    char *key;
+    uint8_t *buf;
+    unsigned long rng = 1;
+    size_t i;
+    struct fileio_replace out;
+
+    memset(tuning, 0, sizeof(struct crc_tuning));
+    crc_tabulate(crc);
+    tuning->engine = crc_selected_engine(crc);
+    tuning->sparse = crc->sparse;
+    if (!(key = tune_key(crc)))
+        return 0;
+
+    /* Cached decision (unless the engine has become unavailable) */
+    e = cache_lookup(cache, force, key, engine_names,
+                     sizeof(engine_names) / sizeof(*engine_names), &out);
+    if (e >= 0 && crc_select_engine(crc, (enum crc_engine)e)) {
+        tuning->engine = (enum crc_engine)e;
+        tuning->engine_source = CRC_TUNE_CACHED;
+        free(key);
+        return 1;
+    } else if (e == -2) {
+        free(key);
+        return 1;
+    } else if (e >= 0) {
+        cache_lookup(cache, 1, key, engine_names, 0, &out);
+    }
+
+    if (!(buf = malloc(TUNE_BYTES))) {
+        if (out.stream)
+            fileio_replace_abort(&out);
+        free(key);
+        return 0;
+    }
+    for (i = 0; i < TUNE_BYTES; i++)
+        buf[i] = (uint8_t)xorshift(&rng);
+
+    /* Checksum engines (no benchmark if only one is supported) */
+    best = CRC_ENGINE_SERIAL;
+    for (e = supported = 0; e <= CRC_ENGINE_SSE42; e++) {
+        if (crc_select_engine(crc, (enum crc_engine)e)) {
+            best = e;
+            supported++;
+        }
+    }
+    if (supported > 1) {
+        for (e = 0; e <= CRC_ENGINE_SSE42; e++) {
+            if (crc_select_engine(crc, (enum crc_engine)e)
+                    && (rate = time_engine(crc, buf)) > tuning->engine_rate) {
+                tuning->engine_rate = rate;
+                best = e;
+            }
+        }
+    }
+    crc_select_engine(crc, (enum crc_engine)best);
+    tuning->engine = (enum crc_engine)best;
+    tuning->engine_source = CRC_TUNE_BENCHMARKED;
+    free(buf);
+
+    if (out.stream)
+        cache_store(&out, key, crc_engine_name(tuning->engine));
+    free(key);
+    return 1;
+}
+
+int crc_autotune_sparse(struct crc_config *crc, const char *cache, int force,
+                        bitsize_t bits, struct crc_tuning *tuning)
+{
+    int e, best;
+    double rate;
+    char *key, *sized;
+    unsigned k;
+    struct fileio_replace out;
+
+    /* Messages up to 2^k bits share a decision */
+    for (k = 1; k < 8 * sizeof(bitsize_t) - 1 && ((bitsize_t)1 << k) < bits; )
+        k++;
+    tuning->sparse = crc->sparse;
+    tuning->sparse_rate = 0;
+    tuning->sparse_log2 = k;
+    tuning->sparse_source = CRC_TUNE_DEFAULT;
+    if (!(key = tune_key(crc)))
+        return 0;
+    if (!(sized = malloc(strlen(key) + 16))) {
+        free(key);
+        return 0;
+    }
+    sprintf(sized, "%s s%u", key, k);
+    free(key);
+
+    e = cache_lookup(cache, force, sized, sparse_names,
+                     sizeof(sparse_names) / sizeof(*sparse_names), &out);
+    if (e >= 0) {
+        crc->sparse = tuning->sparse = (enum crc_sparse_method)e;
+        tuning->sparse_source = CRC_TUNE_CACHED;
+        free(sized);
+        return 1;
+    } else if (e == -2) {
+        free(sized);
+        return 1;
+    }
+
+    /* Matrix engines of wide CRCs take too long to build for a benchmark */
+    best = CRC_SPARSE_POLY;
+    if (crc->width <= TUNE_MATRIX_WIDTH) {
+        for (e = 0; e <= CRC_SPARSE_POLY; e++) {
+            crc->sparse = (enum crc_sparse_method)e;
+            rate = time_sparse(crc, (bitsize_t)1 << k);
+            if (rate > tuning->sparse_rate) {
+                tuning->sparse_rate = rate;
+                best = e;
+            }
+        }
+    }
+    crc->sparse = tuning->sparse = (enum crc_sparse_method)best;
+    tuning->sparse_source = CRC_TUNE_BENCHMARKED;
+
+    if (out.stream)
+        cache_store(&out, sized, crc_sparse_name(tuning->sparse));
+    free(sized);
+    return 1;
+}
@@ -0,0 +1,66 @@
+/*
+ * Microbenchmark-driven selection of the CRC engines.
+ */
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "crc.h"
+
+/* Origin of a tuning decision */
+enum crc_tune_source {
+    CRC_TUNE_DEFAULT,       /* not benchmarked (the cache is not writable) */
+    CRC_TUNE_CACHED,        /* loaded from the cache file */
+    CRC_TUNE_BENCHMARKED    /* measured by this run */
+};
+
+/* Engines chosen by crc_autotune() and crc_autotune_sparse() */
+struct crc_tuning {
+    enum crc_engine engine;         /* checksum calculation engine */
+    enum crc_sparse_method sparse;  /* sparse engine algorithm */
+    double engine_rate;     /* measured bytes per second (0 = not measured) */
+    double sparse_rate;     /* measured bit flips per second (0 = ditto) */
+    unsigned sparse_log2;   /* sparse choice is for messages of 2^n bits */
+    enum crc_tune_source engine_source;
+    enum crc_tune_source sparse_source;
+};
+
+/*
+ * Default cache file of the tuning decisions.
+ *
+ * $XDG_CACHE_HOME/crchack.tune or ~/.cache/crchack.tune. Returns NULL if
+ * neither environment variable is set.
+ */
+const char *crc_tune_cache(void);
+
+/*
+ * Select the fastest checksum engine for the CRC algorithm on this CPU.
+ *
+ * Each supported engine is timed on a short synthetic workload. Decisions are
+ * looked up from (and stored in) the `cache` file, keyed by the CPU model and
+ * the CRC width, polynomial and input reflection which determine the speed of
+ * the engines. The cache file and its directory are created if missing and
+ * the file is replaced atomically. If the cache cannot be written, the
+ * engines of crc_tabulate() are used without benchmarks, so that a read-only
+ * cache does not cost a benchmark on every run. With `force` set, the
+ * benchmarks are run even if the cache has an entry (or cannot be written).
+ * A NULL cache disables caching. Returns zero if out of memory, in which case
+ * the engines of crc_tabulate() remain in use.
+ */
+int crc_autotune(struct crc_config *crc, const char *cache, int force,
+                 struct crc_tuning *tuning);
+
+/*
+ * Select the fastest sparse engine algorithm for a message of `bits` bits.
+ *
+ * The cost of the algorithms depends on the message length, so they are
+ * timed on messages of the next power of two bits and the decision is cached
+ * per CPU model, CRC and power of two. Otherwise like crc_autotune().
+ */
+int crc_autotune_sparse(struct crc_config *crc, const char *cache, int force,
+                        bitsize_t bits, struct crc_tuning *tuning);
+
+/* Names of the engines ("serial", "table", "sse42", "matrix", "poly") */
+const char *crc_engine_name(enum crc_engine engine);
+const char *crc_sparse_name(enum crc_sparse_method method);
+
+#endif